@@ -230,7 +230,7 @@ namespace Collections
 		void ModifyKey(ARG_TYPE_IN_NODE(ModifyValue, 0) oldOey, StoredKey newKey)
 		{
 			EMPTY_CHECK;
-			auto v = move(_root->GetValue(oldOey));
+			auto v = move(_root->GetMutableValue(oldOey));
 			_root->Remove(oldOey);
 			--_keyCount;
 
@@ -253,7 +253,7 @@ namespace Collections
 		}
 #undef ARG_TYPE_IN_NODE
 
-		RecursiveGenerator<pair<StoredKey, StoredValue>*> GetStoredPairEnumerator()
+		RecursiveGenerator<pair<StoredKey, StoredValue> const*> GetStoredPairEnumerator() const
 		{
 			return _root->GetStoredPairEnumerator();
 		}
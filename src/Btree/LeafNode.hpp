@@ -13,6 +13,7 @@ namespace Collections
 {
 	using Basic::FuncTraits;
 	using Basic::GetMemberFuncType;
+	using FuncLib::Persistence::AddPrefetch;
 	using ::std::back_inserter;
 	using ::std::is_same_v;
 	using ::std::move;
@@ -80,7 +81,12 @@ namespace Collections
 			return _elements.ContainsKey(move(key));
 		}
 
-		StoredValue& GetValue(ARG_TYPE_IN_BASE(GetValue, 0) key) override
+		StoredValue const& GetValue(ARG_TYPE_IN_BASE(GetValue, 0) key) const override
+		{
+			return _elements.GetValue(move(key));
+		}
+
+		StoredValue& GetMutableValue(ARG_TYPE_IN_BASE(GetMutableValue, 0) key) override
 		{
 			return _elements.GetValue(move(key));
 		}
@@ -130,7 +136,7 @@ namespace Collections
 			return {};
 		}
 
-		RecursiveGenerator<pair<StoredKey, StoredValue>*> GetStoredPairEnumerator() override
+		RecursiveGenerator<pair<StoredKey, StoredValue> const*> GetStoredPairEnumerator() const override
 		{
 			for (auto& e : _elements)
 			{
@@ -138,6 +144,15 @@ namespace Collections
 			}
 		}
 
+		/// 扫描前把 key 指向的对象加到预读里
+		void AddKeysToPrefetch(auto* batch) const
+		{
+			for (auto& e : _elements)
+			{
+				AddPrefetch(e.first, batch);
+			}
+		}
+
 		decltype(_next)     Next()     const { return _next; }
 		decltype(_previous) Previous() const { return _previous; }
 		void Next(decltype(_next) next)             { _next = move(next); }
@@ -1,5 +1,6 @@
 #pragma once
 #include <memory>
+#include <utility>
 #include <functional>
 #include <type_traits>
 #include "../Basic/Exception.hpp"
@@ -18,6 +19,9 @@ namespace Collections
 {
 	using ::Basic::Assert;
 	using ::Basic::IsSpecialization; // PtrSetter use
+	using FuncLib::Persistence::DiskPtrBase;
+	using FuncLib::Persistence::Prefetch;
+	using FuncLib::Persistence::UniqueDiskRef;
 	using ::std::bind;
 	using ::std::make_pair;
 	using ::std::move;
@@ -124,12 +128,18 @@ namespace Collections
 			return _elements[i].second->ContainsKey(key);
 		}
 
-		typename Base1::StoredValue& GetValue(ARG_TYPE_IN_BASE(GetValue, 0) key) override
+		typename Base1::StoredValue const& GetValue(ARG_TYPE_IN_BASE(GetValue, 0) key) const override
 		{
 			SELECT_BRANCH(key);
 			return _elements[i].second->GetValue(key);
 		}
 
+		typename Base1::StoredValue& GetMutableValue(ARG_TYPE_IN_BASE(GetMutableValue, 0) key) override
+		{
+			SELECT_BRANCH(key);
+			return _elements[i].second->GetMutableValue(key);
+		}
+
 		void ModifyValue(ARG_TYPE_IN_BASE(ModifyValue, 0) key, ARG_TYPE_IN_BASE(ModifyValue, 1) value) override
 		{
 			SELECT_BRANCH(key);
@@ -167,8 +177,13 @@ namespace Collections
 			return subs;
 		}
 
-		RecursiveGenerator<pair<typename Base1::StoredKey, typename Base1::StoredValue>*> GetStoredPairEnumerator() override
+		RecursiveGenerator<pair<typename Base1::StoredKey, typename Base1::StoredValue> const*> GetStoredPairEnumerator() const override
 		{
+			if constexpr (IsSpecialization<Ptr<int>, UniqueDiskPtr>::value)
+			{
+				PrefetchSubNodes();
+			}
+
 			for (auto& e : _elements)
 			{
 				co_yield e.second->GetStoredPairEnumerator();
@@ -353,6 +368,33 @@ namespace Collections
 				SET_PROPERTY(midNode, this, ->_queryNext = bind(&MiddleNode::QuerySubNodeNextCallback, this, _1));
 			}
 		}
+
+		/// 扫描接下来会依次用到所有子节点，子节点是叶子的话还会用到叶子里的 key
+		/// 没读进来的这些一次提交读进来，不用一个一个地读
+		void PrefetchSubNodes() const
+		{
+			vector<DiskPtrBase<Base1> const*> subs;
+			for (auto& e : _elements)
+			{
+				subs.push_back(&e.second);
+			}
+			Prefetch(subs);
+
+			if constexpr (IsSpecialization<typename Base1::StoredKey, UniqueDiskRef>::value)
+			{
+				// 用 const 的指针访问，不会标记改动
+				if (auto const minSon = MinSon(); not minSon->Middle())
+				{
+					vector<DiskPtrBase<Key> const*> keys;
+					for (auto& e : _elements)
+					{
+						auto const leaf = LEF_CAST(e.second.get());
+						leaf->AddKeysToPrefetch(&keys);
+					}
+					Prefetch(keys);
+				}
+			}
+		}
 #undef MID_CAST		
 #undef LEF_CAST
 		// 这里的参数类型可以改一下，不直接用裸指针
@@ -87,7 +87,9 @@ namespace Collections
 #define KEY_T StoredKey
 #define VALUE_T StoredValue
 		virtual bool ContainsKey(Key const& key) const = 0;
-		virtual StoredValue& GetValue(Key const& key) = 0;
+		virtual StoredValue const& GetValue(Key const& key) const = 0;
+		/// 要改动或者移走值时用，经过的节点会被标记成改动过
+		virtual StoredValue& GetMutableValue(Key const& key) = 0;
 		virtual void ModifyValue(Key const& key, VALUE_T) = 0;
 		virtual void Add(pair<KEY_T, VALUE_T>) = 0;
 		virtual void Remove(Key const& key) = 0;
@@ -95,7 +97,7 @@ namespace Collections
 #undef KEY_T
 		virtual vector<Key> KeysInThisNode() const = 0;
 		virtual vector<OwnerLessPtr<NodeBase>> SubNodes() const = 0;
-		virtual RecursiveGenerator<pair<StoredKey, StoredValue>*> GetStoredPairEnumerator() = 0;
+		virtual RecursiveGenerator<pair<StoredKey, StoredValue> const*> GetStoredPairEnumerator() const = 0;
 
 	protected:
 		static Position ChooseAddPosition(order_int preCount, order_int thisCount, order_int nxtCount)
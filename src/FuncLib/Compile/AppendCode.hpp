@@ -32,6 +32,8 @@ namespace FuncLib::Compile
 
 		RecursiveGenerator<string> GetLineCodeGenerator() const
 		{
+			// 接在用户代码后面，生成代码里的错误不要算到用户代码的行上
+			co_yield "#line 1 \"generated_wrapper\"\n";
 			for (auto &i : IncludeNames)
 			{
 				co_yield "#include \"" + i + "\"\n";
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include "CompileCache.hpp"
+
+namespace FuncLib::Compile
+{
+	using ::std::lock_guard;
+	using ::std::min_element;
+	using ::std::move;
+	using ::std::nullopt;
+	using ::std::filesystem::exists;
+
+	namespace
+	{
+		constexpr pos_label IndexLabel = 100;
+
+		/// FNV-1a
+		uint64_t HashKey(string const& key)
+		{
+			uint64_t h = 14695981039346656037ull;
+			for (unsigned char c : key)
+			{
+				h ^= c;
+				h *= 1099511628211ull;
+			}
+			return h;
+		}
+	}
+
+	CompileCache::CompileCache(shared_ptr<File> file, shared_ptr<CompileCacheIndex> index, size_t capacity)
+		: _file(move(file)), _index(move(index)), _capacity(capacity)
+	{
+		for (auto& [_, e] : _index->Entries)
+		{
+			_size += e.Size;
+		}
+	}
+
+	CompileCache::CompileCache(CompileCache&& that) noexcept
+		: _mutex(), _file(move(that._file)), _index(move(that._index)), _capacity(that._capacity),
+		  _size(that._size), _metrics(that._metrics)
+	{ }
+
+	CompileCache CompileCache::GetFrom(path const& path, size_t capacity)
+	{
+		auto firstSetup = not exists(path);
+		auto file = File::GetFile(path);
+
+		shared_ptr<CompileCacheIndex> index;
+		if (firstSetup)
+		{
+			auto [l, i] = file->New(IndexLabel, CompileCacheIndex{ 0, {} });
+			file->Store(l, i);
+			index = move(i);
+		}
+		else
+		{
+			index = file->Read<CompileCacheIndex>(IndexLabel);
+		}
+
+		return CompileCache(move(file), move(index), capacity);
+	}
+
+	optional<vector<char>> CompileCache::Get(string const& key)
+	{
+		lock_guard<mutex> guard(_mutex);
+		auto& entries = _index->Entries;
+		if (auto it = entries.find(HashKey(key)); it != entries.end())
+		{
+			auto item = _file->Read<CompileCacheItem>(it->second.Label);
+			if (item->Key == key)
+			{
+				++_metrics.Hits;
+				// 只改内存里的，下次加入或淘汰时一起存下来，命中时不用重写整个索引
+				it->second.LastUse = ++_index->Clock;
+				return item->Bin;
+			}
+		}
+
+		++_metrics.Misses;
+		return nullopt;
+	}
+
+	void CompileCache::Put(string const& key, vector<char> bin)
+	{
+		lock_guard<mutex> guard(_mutex);
+		auto size = bin.size();
+		if (size > _capacity)
+		{
+			return;
+		}
+
+		auto hash = HashKey(key);
+		// 同样的 key 或者哈希值撞了，都用新的
+		if (_index->Entries.contains(hash))
+		{
+			Remove(hash);
+		}
+		EvictFor(size);
+
+		auto [l, item] = _file->New(CompileCacheItem{ key, move(bin) });
+		_file->Store(l, item);
+		_index->Entries.insert({ hash, CompileCacheEntry{ l, size, ++_index->Clock } });
+		_size += size;
+		_file->Store(IndexLabel, _index);
+	}
+
+	CompileCache::Metrics CompileCache::GetMetrics() const
+	{
+		lock_guard<mutex> guard(_mutex);
+		return _metrics;
+	}
+
+	size_t CompileCache::Count() const
+	{
+		lock_guard<mutex> guard(_mutex);
+		return _index->Entries.size();
+	}
+
+	size_t CompileCache::Size() const
+	{
+		lock_guard<mutex> guard(_mutex);
+		return _size;
+	}
+
+	void CompileCache::Remove(uint64_t hash)
+	{
+		auto entry = _index->Entries.extract(hash).mapped();
+		_file->Delete(entry.Label, _file->Read<CompileCacheItem>(entry.Label));
+		_size -= entry.Size;
+	}
+
+	void CompileCache::EvictFor(size_t size)
+	{
+		auto& entries = _index->Entries;
+		while (not entries.empty() and _size + size > _capacity)
+		{
+			auto lru = min_element(entries.begin(), entries.end(), [](auto& a, auto& b)
+			{
+				return a.second.LastUse < b.second.LastUse;
+			});
+			Remove(lru->first);
+			++_metrics.Evictions;
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <optional>
+#include <filesystem>
+#include "../Persistence/ByteConverter.hpp"
+#include "../Store/File.hpp"
+
+namespace FuncLib::Compile
+{
+	using FuncLib::Store::File;
+	using FuncLib::Store::pos_label;
+	using ::std::map;
+	using ::std::mutex;
+	using ::std::optional;
+	using ::std::shared_ptr;
+	using ::std::string;
+	using ::std::uint64_t;
+	using ::std::vector;
+	using ::std::filesystem::path;
+
+	struct CompileCacheEntry
+	{
+		pos_label Label;
+		size_t Size;
+		/// 最近一次用到时 CompileCacheIndex::Clock 的值
+		uint64_t LastUse;
+	};
+
+	struct CompileCacheIndex
+	{
+		uint64_t Clock;
+		/// key 的哈希值 -> 编译结果
+		map<uint64_t, CompileCacheEntry> Entries;
+	};
+
+	/// 编译结果和它的 key 存在一起，读出来时核对 key，哈希值撞了也不会拿错
+	struct CompileCacheItem
+	{
+		string Key;
+		vector<char> Bin;
+	};
+
+	/// 编译结果的缓存，存在单独的存储文件里。key 是编译的全部输入：代码、编译器版本和编译参数
+	/// 编译结果的总大小超过容量时淘汰最久没用的。可以多个线程同时用
+	/// 索引只在加入和淘汰时存，命中更新的使用顺序跟着下一次存下来
+	class CompileCache
+	{
+	public:
+		struct Metrics
+		{
+			size_t Hits = 0;
+			size_t Misses = 0;
+			size_t Evictions = 0;
+		};
+
+	private:
+		mutable mutex _mutex;
+		shared_ptr<File> _file;
+		shared_ptr<CompileCacheIndex> _index;
+		size_t _capacity;
+		/// 所有编译结果的字节数
+		size_t _size = 0;
+		Metrics _metrics;
+
+		CompileCache(shared_ptr<File> file, shared_ptr<CompileCacheIndex> index, size_t capacity);
+
+	public:
+		static inline size_t DefaultCapacity = 64 * 1024 * 1024;
+		static CompileCache GetFrom(path const& path, size_t capacity = DefaultCapacity);
+		// 移动构造的时候还没有开始并发访问，所以可以不用加互斥量
+		CompileCache(CompileCache&& that) noexcept;
+		optional<vector<char>> Get(string const& key);
+		/// 比容量还大的不存
+		void Put(string const& key, vector<char> bin);
+		Metrics GetMetrics() const;
+		size_t Count() const;
+		size_t Size() const;
+
+	private:
+		void Remove(uint64_t hash);
+		void EvictFor(size_t size);
+	};
+}
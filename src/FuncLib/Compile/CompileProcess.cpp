@@ -1,25 +1,75 @@
 
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
 #include <string>
+#include <thread>
 #include <vector>
 #include <fstream>
+#include <sstream>
+#include <optional>
+#include <algorithm>
+#include <exception>
+#include <functional>
 #include <string_view>
+#include <filesystem>
 #include "../Basic/Exception.hpp"
 #include "CompileProcess.hpp"
+#include "CompileCache.hpp"
 #include "AppendCode.hpp"
 #include "ParseFunc.hpp"
 #include "Util.hpp"
 
+#ifndef FUNC_COMPILER
+// 定义在 CMakeLists.txt 里，和生成预编译头的是同一份，路径都是绝对路径
+// 没用 CMake 构建时用这些，在放着 Unity.hpp、libFuncRuntime.so 的目录下运行，src 在它旁边
+#define FUNC_COMPILER "g++"
+#define FUNC_COMPILE_FLAGS "-O2 -fPIC -std=c++2a -I../src"
+#define FUNC_RUNTIME_HEADER "Unity.hpp"
+#define FUNC_RUNTIME_LIB_DIR "."
+#endif
+
 namespace FuncLib::Compile
 {
 	using Basic::InvalidOperationException;
 	using Basic::NotImplementException;
+	using ::std::atomic;
+	using ::std::condition_variable;
+	using ::std::exception_ptr;
 	using ::std::get;
+	using ::std::lock_guard;
+	using ::std::max;
+	using ::std::min;
 	using ::std::move;
+	using ::std::mutex;
+	using ::std::nullopt;
+	using ::std::istringstream;
 	using ::std::ofstream;
+	using ::std::unique_lock;
+	using ::std::optional;
 	using ::std::string;
 	using ::std::string_view;
+	using ::std::thread;
 	using ::std::to_string;
 	using ::std::vector;
+	using ::std::filesystem::exists;
+
+	/// 编译库里函数的编译器
+	constexpr char const Compiler[] = FUNC_COMPILER;
+
+	/// 编译错误信息里用户代码的文件名
+	constexpr char const FuncsDefName[] = "funcs_def";
+	/// 生成的代码用到的 Json 这些的声明，见 Unity.hpp。它的预编译头在同一个目录
+	constexpr char const RuntimeHeader[] = FUNC_RUNTIME_HEADER;
+	/// Json 这些预先编译好的共享库，所有函数共用一份
+	constexpr char const RuntimeLib[] = "FuncRuntime";
+	constexpr char const RuntimeLibDir[] = FUNC_RUNTIME_LIB_DIR;
+	/// 模板的错误信息可能很长，只留前面的
+	constexpr size_t MaxDiagnosticsSize = 4096;
+	/// 分开编译时每份最少的函数个数，太少的话多出来的编译进程和链接不划算
+	constexpr size_t MinFuncsPerChunk = 4;
 	
 	vector<char> CompileOnWindows(FuncsDefReader* defReader, AppendCode* appendCode)
 	{
@@ -44,6 +94,172 @@ namespace FuncLib::Compile
 		}
 	}
 
+	/// FUNC_COMPILE_FLAGS 也是生成预编译头时的参数
+	string const& CompileFlags()
+	{
+		static string const flags = string(FUNC_COMPILE_FLAGS) + " -shared -include " + RuntimeHeader;
+		return flags;
+	}
+
+	/// 要放在源文件后面，不然链接器认为用不到。带上 rpath，服务器不在构建目录运行也找得到运行时库
+	string const& LinkFlags()
+	{
+		static string const flags = string("-L") + RuntimeLibDir + " -l" + RuntimeLib + " -Wl,-rpath," + RuntimeLibDir;
+		return flags;
+	}
+
+	string const& CompilerVersion()
+	{
+		static string const version = []
+		{
+			string v;
+			if (auto pipe = popen((string(Compiler) + " --version 2>/dev/null").c_str(), "r"); pipe != nullptr)
+			{
+				char buf[64];
+				while (fgets(buf, sizeof(buf), pipe) != nullptr)
+				{
+					v.append(buf);
+				}
+				pclose(pipe);
+			}
+			return v;
+		}();
+		return version;
+	}
+
+	/// 编译时 include 的运行时头文件，由编译器按实际的参数列出来。系统头文件跟着编译器版本走，不用列
+	vector<string> RuntimeHeaders()
+	{
+		string deps;
+		auto cmd = string(Compiler) + ' ' + CompileFlags() + " -MM -x c++ /dev/null 2>/dev/null";
+		if (auto pipe = popen(cmd.c_str(), "r"); pipe != nullptr)
+		{
+			char buf[256];
+			while (fgets(buf, sizeof(buf), pipe) != nullptr)
+			{
+				deps.append(buf);
+			}
+			pclose(pipe);
+		}
+
+		// 格式是 "null.o: /dev/null Unity.hpp ../src/Json/Json.hpp"，太长的会用反斜杠换行
+		vector<string> headers;
+		if (auto colon = deps.find(':'); colon != string::npos)
+		{
+			istringstream names(deps.substr(colon + 1));
+			for (string name; names >> name;)
+			{
+				if (name != "\\" and name != "/dev/null")
+				{
+					headers.push_back(move(name));
+				}
+			}
+		}
+		return headers;
+	}
+
+	/// 换了运行时库、运行时的头文件或者它们的预编译头，编译出来的东西也不能再用
+	string const& RuntimeFingerprint()
+	{
+		static string const fingerprint = []
+		{
+			auto files = RuntimeHeaders();
+			files.push_back(string(RuntimeHeader) + ".gch");
+			files.push_back(string(RuntimeLibDir) + "/lib" + RuntimeLib + ".so");
+
+			string fingerprint;
+			for (auto& f : files)
+			{
+				if (exists(f))
+				{
+					auto bytes = ReadFileBytes(f.c_str());
+					fingerprint.append(f + ':' + to_string(::std::hash<string_view>()(string_view(bytes.data(), bytes.size()))) + '\n');
+				}
+			}
+			return fingerprint;
+		}();
+		return fingerprint;
+	}
+
+	/// 行尾的空白和换行符的差别不影响编译结果
+	string NormalizeCode(string_view code)
+	{
+		string normalized;
+		normalized.reserve(code.size());
+		for (auto c : code)
+		{
+			if (c == '\r')
+			{
+				continue;
+			}
+			if (c == '\n')
+			{
+				while (not normalized.empty() and (normalized.back() == ' ' or normalized.back() == '\t'))
+				{
+					normalized.pop_back();
+				}
+			}
+			normalized.push_back(c);
+		}
+		while (not normalized.empty() and ::std::isspace(static_cast<unsigned char>(normalized.back())))
+		{
+			normalized.pop_back();
+		}
+		return normalized;
+	}
+
+	/// 编译的全部输入，一样的话编译结果就一样
+	string CompileCacheKey(string_view code, AppendCode const& appendCode)
+	{
+		auto key = CompilerVersion() + CompileFlags() + '\n' + LinkFlags() + '\n' + RuntimeFingerprint() + '\n';
+		key.append(NormalizeCode(code));
+		key.push_back('\n');
+		auto g = appendCode.GetLineCodeGenerator();
+		while (g.MoveNext())
+		{
+			key.append(g.Current());
+		}
+		return key;
+	}
+
+	/// 整个进程里同时跑的编译器进程不超过 DefaultCompileJobs() 个
+	/// 多个线程各自编译，每个又分块并行时，总数也不会超过核数
+	class CompilerSlots
+	{
+	private:
+		mutex _mutex;
+		condition_variable _released;
+		size_t _free = DefaultCompileJobs();
+
+	public:
+		void Acquire()
+		{
+			unique_lock<mutex> lock(_mutex);
+			_released.wait(lock, [this] { return _free > 0; });
+			--_free;
+		}
+
+		void Release()
+		{
+			{
+				lock_guard<mutex> guard(_mutex);
+				++_free;
+			}
+			_released.notify_one();
+		}
+	};
+
+	/// 编译器的输出写到 logFileName 里
+	int RunCompiler(string const& args, string const& logFileName)
+	{
+		static CompilerSlots slots;
+		auto cmd = string(Compiler) + ' ' + args + " > " + logFileName + " 2>&1";
+		slots.Acquire();
+		auto r = system(cmd.c_str());
+		slots.Release();
+		return r;
+	}
+
 	template <typename... Generators>
 	auto DoCompile(auto afterCompileCallback, Generators... codeContentGenerators)
 	{
@@ -57,11 +273,25 @@ namespace FuncLib::Compile
 		AppendCodeTo(&f, (&codeContentGenerators)...);
 
 		string soFileName = name + ".so";
-		auto compileCmd = string("g++ -O2 -shared -fPIC -I../src -o ") + soFileName + " " + cppFileName + " -std=c++2a"; // TODO > 重定向编译输出
-		auto r = system(compileCmd.c_str());
+		string logFileName = name + ".log";
+		auto r = RunCompiler(CompileFlags() + " -o " + soFileName + " " + cppFileName + " " + LinkFlags(), logFileName);
 		cleaner.Add(soFileName);
+		cleaner.Add(logFileName);
 
-		return afterCompileCallback(cppFileName, soFileName, r);
+		return afterCompileCallback(cppFileName, soFileName, logFileName, r);
+	}
+
+	/// 编译器的输出，临时文件名换成 FuncsDefName，用户代码在最前面，行号就是用户写的行号
+	string ReadDiagnostics(string const& logFileName, string const& cppFileName)
+	{
+		auto bytes = ReadFileBytes(logFileName.c_str());
+		string log(bytes.begin(), bytes.begin() + min(bytes.size(), MaxDiagnosticsSize));
+		for (auto i = log.find(cppFileName); i != string::npos; i = log.find(cppFileName, i))
+		{
+			log.replace(i, cppFileName.size(), FuncsDefName);
+			i += sizeof(FuncsDefName) - 1;
+		}
+		return log;
 	}
 
 	/// 返回编译过后的字节
@@ -70,31 +300,397 @@ namespace FuncLib::Compile
 		defReader->ResetReadPos();
 		auto g1 = defReader->GetLineCodeGenerator();
 		auto g2 = appendCode->GetLineCodeGenerator();
-		auto g = defReader->GetLineCodeGenerator();
-		return DoCompile([](auto cppFileName, auto soFileName, auto cmdReturnValue)
+		return DoCompile([](auto cppFileName, auto soFileName, auto logFileName, auto cmdReturnValue)
 		{
 			if (cmdReturnValue != 0)
 			{
-				throw InvalidOperationException("function definitions have compile error");
+				throw InvalidOperationException("function definitions have compile error:\n" + ReadDiagnostics(logFileName, cppFileName));
 			}
 
 			return ReadFileBytes(soFileName.c_str());
 		}, move(g1), move(g2));
 	}
 
-	FuncsDefReader& CheckGrammar(FuncsDefReader& defReader)
+	/// 和 make -j 一样，最多同时做 jobs 个，当前线程也算一个
+	void RunParallel(size_t count, size_t jobs, auto task)
 	{
-		defReader.ResetReadPos();
-		auto g = defReader.GetLineCodeGenerator();
-		DoCompile([](auto cppFileName, auto soFileName, auto cmdReturnValue)
+		atomic<size_t> next = 0;
+		mutex exceptionMutex;
+		exception_ptr exception = nullptr;
+		auto work = [&]
 		{
-			if (cmdReturnValue != 0)
+			for (size_t i; (i = next++) < count;)
+			{
+				try
+				{
+					task(i);
+				}
+				catch (...)
+				{
+					lock_guard<mutex> guard(exceptionMutex);
+					if (exception == nullptr)
+					{
+						exception = std::current_exception();
+					}
+				}
+			}
+		};
+
+		vector<thread> workers;
+		for (size_t i = 1; i < min(jobs, count); ++i)
+		{
+			workers.emplace_back(work);
+		}
+		work();
+		for (auto& w : workers)
+		{
+			w.join();
+		}
+
+		if (exception != nullptr)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+
+	/// 行号用回用户代码里的，编译错误信息和 __LINE__ 都和整个一起编译时一样
+	string LineDirective(string_view code, size_t pos)
+	{
+		auto line = ::std::count(code.begin(), code.begin() + pos, '\n') + 1;
+		return "#line " + to_string(line) + " \"" + FuncsDefName + "\"\n";
+	}
+
+	bool IsIdentifierChar(char c)
+	{
+		return ::std::isalnum(static_cast<unsigned char>(c)) or c == '_';
+	}
+
+	/// name 作为一个完整的标识符出现在 code 里
+	bool Refers(string_view code, string_view name)
+	{
+		for (auto i = code.find(name); i != string_view::npos; i = code.find(name, i + 1))
+		{
+			auto end = i + name.size();
+			if ((i == 0 or not IsIdentifierChar(code[i - 1])) and (end == code.size() or not IsIdentifierChar(code[end])))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/// 跳过从 pos 开始的注释或字面量，返回它后面的位置，不是的话返回 pos
+	size_t SkipCommentOrLiteral(string_view code, size_t pos)
+	{
+		if (code.substr(pos, 2) == "//")
+		{
+			return min(code.find('\n', pos), code.size());
+		}
+		if (code.substr(pos, 2) == "/*")
+		{
+			auto end = code.find("*/", pos + 2);
+			return end == string_view::npos ? code.size() : end + 2;
+		}
+		if (auto quote = code[pos]; quote == '"' or quote == '\'')
+		{
+			for (++pos; pos < code.size() and code[pos] != quote; ++pos)
+			{
+				if (code[pos] == '\\')
+				{
+					++pos;
+				}
+			}
+			return min(pos + 1, code.size());
+		}
+		return pos;
+	}
+
+	/// 命名空间作用域的一条语句（不带分号）只是声明，每份都放一遍也不会多出变量或函数
+	bool OnlyDeclares(string_view statement)
+	{
+		vector<string_view> words;
+		for (size_t i = 0; i < statement.size();)
+		{
+			auto end = i;
+			while (end < statement.size() and IsIdentifierChar(statement[end]))
+			{
+				++end;
+			}
+			if (end > i)
+			{
+				words.push_back(statement.substr(i, end - i));
+			}
+			i = end + 1;
+		}
+		if (words.empty())
+		{
+			return false;
+		}
+
+		auto& first = words.front();
+		if (first == "using" or first == "typedef" or first == "template" or first == "static_assert")
+		{
+			return true;
+		}
+		if (first == "struct" or first == "class" or first == "union" or first == "enum")
+		{
+			// 类型定义后面不能接着定义变量，像 struct A { } a;
+			if (auto close = statement.rfind('}'); close != string_view::npos)
 			{
-				throw InvalidOperationException("function definitions have compile error");
+				auto rest = statement.substr(close + 1);
+				return ::std::all_of(rest.begin(), rest.end(), [](unsigned char c) { return ::std::isspace(c); });
 			}
-		}, move(g));
+			// 前置声明 struct A; enum class E : int;
+			return words.size() == 2 or (first == "enum" and (words[1] == "class" or words[1] == "struct"));
+		}
+		return false;
+	}
 
-		return defReader;
+	/// 函数以外的代码只有预处理、using 和类型的声明，分开编译时可以每份都放一遍
+	/// 有变量这些定义时每份都会有一个，static 的各用各的也链接得上，只能整个一起编译
+	bool GapsOnlyDeclare(string_view code, vector<FuncDefRange> const& ranges)
+	{
+		for (size_t i = 0, gapBegin = 0; i <= ranges.size(); ++i)
+		{
+			auto gapEnd = i < ranges.size() ? ranges[i].Begin : code.size();
+			auto gap = code.substr(gapBegin, gapEnd - gapBegin);
+			auto statementBegin = string_view::npos;
+			auto depth = 0;
+			for (size_t j = 0; j < gap.size();)
+			{
+				if (statementBegin == string_view::npos and gap[j] == '#')
+				{
+					// 预处理的行，带着续行
+					while (j < gap.size() and not (gap[j] == '\n' and gap[j - 1] != '\\'))
+					{
+						++j;
+					}
+					continue;
+				}
+				if (auto next = SkipCommentOrLiteral(gap, j); next != j)
+				{
+					j = next;
+					continue;
+				}
+
+				auto c = gap[j++];
+				if (statementBegin == string_view::npos)
+				{
+					if (::std::isspace(static_cast<unsigned char>(c)) or c == ';')
+					{
+						continue;
+					}
+					statementBegin = j - 1;
+				}
+				if (c == '{')
+				{
+					++depth;
+				}
+				else if (c == '}')
+				{
+					--depth;
+				}
+				else if (c == ';' and depth == 0)
+				{
+					if (not OnlyDeclares(gap.substr(statementBegin, j - 1 - statementBegin)))
+					{
+						return false;
+					}
+					statementBegin = string_view::npos;
+				}
+			}
+			// 没有分号结束的，像 namespace { }，不认识
+			if (statementBegin != string_view::npos)
+			{
+				return false;
+			}
+
+			if (i < ranges.size())
+			{
+				gapBegin = ranges[i].End;
+			}
+		}
+		return true;
+	}
+
+	/// 分开编译的一份代码：函数以外的代码（include 这些声明）每份都有，用到的别的份的函数放声明，
+	/// 然后是分到的 [begin, end) 这些函数和它们的 wrapper
+	string ChunkCode(string_view code, vector<FuncDefRange> const& ranges, vector<FuncObj> const& funcObjs,
+		vector<vector<string>> const& wrapperFuncsDef, size_t begin, size_t end)
+	{
+		string chunk;
+		for (size_t i = 0, gapBegin = 0; i <= ranges.size(); ++i)
+		{
+			auto gapEnd = i < ranges.size() ? ranges[i].Begin : code.size();
+			auto gap = code.substr(gapBegin, gapEnd - gapBegin);
+			if (not ::std::all_of(gap.begin(), gap.end(), [](unsigned char c) { return ::std::isspace(c); }))
+			{
+				chunk.append(LineDirective(code, gapBegin)).append(gap).push_back('\n');
+			}
+			if (i < ranges.size())
+			{
+				gapBegin = ranges[i].End;
+			}
+		}
+
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			if (i >= begin and i < end)
+			{
+				continue;
+			}
+
+			auto& name = funcObjs[i].Type.FuncName;
+			for (auto j = begin; j < end; ++j)
+			{
+				if (Refers(code.substr(ranges[j].BodyBegin, ranges[j].End - ranges[j].BodyBegin), name))
+				{
+					auto& r = ranges[i];
+					chunk.append(LineDirective(code, r.Begin)).append(code.substr(r.Begin, r.BodyBegin - r.Begin)).append(";\n");
+					break;
+				}
+			}
+		}
+
+		for (auto i = begin; i < end; ++i)
+		{
+			auto& r = ranges[i];
+			chunk.append(LineDirective(code, r.Begin)).append(code.substr(r.Begin, r.End - r.Begin)).push_back('\n');
+		}
+
+		AppendCode appendCode{ {}, { vector(wrapperFuncsDef.begin() + begin, wrapperFuncsDef.begin() + end) } };
+		auto g = appendCode.GetLineCodeGenerator();
+		while (g.MoveNext())
+		{
+			chunk.append(g.Current());
+		}
+		return chunk;
+	}
+
+	struct CompiledObject
+	{
+		vector<char> Bin;
+		/// 编译失败时是编译器的输出
+		string Diagnostics;
+	};
+
+	CompiledObject CompileObject(string const& chunkCode)
+	{
+		FilesCleaner cleaner;
+
+		string name = "temp_compile_" + RandomString();
+		string cppFileName = name + ".cpp";
+		{
+			ofstream f(cppFileName);
+			cleaner.Add(cppFileName);
+			f << chunkCode;
+		}
+
+		string objectFileName = name + ".o";
+		string logFileName = name + ".log";
+		auto r = RunCompiler(CompileFlags() + " -c -o " + objectFileName + " " + cppFileName, logFileName);
+		cleaner.Add(objectFileName);
+		cleaner.Add(logFileName);
+
+		if (r != 0)
+		{
+			auto diagnostics = ReadDiagnostics(logFileName, cppFileName);
+			return { {}, diagnostics.empty() ? string(Compiler) + " exit with " + to_string(r) + "\n" : move(diagnostics) };
+		}
+		return { ReadFileBytes(objectFileName.c_str()), {} };
+	}
+
+	/// 链接不上时返回空
+	optional<vector<char>> LinkObjects(vector<CompiledObject> const& objects)
+	{
+		FilesCleaner cleaner;
+
+		string name = "temp_link_" + RandomString();
+		string objectFileNames;
+		for (size_t i = 0; i < objects.size(); ++i)
+		{
+			auto objectFileName = name + "_" + to_string(i) + ".o";
+			ofstream f(objectFileName, ofstream::binary);
+			cleaner.Add(objectFileName);
+			f.write(objects[i].Bin.data(), objects[i].Bin.size());
+			objectFileNames.append(" " + objectFileName);
+		}
+
+		string soFileName = name + ".so";
+		string logFileName = name + ".log";
+		auto r = RunCompiler("-shared -o " + soFileName + objectFileNames + " " + LinkFlags(), logFileName);
+		cleaner.Add(soFileName);
+		cleaner.Add(logFileName);
+
+		if (r != 0)
+		{
+			return nullopt;
+		}
+		return ReadFileBytes(soFileName.c_str());
+	}
+
+	/// 目标文件的缓存用的 key，分开编译的一份没有变就可以接着用
+	string ObjectCacheKey(string const& chunkCode)
+	{
+		return "object\n" + CompilerVersion() + CompileFlags() + '\n' + RuntimeFingerprint() + '\n' + NormalizeCode(chunkCode);
+	}
+
+	/// 按函数的个数平均分成 chunkCount 份，每份编译成目标文件，最多同时 jobs 个，再链接成一个共享库
+	/// 个数不变时分法就不变，重新添加时没改的那几份可以用缓存里的目标文件
+	/// 链接不上（比如 static 函数被别的份用到）时退回到整个一起编译
+	vector<char> CompileInChunks(FuncsDefReader* defReader, string_view code, vector<FuncDefRange> const& ranges,
+		vector<FuncObj> const& funcObjs, AppendCode const* appendCode, size_t chunkCount, size_t jobs, CompileCache* cache)
+	{
+		auto n = funcObjs.size();
+		vector<string> chunkCodes;
+		for (size_t i = 0; i < chunkCount; ++i)
+		{
+			chunkCodes.push_back(ChunkCode(code, ranges, funcObjs, appendCode->ExternCBody.WrapperFuncDefs, i * n / chunkCount, (i + 1) * n / chunkCount));
+		}
+
+		vector<CompiledObject> objects(chunkCount);
+		RunParallel(chunkCount, jobs, [&](size_t i)
+		{
+			string key;
+			if (cache != nullptr)
+			{
+				key = ObjectCacheKey(chunkCodes[i]);
+				if (auto bin = cache->Get(key); bin.has_value())
+				{
+					objects[i].Bin = move(*bin);
+					return;
+				}
+			}
+
+			objects[i] = CompileObject(chunkCodes[i]);
+			if (cache != nullptr and objects[i].Diagnostics.empty())
+			{
+				cache->Put(key, objects[i].Bin);
+			}
+		});
+
+		// 每份的错误都报出来，不是只报第一个
+		string diagnostics;
+		for (auto& o : objects)
+		{
+			diagnostics.append(o.Diagnostics);
+		}
+		if (not diagnostics.empty())
+		{
+			diagnostics.resize(min(diagnostics.size(), MaxDiagnosticsSize));
+			throw InvalidOperationException("function definitions have compile error:\n" + diagnostics);
+		}
+
+		if (auto bin = LinkObjects(objects); bin.has_value())
+		{
+			return move(*bin);
+		}
+		return GetCompiledByteOnUnix(defReader, appendCode);
+	}
+
+	size_t DefaultCompileJobs()
+	{
+		return max(1u, thread::hardware_concurrency());
 	}
 
 	vector<string> GenerateWrapperFunc(FuncType const& funcType, vector<string> const& paraNames)
@@ -155,10 +751,8 @@ namespace FuncLib::Compile
 	{
 		vector<vector<string>> wrapperFuncsDef;
 		vector<FuncObj> funcObjs;
-		vector<string> headers
-		{
-			"Unity.hpp",
-		};
+		// RuntimeHeader 在编译命令里 -include 了
+		vector<string> headers;
 
 		for (auto& f : funcs)
 		{
@@ -200,18 +794,53 @@ namespace FuncLib::Compile
 		return code;
 	}
 
-	pair<vector<FuncObj>, vector<char>> Compile(FuncsDefReader defReader)
+	/// 解析不了的代码多半有语法错误，这时单独编译一次用户代码，报编译器的错误，没有的话再报解析的错误
+	vector<tuple<FuncType, vector<string>>> ParseFuncOrReportCompileError(FuncsDefReader* defReader, string_view code, vector<FuncDefRange>* ranges)
 	{
-		auto [wrapperFuncsDef, funcObjs, headersToAdd] = defReader | CheckGrammar | ReadAllCode | ParseFunc | ProcessFuncs;
+		try
+		{
+			return ParseFunc(code, ranges);
+		}
+		catch (InvalidOperationException const&)
+		{
+			AppendCode noAppend;
+			GetCompiledByteOnUnix(defReader, &noAppend);
+			throw;
+		}
+	}
+
+	pair<vector<FuncObj>, vector<char>> Compile(FuncsDefReader defReader, CompileCache* cache, size_t jobs)
+	{
+		auto allCode = ReadAllCode(defReader);
+		vector<FuncDefRange> ranges;
+		// 语法错误由下面唯一的一次编译报出来，不用为了检查语法先单独编译一遍
+		auto [wrapperFuncsDef, funcObjs, headersToAdd] = ParseFuncOrReportCompileError(&defReader, allCode, &ranges) | ProcessFuncs;
 		
 		AppendCode code{ move(headersToAdd), move(wrapperFuncsDef) };
 
+		string key;
+		if (cache != nullptr)
+		{
+			key = CompileCacheKey(allCode, code);
+			if (auto bins = cache->Get(key); bins.has_value())
+			{
+				return { move(funcObjs), move(*bins) };
+			}
+		}
+
 #ifdef _MSVC_LANG
 		auto bins = CompileOnWindows(defReader, &appendCode);
 #else // __clang__ or __GNUC__
-		auto bins = GetCompiledByteOnUnix(&defReader, &code);
+		auto chunkCount = GapsOnlyDeclare(allCode, ranges) ? min(jobs, funcObjs.size() / MinFuncsPerChunk) : 1;
+		auto bins = chunkCount > 1
+			? CompileInChunks(&defReader, allCode, ranges, funcObjs, &code, chunkCount, jobs, cache)
+			: GetCompiledByteOnUnix(&defReader, &code);
 #endif
 
+		if (cache != nullptr)
+		{
+			cache->Put(key, bins);
+		}
 		return { move(funcObjs), bins };
 	}
 
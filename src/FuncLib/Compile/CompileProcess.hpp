@@ -13,6 +13,13 @@ namespace FuncLib::Compile
 	using ::std::string_view;
 	using ::std::vector;
 
-	pair<vector<FuncObj>, vector<char>> Compile(FuncsDefReader defReader);
+	class CompileCache;
+
+	/// 默认同时跑几个编译进程，是 CPU 的核数
+	size_t DefaultCompileJobs();
+	/// cache 不为空时先在里面找同样输入的编译结果，找不到再编译，编译的结果放进去
+	/// 函数多的话分成几份，最多同时 jobs 个进程编译，再链接到一起
+	/// 不管多少个线程同时调用，整个进程里同时跑的编译器进程最多 DefaultCompileJobs() 个
+	pair<vector<FuncObj>, vector<char>> Compile(FuncsDefReader defReader, CompileCache* cache = nullptr, size_t jobs = DefaultCompileJobs());
 	string GetWrapperFuncName(string_view rawName);
 }
\ No newline at end of file
@@ -7,6 +7,8 @@ namespace FuncLib::Compile
 	using Basic::TrimFirstChar;
 	using ::std::move;
 
+	constexpr char const DefaultPackage[] = "Global";
+
 	vector<string> ParseZeroOrMore(string_view s, char divider)
 	{
 		vector<string> units;
@@ -51,8 +53,7 @@ namespace FuncLib::Compile
 		// 我希望排序的时候优先比较 package，所以把包名放在了前面
 		if (Package.empty())
 		{
-			char DefalutPackage[] = "Global";
-			s.append(DefalutPackage);
+			s.append(DefaultPackage);
 		}
 		else
 		{
@@ -80,4 +81,64 @@ namespace FuncLib::Compile
 	{
 		return ToKey();
 	}
+
+	// FNV-1a
+	constexpr uint64_t FnvOffset = 14695981039346656037ull;
+	constexpr uint64_t FnvPrime = 1099511628211ull;
+
+	void HashAppend(uint64_t& h, string_view s)
+	{
+		for (unsigned char c : s)
+		{
+			h = (h ^ c) * FnvPrime;
+		}
+	}
+
+	uint64_t FuncType::Hash() const
+	{
+		uint64_t h = FnvOffset;
+		// 分隔符和 ToKey 里的一样，这样 key 相同的 hash 也相同
+		if (Package.empty())
+		{
+			HashAppend(h, DefaultPackage);
+		}
+		else
+		{
+			for (auto i = 0; i < Package.size(); ++i)
+			{
+				if (i != 0)
+				{
+					HashAppend(h, ".");
+				}
+				HashAppend(h, Package[i]);
+			}
+		}
+		HashAppend(h, " ");
+		HashAppend(h, ReturnType);
+		HashAppend(h, " ");
+		HashAppend(h, FuncName);
+
+		for (auto i = 0; i < ArgTypes.size(); ++i)
+		{
+			HashAppend(h, i == 0 ? " " : ",");
+			HashAppend(h, ArgTypes[i]);
+		}
+
+		return h;
+	}
+
+	bool IsDefaultPackage(vector<string> const& package)
+	{
+		return package.empty() or (package.size() == 1 and package[0] == DefaultPackage);
+	}
+
+	bool FuncType::operator== (FuncType const& that) const
+	{
+		// 没有包名的存的时候是 Global
+		auto samePackage = IsDefaultPackage(Package) or IsDefaultPackage(that.Package)
+			? IsDefaultPackage(Package) and IsDefaultPackage(that.Package)
+			: Package == that.Package;
+
+		return samePackage and FuncName == that.FuncName and ReturnType == that.ReturnType and ArgTypes == that.ArgTypes;
+	}
 }
@@ -1,12 +1,14 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <string_view>
 
 namespace FuncLib::Compile
 {
 	using ::std::string;
 	using ::std::string_view;
+	using ::std::uint64_t;
 	using ::std::vector;
 
 	// 包含包名、函数名、返回值类型、参数类型
@@ -24,5 +26,9 @@ namespace FuncLib::Compile
 		// 可以像 TiKV 那样对 Key 对 package name 做一些优化存储
 		string ToKey() const;
 		string ToString() const;
+		/// 和 ToKey 对应的 64 位 hash，直接在各字段上算，不拼出 key 字符串
+		uint64_t Hash() const;
+		/// 逐字段比较，ToKey 相同的才相等
+		bool operator== (FuncType const& that) const;
 	};
 }
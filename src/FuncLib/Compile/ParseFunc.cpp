@@ -103,6 +103,21 @@ namespace FuncLib::Compile
 		};
 	}
 
+	/// Result not include c
+	/// 不含 c 就解析失败，签名里的 ( ) { 必须都在
+	constexpr auto MakeStopAtParser(char c)
+	{
+		return [stopParser=MakeStopWhileEncounterParser(c)](ParserInput s) -> ParserResult<string_view>
+		{
+			if (auto r = stopParser(s); not r->second.empty())
+			{
+				return r;
+			}
+
+			return std::nullopt;
+		};
+	}
+
 	// 为什么这个就不用放到 std namespace 里，上次在 ByteConverter 那里就用
 	// 不过那次是加两个 array，然后使用的地方是在 ByteConverter 特化的类里面，可能依赖查找的地方就不一样了
 	template <typename T, auto N>
@@ -248,11 +263,11 @@ namespace FuncLib::Compile
 		auto isSpace = [](char c) { return std::isspace(c); };
 
 		/// parse result: return type, name, argstr
-		return LastTwo(MakeStopWhileEncounterParser('('), MakeStopWhileEncounterParser(isSpace))  // return type and func name
+		return LastTwo(MakeStopAtParser('('), MakeStopWhileEncounterParser(isSpace))  // return type and func name
 			> trimFirstChar
-			> pair(MakeStopWhileEncounterParser(')') < trimStart < trimEnd, &operator+<string_view, 2>)
+			> pair(MakeStopAtParser(')') < trimStart < trimEnd, &operator+<string_view, 2>)
 			> trimFirstChar
-			> pair(MakeStopWhileEncounterParser('{') < trimStart < trimEnd, checkStrAfterSign);
+			> pair(MakeStopAtParser('{') < trimStart < trimEnd, checkStrAfterSign);
 	}
 
 	/// body 是包含函数的 { } 的
@@ -341,7 +356,7 @@ namespace FuncLib::Compile
 	}
 
 	/// tuple: FuncType, para name
-	vector<tuple<FuncType, vector<string>>> ParseFunc(string_view code)
+	vector<tuple<FuncType, vector<string>>> ParseFunc(string_view code, vector<FuncDefRange>* ranges)
 	{
 		vector<tuple<FuncType, vector<string>>> funcs;
 		auto signParser = MakeFuncSignParser();
@@ -364,6 +379,19 @@ namespace FuncLib::Compile
 									 move(paraNames)});
 
 					remainCode = CheckFuncBody(inner.second);
+
+					if (ranges != nullptr)
+					{
+						size_t begin = returnType.data() - code.data();
+						// 同一行前面的 static、inline 这些也算在函数里
+						auto lineBegin = code.rfind('\n', begin);
+						lineBegin = lineBegin == string_view::npos ? 0 : lineBegin + 1;
+						if (code.substr(lineBegin, begin - lineBegin).find_first_of("};/") == string_view::npos)
+						{
+							begin = lineBegin;
+						}
+						ranges->push_back({ begin, static_cast<size_t>(inner.second.data() - code.data()), static_cast<size_t>(remainCode.data() - code.data()) });
+					}
 				}
 			}
 
@@ -12,11 +12,22 @@ namespace FuncLib::Compile
 	using ::std::tuple;
 	using ::std::vector;
 
-	/// 前提是代码已经通过编译的检查
+	/// 函数定义在代码里的位置
+	struct FuncDefRange
+	{
+		size_t Begin;
+		/// 函数体的 { 的位置
+		size_t BodyBegin;
+		size_t End;
+	};
+
+	/// 代码没有先编译检查过，可能有语法错误：这时只保证不崩溃，能解析出什么就返回什么，
+	/// 或者抛 InvalidOperationException，准确的错误由之后的编译报出来
 	/// 不支持全局变量
 	/// 不支持模板，以及非 JSON 包含的基本类型作为参数和返回值，比如参数类型不支持指针类型
 	/// 包含一点对函数体内容的检测
 	/// tuple: FuncType, para name
-	vector<tuple<FuncType, vector<string>>> ParseFunc(string_view code);
+	/// ranges 不为空时按顺序放入每个函数的位置
+	vector<tuple<FuncType, vector<string>>> ParseFunc(string_view code, vector<FuncDefRange>* ranges = nullptr);
 	pair<bool, size_t> CheckBracesBalance(string_view s, size_t& i);
 }
@@ -1,7 +1,56 @@
+#include <unistd.h>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #include "SharedLibrary.hpp"
 
 namespace FuncLib::Compile
 {
+	using ::std::nullopt;
+	using ::std::to_string;
+
+	SharedLibrary::SharedLibrary(void* handle, int memFd) : _handle(handle), _memFd(memFd)
+	{ }
+
+	optional<SharedLibrary> SharedLibrary::OpenInMemory(char const* bytes, size_t size)
+	{
+#ifdef __linux__
+		auto fd = ::memfd_create("func_lib", MFD_CLOEXEC);
+		if (fd == -1)
+		{
+			return nullopt;
+		}
+
+		for (size_t written = 0; written < size;)
+		{
+			auto n = ::write(fd, bytes + written, size - written);
+			if (n == -1 and errno == EINTR)
+			{
+				continue;
+			}
+			if (n <= 0)
+			{
+				::close(fd);
+				return nullopt;
+			}
+			written += n;
+		}
+
+		// fd 要一直开着：关了之后号会被复用，同样的路径 dlopen 会拿到之前打开的库
+		auto path = "/proc/self/fd/" + to_string(fd);
+		auto handle = dlopen(path.c_str(), RTLD_LAZY);
+		if (handle == nullptr)
+		{
+			// 比如没有挂载 /proc
+			::close(fd);
+			return nullopt;
+		}
+		return SharedLibrary(handle, fd);
+#else
+		return nullopt;
+#endif
+	}
 	SharedLibrary::SharedLibrary(char const* filename) : _handle(dlopen(filename, RTLD_LAZY))
 	{
 		if (_handle == nullptr)
@@ -14,9 +63,10 @@ namespace FuncLib::Compile
 	{ }
 
 	SharedLibrary::SharedLibrary(SharedLibrary&& that) noexcept
-		: _handle(that._handle)
+		: _handle(that._handle), _memFd(that._memFd)
 	{
 		that._handle = nullptr;
+		that._memFd = -1;
 	}
 
 	SharedLibrary::~SharedLibrary()
@@ -29,6 +79,10 @@ namespace FuncLib::Compile
 			// 2.出错了本程序也处理不了，错了对本程序没有影响
 			// 想错误处理请显式使用 Close 函数
 		}
+		if (_memFd != -1)
+		{
+			::close(_memFd);
+		}
 	}
 
 	void SharedLibrary::Close()
@@ -41,5 +95,10 @@ namespace FuncLib::Compile
 			}
 			_handle = nullptr;
 		}
+		if (_memFd != -1)
+		{
+			::close(_memFd);
+			_memFd = -1;
+		}
 	}
 }
@@ -1,20 +1,29 @@
 #pragma once
 #include <dlfcn.h>
 #include <string>
+#include <optional>
 #include "../Basic/Exception.hpp"
 
 namespace FuncLib::Compile
 {
 	using Basic::InvalidOperationException;
 	using ::std::forward;
+	using ::std::optional;
+	using ::std::size_t;
 	using ::std::string;
 
 	class SharedLibrary
 	{
 	private:
 		void* _handle;
+		/// 从内存打开的库，它的内容在这个 fd 里，关闭库之后再关
+		int _memFd = -1;
+
+		SharedLibrary(void* handle, int memFd);
 
 	public:
+		/// 从内存里的 .so 内容打开，不经过磁盘上的文件。系统不支持时返回 nullopt
+		static optional<SharedLibrary> OpenInMemory(char const* bytes, size_t size);
 		SharedLibrary(char const* filename);
 		SharedLibrary(string const& filename);
 		SharedLibrary(SharedLibrary&& that) noexcept;
@@ -22,9 +31,9 @@ namespace FuncLib::Compile
 		~SharedLibrary();
 		void Close();
 
-		// 返回值 decltype(auto) 是我在 CompileProcess 使用后感觉
-		template <typename Func, typename... Args>
-		decltype(auto) Invoke(char const* funcName, Args&&... args)
+		/// 查出来的指针在库关闭之前一直有效，可以存下来反复调用
+		template <typename Func>
+		Func* GetFunc(char const* funcName)
 		{
 			auto func = reinterpret_cast<Func*>(dlsym(_handle, funcName));
 			if (func == nullptr)
@@ -33,7 +42,14 @@ namespace FuncLib::Compile
 				throw InvalidOperationException(string("load ") + funcName + " failed: " + error);
 			}
 
-			return func(forward<Args>(args)...);
+			return func;
+		}
+
+		// 返回值 decltype(auto) 是我在 CompileProcess 使用后感觉
+		template <typename Func, typename... Args>
+		decltype(auto) Invoke(char const* funcName, Args&&... args)
+		{
+			return GetFunc<Func>(funcName)(forward<Args>(args)...);
 		}
 
 		template <typename Func, typename... Args>
@@ -1,9 +1,5 @@
-// For dynamic link cpp file pass compile
-// 也就是说运行的时候，下面这些 cpp 文件源代码要拿出来
+// 编译函数时用 -include 放在最前面，这样可以用预编译好的 Unity.hpp.gch
+// 只放声明，实现在预先编译好的 libFuncRuntime.so 里，函数的库链接它，不用每次都编译一遍 Json 这些
 #include <tuple>
-#include "Json/Json.cpp"
-#include "Basic/Debug.cpp"
-#include "Basic/Exception.cpp"
-#include "Json/JsonConverter/JsonConverter.cpp"
-#include "Json/ParseException.cpp"
-#include "Json/LocationInfo.cpp"
+#include "Json/Json.hpp"
+#include "Json/JsonConverter/JsonConverter.hpp"
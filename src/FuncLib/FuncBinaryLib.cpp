@@ -1,14 +1,47 @@
+#include <algorithm>
 #include "FuncBinaryLib.hpp"
 
 namespace FuncLib
 {
-	FuncBinaryLib::FuncBinaryLib(decltype(_file) file) : _file(move(file))
+	using ::std::min;
+	using ::std::pair;
+	using ::std::partial_sort;
+	using ::std::filesystem::exists;
+
+	constexpr pos_label InvokeStatLabel = 100;
+
+	FuncBinaryLib::FuncBinaryLib(decltype(_file) file, decltype(_statFile) statFile, decltype(_invokeStat) invokeStat)
+		: _file(move(file)), _statFile(move(statFile)), _invokeStat(move(invokeStat))
 	{ }
 
-	FuncBinaryLib FuncBinaryLib::GetFrom(path const& path)
+	FuncBinaryLib FuncBinaryLib::GetFrom(path const& binPath, path const& statPath)
+	{
+		auto f = File::GetFile(binPath);
+
+		auto firstSetup = not exists(statPath);
+		auto statFile = File::GetFile(statPath);
+		shared_ptr<InvokeStat> stat;
+		if (firstSetup)
+		{
+			auto [l, s] = statFile->New(InvokeStatLabel, InvokeStat());
+			statFile->Store(l, s);
+			stat = move(s);
+		}
+		else
+		{
+			stat = statFile->Read<InvokeStat>(InvokeStatLabel);
+		}
+
+		return FuncBinaryLib(move(f), move(statFile), move(stat));
+	}
+
+	FuncBinaryLib::~FuncBinaryLib()
 	{
-		auto f = File::GetFile(path);
-		return FuncBinaryLib(move(f));
+		// 被移动过的没有文件
+		if (_statFile != nullptr)
+		{
+			StoreInvokeStat();
+		}
 	}
 
 	void FuncBinaryLib::DecreaseRefCount(pos_label label)
@@ -20,32 +53,236 @@ namespace FuncLib
 		{
 			if (_cache.contains(label))
 			{
-				_cache.erase(label);
+				Unload(label);
 			}
 			_file->Delete(label, binUnitObj);
+			if (_invokeStat->Counts.erase(label) > 0)
+			{
+				_invokeStatChanged = true;
+			}
+		}
+		else
+		{
+			_file->Store(label, binUnitObj);
 		}
 	}
 
 	shared_ptr<SharedLibWithCleaner> FuncBinaryLib::Load(pos_label label)
 	{
-		if (_cache.contains(label))
+		if (auto it = _cache.find(label); it != _cache.end())
 		{
-			return _cache[label];
+			++_loadMetrics.Hits;
+			return it->second.Lib;
 		}
 
 		auto binPtr = ReadBin(label);
-		string tempFileName = "temp_invoke" + RandomString() + ".so";
+		EvictIdle();
+		EvictFor(1, binPtr->size());
+		shared_ptr<SharedLibWithCleaner> lib;
+		// 直接从内存打开，不用把整个 .so 写一遍磁盘，崩溃了也不会留下临时文件
+		if (auto inMemory = SharedLibrary::OpenInMemory(binPtr->data(), binPtr->size()); inMemory.has_value())
 		{
-			ofstream of(tempFileName);
-			of.write(binPtr->data(), binPtr->size());
+			lib = make_shared<SharedLibWithCleaner>(move(*inMemory));
+		}
+		else
+		{
+			// 不带路径的名字 dlopen 不会在当前目录找
+			string tempFileName = "./temp_invoke" + RandomString() + ".so";
+			{
+				ofstream of(tempFileName);
+				of.write(binPtr->data(), binPtr->size());
+			}
+			lib = make_shared<SharedLibWithCleaner>(move(tempFileName));
 		}
-		auto lib = make_shared<SharedLibWithCleaner>(move(tempFileName));
-		_cache.insert({ label, lib });
+		_lru.push_front(label);
+		_cache.insert({ label, LoadedLib{ lib, binPtr->size(), _lru.begin(), steady_clock::now() } });
+		_loadedBytes += binPtr->size();
+		++_loadMetrics.Loads;
 		return lib;
 	}
 
+	shared_ptr<SharedLibWithCleaner> FuncBinaryLib::Find(pos_label label) const
+	{
+		if (auto it = _cache.find(label); it != _cache.end())
+		{
+			return it->second.Lib;
+		}
+		return nullptr;
+	}
+
+	void FuncBinaryLib::CountInvoke(pos_label label)
+	{
+		++_invokeStat->Counts[label];
+		_invokeStatChanged = true;
+
+		if (auto it = _cache.find(label); it != _cache.end())
+		{
+			auto& loaded = it->second;
+			_lru.splice(_lru.begin(), _lru, loaded.LruPos);
+			loaded.LastUse = steady_clock::now();
+		}
+	}
+
+	void FuncBinaryLib::SetLoadedLibLimit(LoadedLibLimit limit)
+	{
+		_limit = limit;
+		EvictFor(0, 0);
+		EvictIdle();
+	}
+
+	void FuncBinaryLib::EvictIdle()
+	{
+		auto now = steady_clock::now();
+		// 从最久没用的开始，碰到没闲置那么久的，前面的就都不用看了
+		for (auto it = _lru.end(); it != _lru.begin();)
+		{
+			auto& loaded = _cache.at(*--it);
+			if (now - loaded.LastUse <= _limit.MaxIdle)
+			{
+				break;
+			}
+			if (not Pinned(loaded))
+			{
+				Unload(*it++);
+				++_loadMetrics.Evictions;
+			}
+		}
+	}
+
+	FuncBinaryLib::LoadMetrics FuncBinaryLib::GetLoadMetrics() const
+	{
+		return _loadMetrics;
+	}
+
+	size_t FuncBinaryLib::LoadedBytes() const
+	{
+		return _loadedBytes;
+	}
+
+	void FuncBinaryLib::Unload(pos_label label)
+	{
+		auto loaded = _cache.extract(label);
+		_lru.erase(loaded.mapped().LruPos);
+		_loadedBytes -= loaded.mapped().Size;
+	}
+
+	bool FuncBinaryLib::Pinned(LoadedLib const& loaded) const
+	{
+		return loaded.Lib.use_count() > 1;
+	}
+
+	void FuncBinaryLib::EvictFor(size_t libs, size_t bytes)
+	{
+		// 被持有的跳过，都被持有时可以暂时超过上限
+		for (auto it = _lru.end(); it != _lru.begin() and (_cache.size() + libs > _limit.MaxLibs or _loadedBytes + bytes > _limit.MaxBytes);)
+		{
+			auto& loaded = _cache.at(*--it);
+			if (not Pinned(loaded))
+			{
+				Unload(*it++);
+				++_loadMetrics.Evictions;
+			}
+		}
+	}
+
+	void FuncBinaryLib::StoreInvokeStat()
+	{
+		if (not _invokeStatChanged)
+		{
+			return;
+		}
+		_statFile->Store(InvokeStatLabel, _invokeStat);
+		_invokeStatChanged = false;
+	}
+
+	bool FuncBinaryLib::WarmUp(WarmUpBudget const& budget, milliseconds timeSlice)
+	{
+		if (not _warmUp.has_value())
+		{
+			vector<pair<uint64_t, pos_label>> hots;
+			for (auto [label, count] : _invokeStat->Counts)
+			{
+				hots.push_back({ count, label });
+			}
+			auto n = min(budget.MaxLibs, hots.size());
+			partial_sort(hots.begin(), hots.begin() + n, hots.end(), [](auto& a, auto& b) { return a.first > b.first; });
+
+			vector<pos_label> labels;
+			for (size_t i = 0; i < n; ++i)
+			{
+				labels.push_back(hots[i].second);
+			}
+			_warmUp = WarmUpProgress{ move(labels), 0, 0, steady_clock::now() };
+		}
+
+		auto& w = *_warmUp;
+		auto sliceStart = steady_clock::now();
+		while (w.Next < w.Labels.size() and steady_clock::now() - w.Start < budget.MaxTime)
+		{
+			if (steady_clock::now() - sliceStart >= timeSlice)
+			{
+				return false;
+			}
+
+			auto label = w.Labels[w.Next++];
+			if (_cache.contains(label))
+			{
+				continue;
+			}
+			try
+			{
+				auto size = ReadBin(label)->size();
+				// 放不下的跳过，后面小一点的也许还放得下。预加载不挤掉已经加载的
+				if (w.Bytes + size > budget.MaxBytes or _cache.size() >= _limit.MaxLibs or _loadedBytes + size > _limit.MaxBytes)
+				{
+					continue;
+				}
+				Load(label);
+				w.Bytes += size;
+			}
+			catch (...)
+			{
+				// 删库后没来得及存下调用次数就停了，会留下这样的 label
+				_invokeStat->Counts.erase(label);
+				_invokeStatChanged = true;
+			}
+		}
+
+		_warmUp.reset();
+		return true;
+	}
+
+	size_t FuncBinaryLib::LoadedCount() const
+	{
+		return _cache.size();
+	}
+
 	vector<char>* FuncBinaryLib::ReadBin(pos_label label)
 	{
 		return &_file->Read<BinUnit>(label)->Bin;
 	}
+
+	optional<File::ReadAwaiter<BinUnit>> FuncBinaryLib::ReadBinAsync(pos_label label, IoEngine::Executor executor)
+	{
+		if (_cache.contains(label) or _file->HasRead<BinUnit>(label))
+		{
+			return {};
+		}
+		return _file->ReadAsync<BinUnit>(label, move(executor));
+	}
+
+	bool FuncBinaryLib::Compact(milliseconds timeSlice)
+	{
+		return _file->Compact(timeSlice);
+	}
+
+	shared_future<void> FuncBinaryLib::Backup(path const& target, size_t bytesPerSecond)
+	{
+		return _file->Backup(target, bytesPerSecond);
+	}
+
+	void FuncBinaryLib::CancelBackup()
+	{
+		_file->CancelBackup();
+	}
 }
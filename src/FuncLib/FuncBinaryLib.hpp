@@ -1,11 +1,18 @@
 #pragma once
+#include <map>
+#include <list>
 #include <vector>
 #include <memory>
+#include <future>
+#include <chrono>
+#include <cstdint>
+#include <optional>
 #include <filesystem>
 #include <unordered_map>
 #include "Store/StaticConfig.hpp"
 #include "Persistence/ByteConverter.hpp"
 #include "Store/File.hpp"
+#include "Store/BlockCompress.hpp"
 
 // temp
 #include <string>
@@ -16,11 +23,19 @@
 namespace FuncLib
 {
 	using FuncLib::Store::File;
+	using FuncLib::Store::IoEngine;
 	using FuncLib::Store::pos_label;
+	using ::std::list;
+	using ::std::map;
 	using ::std::move;
+	using ::std::optional;
+	using ::std::shared_future;
 	using ::std::shared_ptr;
+	using ::std::uint64_t;
 	using ::std::unordered_map;
 	using ::std::vector;
+	using ::std::chrono::milliseconds;
+	using ::std::chrono::steady_clock;
 	using ::std::filesystem::path;
 
 	// temp
@@ -37,6 +52,98 @@ namespace FuncLib
 		vector<char> Bin;
 	};
 
+	/// 每个库被调用的次数，存在单独的文件里，重启后用来决定预先加载哪些库
+	struct InvokeStat
+	{
+		map<pos_label, uint64_t> Counts;
+	};
+
+	/// 启动时预先加载调用次数最多的库，加载多少受下面的限制
+	struct WarmUpBudget
+	{
+		size_t MaxLibs = 64;
+		/// 加载的库的二进制加起来的大小
+		size_t MaxBytes = 64 * 1024 * 1024;
+		/// 从开始预加载算起
+		milliseconds MaxTime = milliseconds(10'000);
+	};
+
+	/// 同时加载着的库的上限，超过了按最久没用的先卸载
+	struct LoadedLibLimit
+	{
+		size_t MaxLibs = 256;
+		/// 加载着的库的二进制加起来的大小
+		size_t MaxBytes = 256 * 1024 * 1024;
+		/// 这么久没用的库也卸载
+		milliseconds MaxIdle = milliseconds(30 * 60 * 1000);
+	};
+}
+
+namespace FuncLib::Persistence
+{
+	using FuncLib::BinUnit;
+	using FuncLib::Store::CompressBlock;
+	using FuncLib::Store::DecompressBlock;
+	using FuncLib::Store::FakeObjectBytes;
+	using ::std::is_same_v;
+
+	/// Bin 大的时候压缩了再存，大小的最高位标记有没有压缩，老文件里没有这一位照样能读
+	template <>
+	struct ByteConverter<BinUnit, false>
+	{
+		using ThisType = BinUnit;
+		static constexpr bool SizeStable = false;
+		static constexpr size_t CompressedFlag = static_cast<size_t>(1) << 63;
+		/// Bin 不小于这个大小才压缩，设成 SIZE_MAX 就不压缩
+		static inline size_t CompressThreshold = 4096;
+
+		static void WriteDown(ThisType const& t, IWriter auto* writer)
+		{
+			ByteConverter<int>::WriteDown(t.RefCount, writer);
+			size_t size = t.Bin.size();
+			// FakeObjectBytes 只是走一遍子对象，不用真的压缩
+			constexpr bool fake = is_same_v<remove_reference_t<decltype(*writer)>, FakeObjectBytes>;
+			if (not fake and size >= CompressThreshold)
+			{
+				auto compressed = CompressBlock(t.Bin.data(), size);
+				// 压不小就存原样的
+				if (compressed.size() < size)
+				{
+					ByteConverter<size_t>::WriteDown(size | CompressedFlag, writer);
+					ByteConverter<size_t>::WriteDown(compressed.size(), writer);
+					writer->Add(compressed.data(), compressed.size());
+					return;
+				}
+			}
+
+			ByteConverter<size_t>::WriteDown(size, writer);
+			writer->Add(t.Bin.data(), size);
+		}
+
+		static ThisType ReadOut(IReader auto* reader)
+		{
+			auto refCount = ByteConverter<int>::ReadOut(reader);
+			auto size = ByteConverter<size_t>::ReadOut(reader);
+			if (size & CompressedFlag)
+			{
+				size &= ~CompressedFlag;
+				auto compressedSize = ByteConverter<size_t>::ReadOut(reader);
+				auto compressed = reader->Read(compressedSize);
+				vector<char> bin(size);
+				DecompressBlock(reinterpret_cast<char const*>(compressed.data()), compressedSize, bin.data(), size);
+				return { refCount, move(bin) };
+			}
+
+			vector<char> bin(size);
+			reader->ReadTo(reinterpret_cast<byte*>(bin.data()), size);
+			return { refCount, move(bin) };
+		}
+	};
+}
+
+namespace FuncLib
+{
+
 	template <typename Callback>
 	class BookingPos
 	{
@@ -71,18 +178,86 @@ namespace FuncLib
 
 	class FuncBinaryLib
 	{
+	public:
+		struct LoadMetrics
+		{
+			size_t Hits = 0;
+			size_t Loads = 0;
+			size_t Evictions = 0;
+		};
+
 	private:
+		struct LoadedLib
+		{
+			shared_ptr<SharedLibWithCleaner> Lib;
+			size_t Size;
+			list<pos_label>::iterator LruPos;
+			steady_clock::time_point LastUse;
+		};
+
+		struct WarmUpProgress
+		{
+			/// 按调用次数从多到少
+			vector<pos_label> Labels;
+			size_t Next;
+			size_t Bytes;
+			steady_clock::time_point Start;
+		};
+
 		shared_ptr<File> _file;
-		unordered_map<pos_label, shared_ptr<SharedLibWithCleaner>> _cache;
+		unordered_map<pos_label, LoadedLib> _cache;
+		/// 最近用过的在前面
+		list<pos_label> _lru;
+		size_t _loadedBytes = 0;
+		LoadedLibLimit _limit;
+		LoadMetrics _loadMetrics;
+		shared_ptr<File> _statFile;
+		shared_ptr<InvokeStat> _invokeStat;
+		/// 调用次数改过，还没存下
+		bool _invokeStatChanged = false;
+		optional<WarmUpProgress> _warmUp;
 
-		FuncBinaryLib(decltype(_file) file);
+		FuncBinaryLib(decltype(_file) file, decltype(_statFile) statFile, decltype(_invokeStat) invokeStat);
 		
 	public:
-		static FuncBinaryLib GetFrom(path const& path);
+		static FuncBinaryLib GetFrom(path const& binPath, path const& statPath);
+		FuncBinaryLib(FuncBinaryLib&& that) noexcept = default;
+		~FuncBinaryLib();
 		void DecreaseRefCount(pos_label label);
+		/// 加载时先卸载闲置的库，加载后超过上限的话再卸载最久没用的库。正在调用的库还被别处持有，不会被卸载
 		shared_ptr<SharedLibWithCleaner> Load(pos_label label);
+		/// 只找已经加载的，没有返回空
+		shared_ptr<SharedLibWithCleaner> Find(pos_label label) const;
+		/// 记下调用次数，也是库最近用过。次数只在内存里加，由 StoreInvokeStat 存下
+		void CountInvoke(pos_label label);
+		void SetLoadedLibLimit(LoadedLibLimit limit);
+		/// 卸载超过 LoadedLibLimit::MaxIdle 没用的库。调用时不检查，加载时和调用者定期调用时才卸载
+		void EvictIdle();
+		LoadMetrics GetLoadMetrics() const;
+		size_t LoadedBytes() const;
+		/// 有没存下的调用次数时存下，由调用者定期调用，析构时也会存
+		void StoreInvokeStat();
+		/// 按调用次数从多到少加载库，每次调用最多做 timeSlice 这么久。Return true when warm-up is completed
+		bool WarmUp(WarmUpBudget const& budget, milliseconds timeSlice);
+		size_t LoadedCount() const;
 		vector<char>* ReadBin(pos_label label);
+		/// 库还没加载、二进制也还没读进来的话返回一个读它的 awaiter，co_await 完再 Load 就不用等硬盘了
+		optional<File::ReadAwaiter<BinUnit>> ReadBinAsync(pos_label label, IoEngine::Executor executor);
+		/// Return true when compact is completed
+		bool Compact(milliseconds timeSlice);
+		/// 在线备份到 target，返回的 future 完成时备份做完
+		shared_future<void> Backup(path const& target, size_t bytesPerSecond);
+		/// 停掉还在复制的备份，见 File::CancelBackup
+		void CancelBackup();
 
+	private:
+		void Unload(pos_label label);
+		/// 没有别处持有的才能卸载
+		bool Pinned(LoadedLib const& loaded) const;
+		/// 卸载到还能再放下 libs 个加起来 bytes 大的库
+		void EvictFor(size_t libs, size_t bytes);
+
+	public:
 		auto Add(vector<char> bin)
 		{
 			auto [l, binUnitObj] = _file->New<BinUnit>(BinUnit{ 0, move(bin) });
@@ -118,6 +293,12 @@ namespace FuncLib
 		{
 		}
 
+		/// 从内存打开的库没有要清理的文件
+		SharedLibWithCleaner(SharedLibrary lib) : Base1(move(lib))
+		{
+		}
+
+		using SharedLibrary::GetFunc;
 		using SharedLibrary::Invoke;
 	};
 }
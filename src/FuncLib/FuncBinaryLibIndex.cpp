@@ -15,10 +15,15 @@ namespace FuncLib
 	{
 		if (_file != nullptr and _diskBtree != nullptr)
 		{
-			_file->Store(DiskTreeLable, _diskBtree);
+			Store();
 		}
 	}
 
+	void FuncBinaryLibIndex::Store()
+	{
+		_file->Store(DiskTreeLable, _diskBtree);
+	}
+
 	FuncBinaryLibIndex FuncBinaryLibIndex::GetFrom(path const &path)
 	{
 		auto firstSetup = not exists(path);
@@ -108,7 +113,8 @@ namespace FuncLib
 
 		while (g.MoveNext())
 		{
-			auto p = g.Current();
+			// const 访问，扫描不会把 key 和 value 标记成改动过
+			auto const* p = g.Current();
 			if (includedIn(p->first)) // Key
 			{
 				// 后续如果 FuncType::ToKey 的形成规则变了，这里也要变
@@ -130,14 +136,35 @@ namespace FuncLib
 	}
 #undef STR_TO_DISK_REF_STR
 
+	bool FuncBinaryLibIndex::Compact(milliseconds timeSlice)
+	{
+		return _file->Compact(timeSlice);
+	}
+
+	shared_future<void> FuncBinaryLibIndex::Backup(path const& target, size_t bytesPerSecond)
+	{
+		return _file->Backup(target, bytesPerSecond);
+	}
+
 	Generator<FuncType> FuncBinaryLibIndex::FuncTypes() const
 	{
 		auto g = _diskBtree->GetStoredPairEnumerator();
 		while (g.MoveNext())
 		{
-			auto p = g.Current();
+			auto const* p = g.Current();
 			string k = p->first;
 			co_yield FuncType::FromKey(k);
 		}
 	}
+
+	Generator<pair<FuncType, pos_label>> FuncBinaryLibIndex::FuncTypeLabels() const
+	{
+		auto g = _diskBtree->GetStoredPairEnumerator();
+		while (g.MoveNext())
+		{
+			auto const* p = g.Current();
+			string k = p->first;
+			co_yield { FuncType::FromKey(k), p->second.first };
+		}
+	}
 }
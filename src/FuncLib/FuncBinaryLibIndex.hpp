@@ -1,8 +1,10 @@
 #pragma once
 #include <string>
 #include <memory>
+#include <future>
 #include <filesystem>
 #include <vector>
+#include <chrono>
 #include <utility>
 #include "Store/StaticConfig.hpp"
 #include "Compile/FuncObj.hpp"
@@ -25,9 +27,11 @@ namespace FuncLib
 	using FuncLib::Store::File;
 	using FuncLib::Store::pos_label;
 	using ::std::pair;
+	using ::std::shared_future;
 	using ::std::shared_ptr;
 	using ::std::string;
 	using ::std::vector;
+	using ::std::chrono::milliseconds;
 	using ::std::filesystem::path;
 
 	class FuncBinaryLibIndex
@@ -55,6 +59,13 @@ namespace FuncLib
 		/// pair: Key, summary
 		Generator<pair<string, string>> Search(string const& keyword) const;
 		Generator<FuncType> FuncTypes() const;
+		Generator<pair<FuncType, pos_label>> FuncTypeLabels() const;
+		/// Return true when compact is completed
+		bool Compact(milliseconds timeSlice);
+		/// 在线备份到 target，返回的 future 完成时备份做完
+		shared_future<void> Backup(path const& target, size_t bytesPerSecond);
+		/// 修改后调用，把索引存到文件里
+		void Store();
 		~FuncBinaryLibIndex();
 
 	private:
@@ -0,0 +1,218 @@
+#pragma once
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <utility>
+#include "Compile/FuncType.hpp"
+
+namespace FuncLib
+{
+	using FuncLib::Compile::FuncType;
+	using ::std::move;
+	using ::std::numeric_limits;
+	using ::std::uint32_t;
+	using ::std::uint64_t;
+	using ::std::vector;
+
+	/// 函数类型驻留成紧凑的 id，id 下标存放函数的信息
+	/// 类型到 id 用开放寻址（线性探测）的扁平表，hash 驻留时算好，查找时不分配内存，比较是逐字段的
+	template <typename Value>
+	class FuncTable
+	{
+	public:
+		using FuncId = uint32_t;
+		static constexpr FuncId NoId = numeric_limits<FuncId>::max();
+
+		struct Entry
+		{
+			FuncType Type;
+			uint64_t Hash;
+			Value Val;
+		};
+
+	private:
+		static constexpr FuncId EmptySlot = NoId;
+		static constexpr FuncId DeletedSlot = NoId - 1;
+		static constexpr size_t MinCapacity = 16;
+
+		struct Slot
+		{
+			uint64_t Hash = 0;
+			FuncId Id = EmptySlot;
+		};
+
+		vector<Slot> _slots;
+		vector<Entry> _entries;
+		vector<FuncId> _freeIds;
+		size_t _count = 0;
+		/// 包括删除后留下的墓碑
+		size_t _usedSlots = 0;
+
+	public:
+		FuncId Find(FuncType const& type) const
+		{
+			if (_slots.empty())
+			{
+				return NoId;
+			}
+
+			auto h = type.Hash();
+			auto mask = _slots.size() - 1;
+			for (auto i = h & mask;; i = (i + 1) & mask)
+			{
+				auto& s = _slots[i];
+				if (s.Id == EmptySlot)
+				{
+					return NoId;
+				}
+
+				if (s.Id != DeletedSlot and s.Hash == h and _entries[s.Id].Type == type)
+				{
+					return s.Id;
+				}
+			}
+		}
+
+		bool Contains(FuncType const& type) const
+		{
+			return Find(type) != NoId;
+		}
+
+		/// 已经有的话只更新 value
+		FuncId Add(FuncType type, Value value)
+		{
+			if (auto id = Find(type); id != NoId)
+			{
+				_entries[id].Val = move(value);
+				return id;
+			}
+
+			auto h = type.Hash();
+			FuncId id;
+			if (_freeIds.empty())
+			{
+				id = static_cast<FuncId>(_entries.size());
+				_entries.push_back({ move(type), h, move(value) });
+			}
+			else
+			{
+				id = _freeIds.back();
+				_freeIds.pop_back();
+				_entries[id] = { move(type), h, move(value) };
+			}
+
+			++_count;
+			InsertSlot(h, id);
+			return id;
+		}
+
+		void Remove(FuncId id)
+		{
+			EraseSlot(id);
+			_entries[id] = {};
+			_freeIds.push_back(id);
+			--_count;
+		}
+
+		/// 改类型后 id 不变，value 不变。newType 不能已经在表里
+		void Rekey(FuncId id, FuncType newType)
+		{
+			EraseSlot(id);
+			auto& e = _entries[id];
+			e.Hash = newType.Hash();
+			e.Type = move(newType);
+			InsertSlot(e.Hash, id);
+		}
+
+		Value& operator[] (FuncId id)
+		{
+			return _entries[id].Val;
+		}
+
+		Value const& operator[] (FuncId id) const
+		{
+			return _entries[id].Val;
+		}
+
+		size_t Size() const
+		{
+			return _count;
+		}
+
+	private:
+		void InsertSlot(uint64_t hash, FuncId id)
+		{
+			// 装载率（算上墓碑）不超过 3/4，保证探测一定能碰到空位
+			if ((_usedSlots + 1) * 4 > _slots.size() * 3)
+			{
+				// 重新分配时 id 对应的项已经放好了，会一起插进去
+				Rehash();
+				return;
+			}
+
+			auto mask = _slots.size() - 1;
+			for (auto i = hash & mask;; i = (i + 1) & mask)
+			{
+				auto& s = _slots[i];
+				if (s.Id == EmptySlot or s.Id == DeletedSlot)
+				{
+					if (s.Id == EmptySlot)
+					{
+						++_usedSlots;
+					}
+					s = { hash, id };
+					return;
+				}
+			}
+		}
+
+		void EraseSlot(FuncId id)
+		{
+			auto mask = _slots.size() - 1;
+			for (auto i = _entries[id].Hash & mask;; i = (i + 1) & mask)
+			{
+				if (_slots[i].Id == id)
+				{
+					_slots[i].Id = DeletedSlot;
+					return;
+				}
+			}
+		}
+
+		/// 按存活的个数重新分配，顺便清掉墓碑
+		void Rehash()
+		{
+			auto capacity = MinCapacity;
+			while ((_count + 1) * 2 > capacity)
+			{
+				capacity *= 2;
+			}
+
+			vector<bool> free(_entries.size(), false);
+			for (auto id : _freeIds)
+			{
+				free[id] = true;
+			}
+
+			_slots.assign(capacity, Slot());
+			_usedSlots = 0;
+			auto mask = capacity - 1;
+			for (FuncId id = 0; id < _entries.size(); ++id)
+			{
+				if (free[id])
+				{
+					continue;
+				}
+
+				auto h = _entries[id].Hash;
+				auto i = h & mask;
+				while (_slots[i].Id != EmptySlot)
+				{
+					i = (i + 1) & mask;
+				}
+				_slots[i] = { h, id };
+				++_usedSlots;
+			}
+		}
+	};
+}
@@ -9,83 +9,112 @@ namespace FuncLib
 	using ::std::move;
 	using ::std::filesystem::is_directory;
 
-	FunctionLibrary::FunctionLibrary(decltype(_index) index, decltype(_binLib) binLib)
-		: _index(move(index)), _binLib(move(binLib))
+	FunctionLibrary::FunctionLibrary(decltype(_index) index, decltype(_binLib) binLib, decltype(_compileCache) compileCache)
+		: _index(move(index)), _binLib(move(binLib)), _compileCache(move(compileCache))
 	{
+		auto g = _index.FuncTypeLabels();
+		while (g.MoveNext())
+		{
+			auto& [type, label] = g.Current();
+			_funcs.Add(move(type), { {}, nullptr, label });
+		}
 	}
 
-	FunctionLibrary FunctionLibrary::GetFrom(path dirPath)
+	constexpr auto NoId = FuncTable<ResolvedFuncEntry>::NoId;
+
+	constexpr char const IndexFilename[] = "func.idx";
+	constexpr char const BinFilename[] = "func_bin.lib";
+	constexpr char const CompileCacheFilename[] = "func_compile.cache";
+	constexpr char const InvokeStatFilename[] = "func_invoke.stat";
+
+	void CheckIsDirectory(path const& dirPath)
 	{
 		if (not is_directory(dirPath))
 		{
 			throw InvalidOperationException(string("Cannot operate on path: ") + dirPath.c_str() + " which is not directory");
 		}
+	}
+
+	FunctionLibrary FunctionLibrary::GetFrom(path dirPath)
+	{
+		CheckIsDirectory(dirPath);
 
-		auto indexFilePath = dirPath / "func.idx";
-		auto binFilePath = dirPath / "func_bin.lib";
+		auto indexFilePath = dirPath / IndexFilename;
+		auto binFilePath = dirPath / BinFilename;
 		auto i = FuncBinaryLibIndex::GetFrom(indexFilePath);
-		auto b = FuncBinaryLib::GetFrom(binFilePath);
-		return FunctionLibrary(move(i), move(b));
+		auto b = FuncBinaryLib::GetFrom(binFilePath, dirPath / InvokeStatFilename);
+		auto c = CompileCache::GetFrom(dirPath / CompileCacheFilename);
+		return FunctionLibrary(move(i), move(b), move(c));
+	}
+
+	CompiledFuncs FunctionLibrary::Compile(FuncsDefReader defReader)
+	{
+		return FuncLib::Compile::Compile(move(defReader), &_compileCache);
 	}
 
 	void FunctionLibrary::Add(vector<string> package, FuncsDefReader defReader, string summary)
 	{
-		auto [funcs, bin] = Compile::Compile(move(defReader));
-		auto p = _binLib.Add(move(bin));
+		Add(move(package), Compile(move(defReader)), move(summary));
+	}
 
-		for (auto& f : funcs)
+	void FunctionLibrary::Add(vector<string> package, CompiledFuncs compiled, string summary)
+	{
+		auto& [funcs, bin] = compiled;
 		{
-			f.Type.Package = package;
-			if (_index.Contains(f.Type))
-			{
-				throw InvalidOperationException("Function already exist: " + f.Type.ToString());
-			}
-			else
+			auto p = _binLib.Add(move(bin));
+
+			for (auto& f : funcs)
 			{
-				f.Summary = summary;
-				// 使用 FuncObj 可以生成客户端调用代码
-				_binLib.AddRefCount(p);
-				_index.Add(f, p.Label());
+				f.Type.Package = package;
+				if (_funcs.Contains(f.Type))
+				{
+					throw InvalidOperationException("Function already exist: " + f.Type.ToString());
+				}
+				else
+				{
+					f.Summary = summary;
+					// 使用 FuncObj 可以生成客户端调用代码
+					_binLib.AddRefCount(p);
+					_index.Add(f, p.Label());
+					_funcs.Add(f.Type, { {}, nullptr, p.Label() });
+				}
 			}
 		}
+		// p 析构时二进制已经存下，索引后存，这样索引里不会指向不存在的二进制
+		_index.Store();
 	}
 
 	bool FunctionLibrary::Contains(FuncType const& func) const
 	{
-		return _funcInfoCache.contains(func) or _index.Contains(func);
+		return _funcs.Contains(func);
 	}
 
 #define FUNC_NOT_EXIST_EXCEPTION(FUNC_TYPE) throw InvalidOperationException("Function not exist: " + FUNC_TYPE.ToString())
 
 	void FunctionLibrary::ModifyPackageOf(FuncType const& func, vector<string> package)
 	{
-		if (_funcInfoCache.contains(func) or _index.Contains(func))
+		if (auto id = _funcs.Find(func); id != NoId)
 		{
-			if (_funcInfoCache.contains(func))
-			{
-				auto item = _funcInfoCache.extract(func);
-				item.key().Package = package;
-				_funcInfoCache.insert(move(item));
-			}
-
-			return _index.ModifyPackageOf(func, move(package));
+			auto newType = func;
+			newType.Package = package;
+			_index.ModifyPackageOf(func, move(package));
+			// 库没变，解析好的地址还能用
+			_funcs.Rekey(id, move(newType));
+			_index.Store();
+			return;
 		}
 
-
 		FUNC_NOT_EXIST_EXCEPTION(func);
 	}
 
 	void FunctionLibrary::Remove(FuncType const& func)
 	{
-		if (_index.Contains(func))
+		if (auto id = _funcs.Find(func); id != NoId)
 		{
-			auto l = GetStoreLabel(func);
-			_binLib.DecreaseRefCount(l);
-			if (_funcInfoCache.contains(func))
-			{
-				_funcInfoCache.erase(func);
-			}
+			_binLib.DecreaseRefCount(_funcs[id].Label);
+			_funcs.Remove(id);
 			_index.Remove(func);
+			_index.Store();
 			return;
 		}
 
@@ -94,10 +123,9 @@ namespace FuncLib
 
 	JsonObject FunctionLibrary::Invoke(FuncType const& func, JsonObject args)
 	{
-		auto l = GetStoreLabel(func);
-		auto libPtr = _binLib.Load(l);
-		auto wrapperFuncName = GetWrapperFuncName(func.FuncName);
-		return libPtr->Invoke<InvokeFuncType>(wrapperFuncName.c_str(), move(args));
+		auto resolved = Resolve(func);
+		_binLib.CountInvoke(resolved.Label);
+		return resolved(move(args));
 	}
 
 	Generator<pair<string, string>> FunctionLibrary::Search(string const& keyword) const
@@ -105,21 +133,27 @@ namespace FuncLib
 		return _index.Search(keyword);
 	}
 
-	pos_label FunctionLibrary::GetStoreLabel(FuncType const& func)
+	/// 请求里的类型到 id 再到解析好的地址，已经解析过的话整个过程不分配内存
+	ResolvedFunc FunctionLibrary::Resolve(FuncType const& func)
 	{
-		if (_funcInfoCache.contains(func))
+		auto id = _funcs.Find(func);
+		if (id == NoId)
 		{
-			return _funcInfoCache[func];
+			FUNC_NOT_EXIST_EXCEPTION(func);
 		}
 
-		if (_index.Contains(func))
+		auto& e = _funcs[id];
+		// 库卸载后又加载了的话函数地址变了
+		if (auto lib = _binLib.Find(e.Label); e.Func != nullptr and lib != nullptr and lib == e.Lib.lock())
 		{
-			auto l = _index.GetStoreLabel(func);
-			_funcInfoCache.insert({ func, l });
-			return l;
+			return { move(lib), e.Func, e.Label };
 		}
 
-		FUNC_NOT_EXIST_EXCEPTION(func);
+		auto lib = _binLib.Load(e.Label);
+		auto f = lib->GetFunc<InvokeFuncType>(GetWrapperFuncName(func.FuncName).c_str());
+		e.Lib = lib;
+		e.Func = f;
+		return { move(lib), f, e.Label };
 	}
 #undef FUNC_NOT_EXIST_EXCEPTION
 
@@ -127,4 +161,93 @@ namespace FuncLib
 	{
 		return _index.FuncTypes();
 	}
+
+	bool FunctionLibrary::CompactStore(milliseconds timeSlice)
+	{
+		using ::std::chrono::ceil;
+		using ::std::chrono::steady_clock;
+
+		// 两个文件共用这段时间：先整理索引，二进制文件只用剩下的。索引整理完了后面的调用就直接整理二进制文件
+		auto deadline = steady_clock::now() + timeSlice;
+		if (not _indexCompacted)
+		{
+			if (not _index.Compact(timeSlice))
+			{
+				return false;
+			}
+			_indexCompacted = true;
+		}
+
+		// 向下取整的话时间片很短时二进制文件总是分不到时间
+		auto remain = ceil<milliseconds>(deadline - steady_clock::now());
+		if (remain <= milliseconds::zero() or not _binLib.Compact(remain))
+		{
+			return false;
+		}
+		_indexCompacted = false;
+		return true;
+	}
+
+	vector<shared_future<void>> FunctionLibrary::BackupStore(path const& dirPath, size_t bytesPerSecond)
+	{
+		CheckIsDirectory(dirPath);
+		// 两个文件各自冻结，二进制先冻结，这样备份里索引指向的二进制都在
+		auto bin = _binLib.Backup(dirPath / BinFilename, bytesPerSecond);
+		try
+		{
+			auto index = _index.Backup(dirPath / IndexFilename, bytesPerSecond);
+			return { move(bin), move(index) };
+		}
+		catch (...)
+		{
+			// 只有二进制的备份不完整，停掉，错误照样报出去
+			_binLib.CancelBackup();
+			throw;
+		}
+	}
+
+	CompileCache::Metrics FunctionLibrary::CompileCacheMetrics() const
+	{
+		return _compileCache.GetMetrics();
+	}
+
+	bool FunctionLibrary::WarmUp(WarmUpBudget const& budget, milliseconds timeSlice)
+	{
+		return _binLib.WarmUp(budget, timeSlice);
+	}
+
+	size_t FunctionLibrary::LoadedLibCount() const
+	{
+		return _binLib.LoadedCount();
+	}
+
+	void FunctionLibrary::SetLoadedLibLimit(LoadedLibLimit limit)
+	{
+		_binLib.SetLoadedLibLimit(limit);
+	}
+
+	void FunctionLibrary::EvictIdleLibs()
+	{
+		_binLib.EvictIdle();
+	}
+
+	FuncBinaryLib::LoadMetrics FunctionLibrary::LoadedLibMetrics() const
+	{
+		return _binLib.GetLoadMetrics();
+	}
+
+	void FunctionLibrary::StoreInvokeStat()
+	{
+		_binLib.StoreInvokeStat();
+	}
+
+	optional<File::ReadAwaiter<BinUnit>> FunctionLibrary::ReadBinAsync(FuncType const& func, IoEngine::Executor executor)
+	{
+		auto id = _funcs.Find(func);
+		if (id == NoId)
+		{
+			return {};
+		}
+		return _binLib.ReadBinAsync(_funcs[id].Label, move(executor));
+	}
 }
@@ -1,60 +1,81 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <chrono>
+#include <future>
 #include <utility>
-#include <unordered_map>
 #include <filesystem>
 #include "../Json/Json.hpp"
 #include "Compile/FuncsDefReader.hpp"
 #include "FuncBinaryLib.hpp"
 #include "FuncBinaryLibIndex.hpp"
+#include "FuncTable.hpp"
 #include "../Btree/Generator.hpp"
 #include "Compile/CompileProcess.hpp"
+#include "Compile/CompileCache.hpp"
 
 namespace FuncLib
 {
 	using Collections::Generator;
+	using FuncLib::Compile::CompileCache;
 	using FuncLib::Compile::FuncsDefReader;
 	using Json::JsonObject;
 	using ::std::pair;
+	using ::std::shared_future;
 	using ::std::string;
-	using ::std::unordered_map;
 	using ::std::vector;
+	using ::std::weak_ptr;
+	using ::std::chrono::milliseconds;
 	using ::std::filesystem::path;
 
-	struct FuncTypeHash
+	using InvokeFuncType = JsonObject(JsonObject);
+
+	/// 解析好的函数：第一次调用时查出 wrapper 函数的地址，之后直接调用，不再拼名字和 dlsym
+	/// 持有所在的库，调用期间库被移出缓存也不会被卸载
+	struct ResolvedFunc
 	{
-		size_t operator()(FuncLib::FuncType const &t) const
+		shared_ptr<SharedLibWithCleaner> Lib;
+		InvokeFuncType* Func;
+		pos_label Label;
+
+		JsonObject operator()(JsonObject args) const
 		{
-			auto h = ::std::hash<string>();
-			return h(t.ToKey());
+			return Func(move(args));
 		}
 	};
 
-	struct FuncTypeEqualTo
+	/// 不持有库，库被卸载后要重新解析。Func 为空表示还没解析过
+	struct ResolvedFuncEntry
 	{
-		bool operator() (FuncLib::FuncType const &left, FuncLib::FuncType const &right) const
-		{
-			auto h = FuncTypeHash();
-			return h(left) == h(right);
-		}
+		weak_ptr<SharedLibWithCleaner> Lib;
+		InvokeFuncType* Func = nullptr;
+		pos_label Label;
 	};
 
+	/// 编译出来的函数信息和二进制
+	using CompiledFuncs = pair<vector<Compile::FuncObj>, vector<char>>;
+
 	class FunctionLibrary
 	{
 	private:
-		using InvokeFuncType = JsonObject(JsonObject);
-		//  hash map 作为缓存，快速查询
-		unordered_map<FuncType, pos_label, FuncTypeHash, FuncTypeEqualTo> _funcInfoCache;
+		/// 加载时把索引里的函数都驻留进来，查询和调用不用再访问索引
+		FuncTable<ResolvedFuncEntry> _funcs;
 		FuncBinaryLibIndex _index;
 		FuncBinaryLib _binLib;
+		/// 一样的函数定义再加进来时不用再编译
+		CompileCache _compileCache;
+		/// 一轮整理里索引文件已经整理完了，接着整理二进制文件
+		bool _indexCompacted = false;
 
-		FunctionLibrary(decltype(_index) index, decltype(_binLib) binLib);
+		FunctionLibrary(decltype(_index) index, decltype(_binLib) binLib, decltype(_compileCache) compileCache);
 
 	public:
 		static FunctionLibrary GetFrom(path dirPath);
+		/// 只用到编译缓存，不用和其他操作互斥，多个线程可以同时编译
+		CompiledFuncs Compile(FuncsDefReader defReader);
 		/// 当加入多个项，中间某一个项抛异常，保证之前添加进去的项正常
 		void Add(vector<string> package, FuncsDefReader defReader, string summary);
+		void Add(vector<string> package, CompiledFuncs compiled, string summary);
 		bool Contains(FuncType const& func) const;
 		void ModifyPackageOf(FuncType const& func, vector<string> package);
 		void Remove(FuncType const& func);
@@ -63,18 +84,35 @@ namespace FuncLib
 		/// pair: FuncType.ToKey(), summary
 		Generator<pair<string, string>> Search(string const& keyword) const;
 		Generator<FuncType> FuncTypes() const;
-		auto GetInvoker(FuncType func, JsonObject args)
+		/// 整理存储文件的空间，每次调用所有文件加起来最多做 timeSlice 这么久。Return true when all files are compacted
+		bool CompactStore(milliseconds timeSlice);
+		/// 把存储文件在线备份到 dirPath 目录下，备份在后台复制，期间可以接着修改
+		/// 返回的 future 都完成时备份才做完。开始不了时抛出异常，已经开始的也会停掉
+		vector<shared_future<void>> BackupStore(path const& dirPath, size_t bytesPerSecond);
+		CompileCache::Metrics CompileCacheMetrics() const;
+		/// 重启后预先加载之前调用得最多的库，分片做，见 FuncBinaryLib::WarmUp
+		bool WarmUp(WarmUpBudget const& budget, milliseconds timeSlice);
+		size_t LoadedLibCount() const;
+		/// 同时加载的库的个数和大小的上限，以及闲置多久卸载
+		void SetLoadedLibLimit(LoadedLibLimit limit);
+		/// 卸载闲置太久的库，定期调用，见 FuncBinaryLib::EvictIdle
+		void EvictIdleLibs();
+		FuncBinaryLib::LoadMetrics LoadedLibMetrics() const;
+		/// 调用次数只记在内存里，定期调用这个存下，见 FuncBinaryLib::StoreInvokeStat
+		void StoreInvokeStat();
+		/// 函数所在的库要从硬盘读的话返回读它的 awaiter，见 FuncBinaryLib::ReadBinAsync。函数不存在也返回空，调用时再报错
+		optional<File::ReadAwaiter<BinUnit>> ReadBinAsync(FuncType const& func, IoEngine::Executor executor);
+		auto GetInvoker(FuncType const& func, JsonObject args)
 		{
-			auto l = GetStoreLabel(func);
-			auto libPtr = _binLib.Load(l);
-			return [funcName=move(func.FuncName), libPtr=move(libPtr), args=move(args)]() -> JsonObject
+			auto resolved = Resolve(func);
+			_binLib.CountInvoke(resolved.Label);
+			return [resolved=move(resolved), args=move(args)]() mutable -> JsonObject
 			{
-				auto wrapperFuncName = Compile::GetWrapperFuncName(funcName);
-				return libPtr->Invoke<InvokeFuncType>(wrapperFuncName.c_str(), move(args));
+				return resolved(move(args));
 			};
 		}
 
 	private:
-		pos_label GetStoreLabel(FuncType const& func);
+		ResolvedFunc Resolve(FuncType const& func);
 	};
 }
@@ -15,6 +15,7 @@
 #include "../Store/FileReader.hpp"
 #include "IWriterIReaderConcept.hpp"
 #include "StructToTuple.hpp"
+#include "Varint.hpp"
 
 namespace FuncLib::Persistence
 {
@@ -30,6 +31,9 @@ namespace FuncLib::Persistence
 	using ::std::get;
 	using ::std::index_sequence;
 	using ::std::is_convertible;
+	using ::std::is_same_v;
+	using ::std::is_standard_layout_v;
+	using ::std::is_trivial_v;
 	using ::std::make_index_sequence;
 	using ::std::map;
 	using ::std::move;
@@ -76,12 +80,16 @@ namespace FuncLib::Persistence
 
 		static T ReadOut(IReader auto* reader)
 		{
-			auto bytes = reader->template Read<sizeof(T)>();
-			T* p = reinterpret_cast<T*>(&bytes[0]);
-			return *p;
+			T t;
+			reader->ReadTo(reinterpret_cast<byte*>(&t), sizeof(T));
+			return t;
 		}
 	};
 
+	/// 元素可以直接按字节整块拷贝，这样的连续容器一次写一次读
+	template <typename T>
+	constexpr bool BulkCopyable = is_standard_layout_v<T> and is_trivial_v<T> and not is_same_v<T, bool>;
+
 
 	template <typename T>
 	struct RemoveRefConstInTuple;
@@ -152,16 +160,16 @@ namespace FuncLib::Persistence
 		static void WriteDown(T const& t, IWriter auto* writer)
 		{
 			size_t n = t.size();
-			ByteConverter<decltype(n)>::WriteDown(n, writer);
+			CompactInt<size_t>::WriteDown(n, writer);
 			writer->Add(t.c_str(), n);
 		}
 
 		static T ReadOut(IReader auto* reader)
 		{
-			size_t charCount = ByteConverter<size_t>::ReadOut(reader);
-			auto bytes = reader->Read(charCount);
-			char* str = reinterpret_cast<char*>(bytes.data());
-			return { str, str + charCount };
+			size_t charCount = CompactInt<size_t>::ReadOut(reader);
+			string str(charCount, '\0');
+			reader->ReadTo(reinterpret_cast<byte*>(str.data()), charCount);
+			return str;
 		}
 	};
 
@@ -262,7 +270,7 @@ namespace FuncLib::Persistence
 		static void WriteDown(ThisType const& t, IWriter auto* writer)
 		{
 			size_t size = t.size();
-			ByteConverter<size_t>::WriteDown(size, writer);
+			CompactInt<size_t>::WriteDown(size, writer);
 
 			for (auto& item : t)
 			{
@@ -272,7 +280,7 @@ namespace FuncLib::Persistence
 
 		static ThisType ReadOut(IReader auto* reader)
 		{
-			size_t size = ByteConverter<size_t>::ReadOut(reader);
+			size_t size = CompactInt<size_t>::ReadOut(reader);
 			ThisType t;
 			for (auto i = 0; i < size; ++i)
 			{
@@ -293,25 +301,42 @@ namespace FuncLib::Persistence
 		static void WriteDown(ThisType const& t, IWriter auto* writer)
 		{
 			size_t size = t.size();
-			ByteConverter<size_t>::WriteDown(size, writer);
+			CompactInt<size_t>::WriteDown(size, writer);
 
-			for (auto& item : t)
+			if constexpr (BulkCopyable<T>)
+			{
+				writer->Add(reinterpret_cast<char const*>(t.data()), size * sizeof(T));
+			}
+			else
 			{
-				ByteConverter<T>::WriteDown(item, writer);
+				for (auto& item : t)
+				{
+					ByteConverter<T>::WriteDown(item, writer);
+				}
 			}
 		}
 
-		static ThisType ReadOut(FileReader *reader)
+		static ThisType ReadOut(IReader auto* reader)
 		{
-			size_t size = ByteConverter<size_t>::ReadOut(reader);
-			ThisType t;
-			for (size_t i = 0; i < size; ++i)
+			size_t size = CompactInt<size_t>::ReadOut(reader);
+			if constexpr (BulkCopyable<T>)
 			{
-				auto item = ByteConverter<T>::ReadOut(reader);
-				t.push_back(move(item));
+				ThisType t(size);
+				reader->ReadTo(reinterpret_cast<byte*>(t.data()), size * sizeof(T));
+				return t;
+			}
+			else
+			{
+				ThisType t;
+				t.reserve(size);
+				for (size_t i = 0; i < size; ++i)
+				{
+					auto item = ByteConverter<T>::ReadOut(reader);
+					t.push_back(move(item));
+				}
+
+				return t;
 			}
-
-			return t;
 		}
 	};
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include <utility>
+#include <vector>
 #include "../Store/StaticConfig.hpp"
 #include "../Store/File.hpp"
 #include "IWriterIReaderConcept.hpp"
@@ -10,6 +11,7 @@ namespace FuncLib::Persistence
 	using namespace Store;
 	using ::std::pair;
 	using ::std::shared_ptr;
+	using ::std::vector;
 
 	template <typename T>
 	class DiskPos
@@ -76,6 +78,14 @@ namespace FuncLib::Persistence
 			return _file;
 		}
 
+		void MarkDirty(shared_ptr<T> const& obj) const
+		{
+			if (_file != nullptr)
+			{
+				_file->MarkDirty(_label, obj);
+			}
+		}
+
 		void RegisterSetter(function<void(T*)> setter) const
 		{
 			_file->RegisterSetter(_label, move(setter));
@@ -85,6 +95,23 @@ namespace FuncLib::Persistence
 		{
 			return _file->HasRead<T>(_label);
 		}
+
+		/// Precondition: poses are in the same file
+		static void Prefetch(vector<DiskPos const*> const& poses)
+		{
+			if (poses.empty())
+			{
+				return;
+			}
+
+			vector<pos_label> labels;
+			labels.reserve(poses.size());
+			for (auto p : poses)
+			{
+				labels.push_back(p->_label);
+			}
+			poses.front()->_file->template Prefetch<T>(labels);
+		}
 	};
 
 	template <typename T1, typename T2>
@@ -1,5 +1,6 @@
 #pragma once
 #include <memory>
+#include <vector>
 #include <functional>
 
 namespace FuncLib::Persistence
@@ -9,6 +10,7 @@ namespace FuncLib::Persistence
 	using ::std::nullptr_t;
 	using ::std::shared_ptr;
 	using ::std::static_pointer_cast;
+	using ::std::vector;
 
 	template <typename T>
 	class DiskPtrBase
@@ -20,6 +22,8 @@ namespace FuncLib::Persistence
 		friend bool operator== (DiskPtrBase const& lhs, DiskPtrBase<T2> const& rhs);
 		template <typename T1>
 		friend bool operator== (DiskPtrBase<T1> const &lhs, nullptr_t rhs);
+		template <typename T1>
+		friend void Prefetch(vector<DiskPtrBase<T1> const*> const& ptrs);
 
 		DiskPos<T> _pos;
 		mutable shared_ptr<T> _tPtr;
@@ -88,10 +92,17 @@ namespace FuncLib::Persistence
 			this->ReadObjectFromDisk(); \
 		}                               \
 	} while (0)
+// 非 const 的访问认为会改动对象，标记一下，Store 的时候只写改动过的对象
+#define PREPARE_MUTABLE_OBJ                \
+	do                                     \
+	{                                      \
+		PREPARE_OBJ;                       \
+		this->_pos.MarkDirty(this->_tPtr); \
+	} while (0)
 		// 下面这些符号如果在实际的上层代码中能尽量不用就不用，因为涉及到读取
 		T& operator* ()
 		{
-			PREPARE_OBJ;
+			PREPARE_MUTABLE_OBJ;
 			return *_tPtr;
 		}
 
@@ -103,11 +114,11 @@ namespace FuncLib::Persistence
 
 		operator T* ()
 		{
-			PREPARE_OBJ;
+			PREPARE_MUTABLE_OBJ;
 			return _tPtr.get();
 		}
 
-		T* operator-> () const
+		T const* operator-> () const
 		{
 			PREPARE_OBJ;
 			return _tPtr.get();
@@ -115,9 +126,10 @@ namespace FuncLib::Persistence
 
 		T* operator-> ()
 		{
-			PREPARE_OBJ;
+			PREPARE_MUTABLE_OBJ;
 			return _tPtr.get();
 		}
+#undef PREPARE_MUTABLE_OBJ
 #undef PREPARE_OBJ
 	protected:
 		DiskPtrBase(DiskPos<T> pos) : DiskPtrBase(move(pos), nullptr)
@@ -142,6 +154,22 @@ namespace FuncLib::Persistence
 		return lhs._pos == DiskPos<T>();
 	}
 
+	/// 提示接下来会用到这些指针指向的对象，没读进来的一次提交一起读进来
+	/// Precondition: ptrs point to objects in the same file
+	template <typename T>
+	void Prefetch(vector<DiskPtrBase<T> const*> const& ptrs)
+	{
+		vector<DiskPos<T> const*> poses;
+		for (auto p : ptrs)
+		{
+			if (p->_tPtr == nullptr and not (p->_pos == DiskPos<T>()))
+			{
+				poses.push_back(&p->_pos);
+			}
+		}
+		DiskPos<T>::Prefetch(poses);
+	}
+
 	template <typename T>
 	class OwnerLessDiskPtr : public DiskPtrBase<T>
 	{
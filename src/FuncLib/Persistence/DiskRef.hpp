@@ -8,6 +8,8 @@ namespace FuncLib::Persistence
 	private:
 		friend struct ByteConverter<UniqueDiskRef, false>;
 		friend struct OwnerLessDiskRef<T>;
+		template <typename T1>
+		friend void AddPrefetch(UniqueDiskRef<T1> const& ref, vector<DiskPtrBase<T1> const*>* batch);
 		UniqueDiskPtr<T> _ptr;
 
 	public:
@@ -58,4 +60,10 @@ namespace FuncLib::Persistence
 		operator T& () { return *_ptr; }
 		operator T const& () const { return *_ptr; }
 	};
-}
+
+	template <typename T>
+	void AddPrefetch(UniqueDiskRef<T> const& ref, vector<DiskPtrBase<T> const*>* batch)
+	{
+		batch->push_back(&ref._ptr);
+	}
+}
\ No newline at end of file
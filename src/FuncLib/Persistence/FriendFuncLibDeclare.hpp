@@ -1,6 +1,7 @@
 #pragma once
 #include <type_traits>
 #include <memory>
+#include <vector>
 #include "Switch.hpp"
 #include "OwnerState.hpp"
 
@@ -26,6 +27,9 @@ namespace FuncLib::Persistence
 	template <typename T>
 	class OwnerLessDiskPtr;
 
+	template <typename T>
+	class DiskPtrBase;
+
 	template <typename T>
 	class UniqueDiskRef;
 	template <typename T>
@@ -34,6 +38,12 @@ namespace FuncLib::Persistence
 	template <typename T>
 	class DiskPos;
 
+	// For Btree scan prefetch
+	template <typename T>
+	void Prefetch(::std::vector<DiskPtrBase<T> const*> const& ptrs);
+	template <typename T>
+	void AddPrefetch(UniqueDiskRef<T> const& ref, ::std::vector<DiskPtrBase<T> const*>* batch);
+
 	template <typename T, Switch SwitchState>
 	class TakeWithDiskPos;
 
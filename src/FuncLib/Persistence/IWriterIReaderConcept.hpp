@@ -44,10 +44,11 @@ namespace FuncLib::Persistence
 					  Writer_ConstructSub<T>;
 
 	template <typename T>
-	concept IReader = requires(T t, size_t size)
+	concept IReader = requires(T t, size_t size, byte* des)
 	{
 		t.template Read<1>(); // 1 is just a sample
 		{ t.Read(size) } -> IsSameTo<vector<byte>>;
+		t.ReadTo(des, size);
 		t.Skip(1);
 	};
 
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "../../Basic/Exception.hpp"
+#include "IWriterIReaderConcept.hpp"
+
+namespace FuncLib::Persistence
+{
+	using ::Basic::InvalidOperationException;
+	using ::std::int64_t;
+	using ::std::is_signed_v;
+	using ::std::size_t;
+	using ::std::uint64_t;
+
+	/// LEB128，有符号的先 zigzag，绝对值小的数字节少
+	template <typename Int>
+	void WriteVarint(Int value, IWriter auto* writer)
+	{
+		uint64_t v;
+		if constexpr (is_signed_v<Int>)
+		{
+			auto i = static_cast<int64_t>(value);
+			v = (static_cast<uint64_t>(i) << 1) ^ static_cast<uint64_t>(i >> 63);
+		}
+		else
+		{
+			v = value;
+		}
+
+		char buf[10];
+		size_t n = 0;
+		do
+		{
+			auto b = static_cast<char>(v & 0x7f);
+			v >>= 7;
+			if (v != 0)
+			{
+				b |= static_cast<char>(0x80);
+			}
+			buf[n++] = b;
+		} while (v != 0);
+		writer->Add(buf, n);
+	}
+
+	template <typename Int>
+	Int ReadVarint(IReader auto* reader)
+	{
+		uint64_t v = 0;
+		for (unsigned shift = 0;; shift += 7)
+		{
+			if (shift >= 64)
+			{
+				throw InvalidOperationException("varint is too long");
+			}
+
+			auto b = static_cast<unsigned char>(reader->template Read<1>()[0]);
+			v |= static_cast<uint64_t>(b & 0x7f) << shift;
+			if ((b & 0x80) == 0)
+			{
+				break;
+			}
+		}
+
+		if constexpr (is_signed_v<Int>)
+		{
+			return static_cast<Int>(static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1));
+		}
+		else
+		{
+			return static_cast<Int>(v);
+		}
+	}
+
+	/// writer 或 reader 上有 Compact 开关且打开了才用紧凑编码，文件的格式版本决定这个开关
+	bool CompactEnabled(auto const* io)
+	{
+		if constexpr (requires { io->Compact; })
+		{
+			return io->Compact;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	/// ByteConverter 的特化想紧凑存某个整数（比如长度、个数）就用这个代替 ByteConverter<Int>。
+	/// 没开 Compact 时和 ByteConverter<Int> 写的一样。宽度不固定，用了的特化不能是 SizeStable
+	template <typename Int>
+	struct CompactInt
+	{
+		static void WriteDown(Int i, IWriter auto* writer)
+		{
+			if (CompactEnabled(writer))
+			{
+				WriteVarint(i, writer);
+			}
+			else
+			{
+				writer->Add(reinterpret_cast<char const*>(&i), sizeof(Int));
+			}
+		}
+
+		static Int ReadOut(IReader auto* reader)
+		{
+			if (CompactEnabled(reader))
+			{
+				return ReadVarint<Int>(reader);
+			}
+
+			Int i;
+			reader->ReadTo(reinterpret_cast<::std::byte*>(&i), sizeof(Int));
+			return i;
+		}
+	};
+}
@@ -0,0 +1,208 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "../../Basic/Exception.hpp"
+#include "BlockCompress.hpp"
+
+namespace FuncLib::Store
+{
+	using ::Basic::InvalidOperationException;
+	using ::std::memcpy;
+	using ::std::min;
+	using ::std::uint32_t;
+
+	namespace
+	{
+		constexpr size_t MinMatch = 4;
+		/// 格式要求最后这么多字节是字面量
+		constexpr size_t LastLiterals = 5;
+		/// 格式要求最后一个 match 开始的位置离结尾至少这么远
+		constexpr size_t MatchSafeDistance = 12;
+		constexpr size_t MaxOffset = 65535;
+		constexpr int HashBits = 16;
+		constexpr size_t NoPos = SIZE_MAX;
+		/// 连续找不到 match 时跳得越来越快，不可压缩的数据也不会太慢
+		constexpr int SkipTrigger = 6;
+
+		uint32_t Read32(char const* p)
+		{
+			uint32_t v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		uint32_t Hash(uint32_t v)
+		{
+			return (v * 2654435761u) >> (32 - HashBits);
+		}
+
+		/// length 已经减掉了 token 里的 15
+		void AddLength(vector<char>* out, size_t length)
+		{
+			for (; length >= 255; length -= 255)
+			{
+				out->push_back(static_cast<char>(255));
+			}
+			out->push_back(static_cast<char>(length));
+		}
+
+		void AddLiterals(vector<char>* out, char const* literals, size_t length, size_t tokenPos)
+		{
+			(*out)[tokenPos] = static_cast<char>(min<size_t>(length, 15) << 4);
+			if (length >= 15)
+			{
+				AddLength(out, length - 15);
+			}
+			out->insert(out->end(), literals, literals + length);
+		}
+
+		void AddSequence(vector<char>* out, char const* literals, size_t literalLength, size_t matchLength, size_t offset)
+		{
+			auto tokenPos = out->size();
+			out->push_back(0);
+			AddLiterals(out, literals, literalLength, tokenPos);
+			out->push_back(static_cast<char>(offset & 0xff));
+			out->push_back(static_cast<char>(offset >> 8));
+
+			auto length = matchLength - MinMatch;
+			(*out)[tokenPos] = static_cast<char>((*out)[tokenPos] | min<size_t>(length, 15));
+			if (length >= 15)
+			{
+				AddLength(out, length - 15);
+			}
+		}
+	}
+
+	vector<char> CompressBlock(char const* src, size_t size)
+	{
+		vector<char> out;
+		out.reserve(size / 2 + 16);
+		vector<size_t> table(1 << HashBits, NoPos);
+
+		size_t anchor = 0;
+		size_t i = 0;
+		size_t misses = 0;
+		auto limit = size > MatchSafeDistance ? size - MatchSafeDistance : 0;
+		while (i < limit)
+		{
+			auto v = Read32(src + i);
+			auto h = Hash(v);
+			auto candidate = table[h];
+			table[h] = i;
+
+			if (candidate == NoPos or i - candidate > MaxOffset or Read32(src + candidate) != v)
+			{
+				i += 1 + (misses++ >> SkipTrigger);
+				continue;
+			}
+
+			misses = 0;
+			auto matchEnd = i + MinMatch;
+			auto from = candidate + MinMatch;
+			auto matchLimit = size - LastLiterals;
+			while (matchEnd < matchLimit and src[matchEnd] == src[from])
+			{
+				++matchEnd;
+				++from;
+			}
+			// 往前也能多配上一点
+			while (i > anchor and candidate > 0 and src[i - 1] == src[candidate - 1])
+			{
+				--i;
+				--candidate;
+			}
+
+			AddSequence(&out, src + anchor, i - anchor, matchEnd - i, i - candidate);
+			i = matchEnd;
+			anchor = i;
+		}
+
+		auto tokenPos = out.size();
+		out.push_back(0);
+		AddLiterals(&out, src + anchor, size - anchor, tokenPos);
+		return out;
+	}
+
+	void DecompressBlock(char const* src, size_t srcSize, char* des, size_t desSize)
+	{
+		auto corrupted = []
+		{
+			return InvalidOperationException("compressed block is corrupted");
+		};
+
+		size_t ip = 0;
+		size_t op = 0;
+		auto readLength = [&](size_t length)
+		{
+			if (length == 15)
+			{
+				unsigned char b;
+				do
+				{
+					if (ip >= srcSize)
+					{
+						throw corrupted();
+					}
+					b = static_cast<unsigned char>(src[ip++]);
+					length += b;
+				} while (b == 255);
+			}
+			return length;
+		};
+
+		for (;;)
+		{
+			if (ip >= srcSize)
+			{
+				throw corrupted();
+			}
+			auto token = static_cast<unsigned char>(src[ip++]);
+
+			auto literalLength = readLength(token >> 4);
+			if (literalLength > srcSize - ip or literalLength > desSize - op)
+			{
+				throw corrupted();
+			}
+			memcpy(des + op, src + ip, literalLength);
+			ip += literalLength;
+			op += literalLength;
+			// 最后一段只有字面量
+			if (ip == srcSize)
+			{
+				break;
+			}
+
+			if (srcSize - ip < 2)
+			{
+				throw corrupted();
+			}
+			size_t offset = static_cast<unsigned char>(src[ip]) | (static_cast<unsigned char>(src[ip + 1]) << 8);
+			ip += 2;
+			auto matchLength = readLength(token & 15) + MinMatch;
+			if (offset == 0 or offset > op or matchLength > desSize - op)
+			{
+				throw corrupted();
+			}
+
+			auto from = des + op - offset;
+			if (offset >= matchLength)
+			{
+				memcpy(des + op, from, matchLength);
+			}
+			else
+			{
+				// 重叠的要一个一个复制
+				for (size_t j = 0; j < matchLength; ++j)
+				{
+					des[op + j] = from[j];
+				}
+			}
+			op += matchLength;
+		}
+
+		if (op != desSize)
+		{
+			throw corrupted();
+		}
+	}
+}
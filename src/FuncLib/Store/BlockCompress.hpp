@@ -0,0 +1,14 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+namespace FuncLib::Store
+{
+	using ::std::size_t;
+	using ::std::vector;
+
+	/// LZ4 块格式的压缩，只有块没有帧头，原始大小由调用者自己记
+	vector<char> CompressBlock(char const* src, size_t size);
+	/// 解压到 des，desSize 必须是原始大小。数据坏了会抛异常
+	void DecompressBlock(char const* src, size_t srcSize, char* des, size_t desSize);
+}
@@ -0,0 +1,52 @@
+#include "BytesPool.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::move;
+
+	vector<char> BytesPool::Take(size_t capacity)
+	{
+		if (_buffers.empty())
+		{
+			vector<char> buffer;
+			buffer.reserve(capacity);
+			return buffer;
+		}
+
+		// 找一个够大的，没有就拿最后一个扩容
+		auto it = _buffers.end() - 1;
+		for (auto i = _buffers.begin(); i != _buffers.end(); ++i)
+		{
+			if (i->capacity() >= capacity)
+			{
+				it = i;
+				break;
+			}
+		}
+
+		auto buffer = move(*it);
+		if (it != _buffers.end() - 1)
+		{
+			*it = move(_buffers.back());
+		}
+		_buffers.pop_back();
+		buffer.reserve(capacity);
+		return buffer;
+	}
+
+	void BytesPool::Give(vector<char> buffer)
+	{
+		if (buffer.capacity() == 0 or buffer.capacity() > MaxCapacity or _buffers.size() >= MaxCount)
+		{
+			return;
+		}
+
+		buffer.clear();
+		_buffers.push_back(move(buffer));
+	}
+
+	size_t BytesPool::Count() const
+	{
+		return _buffers.size();
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+namespace FuncLib::Store
+{
+	using ::std::size_t;
+	using ::std::vector;
+
+	/// 存储时序列化对象用的缓冲区，存完还回来下次接着用。Store 只在一个线程里做，这里不加锁
+	class BytesPool
+	{
+	private:
+		/// 最多留这么多个缓冲区
+		static constexpr size_t MaxCount = 256;
+		/// 比这个大的缓冲区不留，免得一直占着大块内存
+		static constexpr size_t MaxCapacity = 1024 * 1024;
+		vector<vector<char>> _buffers;
+
+	public:
+		/// 返回的缓冲区是空的，容量至少是 capacity
+		vector<char> Take(size_t capacity);
+		void Give(vector<char> buffer);
+		size_t Count() const;
+	};
+}
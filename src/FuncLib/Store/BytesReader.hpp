@@ -0,0 +1,82 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include "StaticConfig.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::array;
+	using ::std::byte;
+	using ::std::memcpy;
+	using ::std::size_t;
+	using ::std::vector;
+
+	class File;
+	/// 从内存里的字节读，接口和 FileReader 一样
+	class BytesReader
+	{
+	private:
+		File* _file;
+		char const* _bytes;
+		size_t _size;
+		size_t _pos = 0;
+
+	public:
+		/// 按紧凑编码读，见 CompactInt
+		bool Compact = false;
+
+		BytesReader(char const* bytes, size_t size, File* file = nullptr)
+			: _file(file), _bytes(bytes), _size(size)
+		{ }
+
+		/// has side effect: move forward size positions
+		vector<byte> Read(size_t size)
+		{
+			vector<byte> mem(size);
+			ReadTo(mem.data(), size);
+			return mem;
+		}
+
+		/// Side effect: move forward N positions
+		template <size_t N>
+		array<byte, N> Read()
+		{
+			array<byte, N> mem;
+			ReadTo(mem.data(), N);
+			return mem;
+		}
+
+		/// 直接读到 des 里，has side effect: move forward size positions
+		void ReadTo(byte* des, size_t size)
+		{
+			if (_pos + size > _size)
+			{
+				throw ::std::out_of_range("read out of bytes range");
+			}
+
+			if (size != 0)
+			{
+				memcpy(des, _bytes + _pos, size);
+			}
+			_pos += size;
+		}
+
+		void Skip(size_t size)
+		{
+			_pos += size;
+		}
+
+		bool AtEnd() const
+		{
+			return _pos >= _size;
+		}
+
+		File* GetLessOwnershipFile() const
+		{
+			return _file;
+		}
+	};
+}
@@ -0,0 +1,90 @@
+#include "Compactor.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::move;
+
+	Compactor::Compactor(vector<pos_label> order) : _order(move(order))
+	{ }
+
+	bool Compactor::Step(StorageAllocator* allocator, Mover const& mover, steady_clock::time_point deadline)
+	{
+		if (not _indexValid)
+		{
+			BuildIndex(allocator);
+		}
+
+		// 每次至少挪一个，保证能做完
+		for (auto started = false; _next < _order.size(); ++_next, started = true)
+		{
+			if (started and steady_clock::now() > deadline)
+			{
+				return false;
+			}
+
+			auto label = _order[_next];
+			if (not allocator->Ready(label))
+			{
+				continue; // 中途被删掉了
+			}
+
+			auto pos = allocator->GetConcretePos(label);
+			auto size = allocator->GetAllocatedSize(label);
+			// 按分配时的规则对齐，整理完对象还是不跨页
+			auto target = StorageAllocator::PlaceFor(_targetPos, size);
+			auto targetEnd = StorageAllocator::EndOf(target, size);
+			if (pos != target)
+			{
+				// [0, _targetPos) 都已经排好，所以占着目标空间的对象都是从 _targetPos 之后开始的
+				for (auto it = _labelsByPos.lower_bound(_targetPos); it != _labelsByPos.end() and it->first < targetEnd;)
+				{
+					auto [occupiedPos, occupiedLabel] = *it;
+					++it;
+					if (occupiedLabel != label)
+					{
+						auto occupiedSize = allocator->GetAllocatedSize(occupiedLabel);
+						MoveLabel(allocator, mover, occupiedLabel, occupiedPos, StorageAllocator::PlaceFor(allocator->GetEndPos(), occupiedSize));
+					}
+				}
+
+				MoveLabel(allocator, mover, label, pos, target);
+			}
+
+			_targetPos = targetEnd;
+		}
+
+		return true;
+	}
+
+	void Compactor::Invalidate()
+	{
+		_indexValid = false;
+	}
+
+	void Compactor::BuildIndex(StorageAllocator const* allocator)
+	{
+		_labelsByPos.clear();
+		for (auto [pos, label] : allocator->GetUsingLabelsSortedByPos())
+		{
+			if (allocator->GetAllocatedSize(label) != 0)
+			{
+				_labelsByPos.insert(_labelsByPos.end(), { pos, label });
+			}
+		}
+
+		_indexValid = true;
+	}
+
+	void Compactor::MoveLabel(StorageAllocator* allocator, Mover const& mover, pos_label label, pos_int from, pos_int to)
+	{
+		auto size = allocator->GetAllocatedSize(label);
+		if (size != 0)
+		{
+			mover(label, from, to, size);
+			_labelsByPos.erase(from);
+			_labelsByPos.insert({ to, label });
+		}
+
+		allocator->MoveSpaceTo(label, to);
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include "StaticConfig.hpp"
+#include "StorageAllocator.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::function;
+	using ::std::map;
+	using ::std::vector;
+	using ::std::chrono::steady_clock;
+
+	/// 把在用的对象按给定的顺序挪到文件前面连续的空间，可以分多次做完
+	/// 挪到目标位置前，占着目标位置但还没轮到的对象先被挪到文件末尾
+	class Compactor
+	{
+	private:
+		vector<pos_label> _order;
+		size_t _next = 0;
+		pos_int _targetPos = 0;
+		/// pos, label. 只记录还有大小的对象
+		map<pos_int, pos_label> _labelsByPos;
+		bool _indexValid = false;
+
+	public:
+		/// args: label, from, to, size
+		using Mover = function<void(pos_label, pos_int, pos_int, size_t)>;
+
+		Compactor(vector<pos_label> order);
+		/// Return true when all labels in order are placed
+		bool Step(StorageAllocator* allocator, Mover const& mover, steady_clock::time_point deadline);
+		/// Call it when allocator changed outside
+		void Invalidate();
+
+	private:
+		void BuildIndex(StorageAllocator const* allocator);
+		void MoveLabel(StorageAllocator* allocator, Mover const& mover, pos_label label, pos_int from, pos_int to);
+	};
+}
@@ -1,55 +1,42 @@
+#include <fcntl.h>
+#include <unistd.h>
 #include <fstream>
 #include "../Basic/Exception.hpp"
 #include "File.hpp"
+#include "BytesReader.hpp"
 #include "StoreInfoPersistence.hpp"
 
-namespace FuncLib::Persistence
-{
-	using FuncLib::Store::File;
-	using FuncLib::Store::FileCache;
-
-	template <>
-	struct ByteConverter<File, false>
-	{
-		using ThisType = File;
-		using DataMember0 = decltype(declval<ThisType>()._metadataSize);
-		// 以下这两个东西不允许出现内 disk ptr
-		using DataMember1 = decltype(declval<ThisType>()._allocator);
-		using DataMember2 = decltype(declval<ThisType>()._objRelationTree);
-		static constexpr bool SizeStable = false;
-		// 下面的写和读，顺序要保持一致
-		static void WriteDown(ThisType const& p, IWriter auto *writer)
-		{
-			ByteConverter<DataMember0>::WriteDown(p._metadataSize, writer);
-			ByteConverter<DataMember1>::WriteDown(p._allocator, writer);
-			WriteObjRelationTree(p._objRelationTree, writer);
-		}
-
-		static shared_ptr<ThisType> ReadOut(IReader auto* reader, shared_ptr<path> pathPtr, FileCache cache)
-		{
-			return make_shared<ThisType>
-			(
-				ByteConverter<DataMember0>::ReadOut(reader),
-				move(cache),
-				move(pathPtr),
-				ByteConverter<DataMember1>::ReadOut(reader),
-				ReadObjRelationTreeFrom(reader)
-			);
-		}
-	};
-}
-
 namespace FuncLib::Store
 {
+	using ::std::min;
+	using ::std::nullopt;
+
 	constexpr pos_int MetadataStart = 0;
-	constexpr char const slogan[] = "Hello File";// 留作有效性校验
+	constexpr char const slogan[] = "Paged File";// 留作有效性校验
+	/// 后面跟着格式版本，FormatVersion::Fixed 的文件还用上面那个，格式和以前一样
+	constexpr char const versionedSlogan[] = "Vers. File";
+	/// 之前整个元信息一起存的格式，打开时转成现在的格式
+	constexpr char const oldSlogan[] = "Hello File";
+	static_assert(sizeof(slogan) == sizeof(oldSlogan));
+	static_assert(sizeof(slogan) == sizeof(versionedSlogan));
+	/// 元信息区：头部，label 表的页，对象关系
+	constexpr pos_int MetadataHeadSize = 128;
+	constexpr pos_int LabelPagesStart = MetadataStart + MetadataHeadSize;
+	constexpr pos_int InitialMetadataSize = 8192;
+
+	/// 数据区从页边界开始，对象按页放的位置在文件里才是对齐的
+	pos_int AlignToPage(pos_int size)
+	{
+		return (size + DiskBlockSize - 1) / DiskBlockSize * DiskBlockSize;
+	}
 
 	pos_int GetFitSpaceSize(pos_int dataSize, pos_int currentSpaceSize)
 	{
 		constexpr pos_int GB = 1024 * 1024 * 1024;
 		for (;;)
 		{
-			currentSpaceSize += 1024;
+			// 翻倍，元信息区变大要挪动所有数据，不能常做
+			currentSpaceSize *= 2;
 			if (currentSpaceSize > GB)
 			{
 				throw std::out_of_range("current require space is too big");
@@ -57,16 +44,16 @@ namespace FuncLib::Store
 
 			if (currentSpaceSize > dataSize)
 			{
-				return currentSpaceSize;
+				return AlignToPage(currentSpaceSize);
 			}
 		}
 	}
 
-	bool CheckFileValid(array<byte, sizeof(slogan)> const& bytes)
+	bool CheckFileValid(array<byte, sizeof(slogan)> const& bytes, char const (&expectSlogan)[sizeof(slogan)] = slogan)
 	{
 		for (size_t i = 0; i < sizeof(slogan); ++i)
 		{
-			if (slogan[i] != static_cast<char>(bytes[i]))
+			if (expectSlogan[i] != static_cast<char>(bytes[i]))
 			{
 				return false;
 			}
@@ -74,84 +61,771 @@ namespace FuncLib::Store
 		return true;
 	}
 
-	vector<char> ReadRemainDataFrom(fstream* fs, pos_int pos)
+	vector<char> ReadBytes(fstream* fs, pos_int pos, size_t size)
 	{
-		fs->seekg(pos, fstream::beg);
-		auto start = fs->tellg();
-		fs->seekg(0, fstream::end);
-		auto end = fs->tellg();
-		auto size = end - start;
 		vector<char> data(size);
-		fs->read(reinterpret_cast<char *>(data.data()), size);
+		fs->seekg(pos, fstream::beg);
+		fs->read(data.data(), size);
 		return data;
 	}
 
-	shared_ptr<File> File::GetFile(path const& filename)
+	void WriteBytes(fstream* fs, pos_int pos, vector<char> const& data)
 	{
-		if (auto pathPtr = make_shared<path>(filename); exists(filename))
-		{
-			using Persistence::ByteConverter;
+		fs->seekp(pos, fstream::beg);
+		fs->write(data.data(), data.size());
+	}
 
-			auto reader = FileReader::MakeReader(nullptr, filename, 0);
-			if (not CheckFileValid(reader.Read<sizeof(slogan)>()))
+	/// 一块一块复制，不把整个文件读进内存。size 为空时复制到文件末尾
+	void CopyBytes(::std::ifstream* from, ::std::ofstream* to, optional<pos_int> size)
+	{
+		constexpr size_t ChunkSize = 1024 * 1024;
+		vector<char> chunk(ChunkSize);
+		for (pos_int copied = 0; not size.has_value() or copied < *size;)
+		{
+			auto n = size.has_value() ? min<pos_int>(ChunkSize, *size - copied) : ChunkSize;
+			from->read(chunk.data(), n);
+			auto got = from->gcount();
+			if (got == 0)
 			{
-				throw Basic::InvalidOperationException(string(filename) + " is invalid");
+				break;
 			}
+			to->write(chunk.data(), got);
+			copied += got;
+		}
+	}
 
-			return ByteConverter<File>::ReadOut(&reader, pathPtr, FileCache(FileCount++));
+	void SyncFd(int fd)
+	{
+#ifdef __APPLE__
+		::fcntl(fd, F_FULLFSYNC);
+#else
+		::fsync(fd);
+#endif
+	}
+
+	void SyncFile(path const& filename)
+	{
+		auto fd = ::open(filename.c_str(), O_RDWR);
+		if (fd == -1)
+		{
+			return;
+		}
+		SyncFd(fd);
+		::close(fd);
+	}
+
+	/// 改名后让目录项落盘
+	void SyncDirectoryOf(path const& filename)
+	{
+		auto dir = filename.has_parent_path() ? filename.parent_path() : path(".");
+		auto fd = ::open(dir.c_str(), O_RDONLY);
+		if (fd == -1)
+		{
+			return;
+		}
+		SyncFd(fd);
+		::close(fd);
+	}
+
+	/// 日志记录由下面这些操作组成，一次 Store 的所有操作放在一条记录里，重放时要么都做要么都不做
+	enum class LogOp : char
+	{
+		/// label, pos, bytes
+		Write = 1,
+		/// ReadStateLabelNode
+		UpdateRelation,
+		UpdateRelationInPlace,
+		FreeRelation,
+		/// 检查点时的整个元信息
+		Metadata,
+	};
+
+	void AddLogOp(ObjectBytes* record, LogOp op)
+	{
+		ByteConverter<char>::WriteDown(static_cast<char>(op), record);
+	}
+
+	void AddWriteLog(ObjectBytes* record, pos_label label, pos_int pos, vector<char> const& data)
+	{
+		AddLogOp(record, LogOp::Write);
+		ByteConverter<pos_label>::WriteDown(label, record);
+		ByteConverter<pos_int>::WriteDown(pos, record);
+		ByteConverter<vector<char>>::WriteDown(data, record);
+	}
+
+	void AddRelationLog(ObjectBytes* record, LogOp op, ReadStateLabelNode const& node)
+	{
+		AddLogOp(record, op);
+		WriteReadStateLabelNode(node, record);
+	}
+
+	constexpr size_t CheckpointLogSize = 4 * 1024 * 1024;
+
+	shared_ptr<File> File::GetFile(path const& filename)
+	{
+		auto existed = exists(filename);
+		auto file = make_shared<File>(FileCache(FileCount++), make_shared<path>(filename));
+		if (existed)
+		{
+			file->LoadMetadata();
 		}
 		else
 		{
-			auto t = ObjectRelationTree();
-			auto a = StorageAllocator();
-			pos_int metadataSize = 2048;
-			auto f = make_shared<File>(metadataSize, FileCache(FileCount++), pathPtr, move(a), move(t));
-			return f;
+			file->_metadataSize = InitialMetadataSize;
+			file->_objRelationTree = ObjectRelationTree();
+			file->_relationTreeChanged = true;
 		}
+
+		// 上次没有正常关闭，把日志里的操作重做一遍
+		if (auto records = WriteAheadLog::ReadRecords(WriteAheadLog::LogPathOf(filename)); not records.empty())
+		{
+			file->Replay(records);
+		}
+		// 新文件也马上写下元信息，这样之后崩溃了也能打开
+		file->Checkpoint();
+		// 以前的文件元信息区大小不是页的整数倍，挪一次数据让数据区对齐。检查点之后日志是空的
+		if (file->_metadataSize % DiskBlockSize != 0)
+		{
+			file->GrowMetadataTo(AlignToPage(file->_metadataSize));
+		}
+
+		return file;
 	}
 
 	File::~File()
 	{
+		WaitBackup();
 		_allocator.DeallocatePosLabels(_notStoredLabels);
-		_objRelationTree.ReleaseFreeNodes([this](pos_label label)
+		// 没读过对象关系就不会有要释放的
+		if (_objRelationTree.has_value())
 		{
-			_allocator.DeallocatePosLabel(label);
+			_objRelationTree->ReleaseFreeNodes([this](pos_label label)
+			{
+				_allocator.DeallocatePosLabel(label);
+			});
+		}
+
+		Checkpoint();
+		_wal.reset();
+		::std::filesystem::remove(WriteAheadLog::LogPathOf(*_filename));
+	}
+
+	File::File(FileCache cache, shared_ptr<path> filename)
+		: _filename(move(filename)), _cache(move(cache)),
+		  _wal(make_unique<WriteAheadLog>(WriteAheadLog::LogPathOf(*_filename)))
+	{
+		CreateIfNotExist(_filename.get());
+		_readSource = make_shared<PositionalFile const>(*_filename);
+		_io = IoEngine::Open(*_filename);
+	}
+
+	shared_ptr<PositionalFile const> File::ReadSource() const
+	{
+		lock_guard<mutex> guard(_sourceMutex);
+		return _readSource;
+	}
+
+	shared_ptr<IoEngine> File::Io() const
+	{
+		lock_guard<mutex> guard(_sourceMutex);
+		return _io;
+	}
+
+	void File::LoadMetadata()
+	{
+		// 头部一次读进来再解析
+		vector<char> head(MetadataHeadSize);
+		// 头部可能不满 MetadataHeadSize
+		ReadSource()->Read(MetadataStart, reinterpret_cast<byte*>(head.data()), head.size(), true);
+		BytesReader reader(head.data(), head.size());
+		auto s = reader.Read<sizeof(slogan)>();
+		auto versioned = CheckFileValid(s, versionedSlogan);
+		if (versioned or CheckFileValid(s))
+		{
+			_formatVersion = FormatVersion::Fixed;
+			if (versioned)
+			{
+				_formatVersion = ByteConverter<FormatVersion>::ReadOut(&reader);
+				if (_formatVersion > CurrentFormatVersion)
+				{
+					throw Basic::InvalidOperationException(string(*_filename) + " has a newer format version");
+				}
+			}
+			_metadataSize = ByteConverter<pos_int>::ReadOut(&reader);
+			// 页是之后才读的，那时文件可能已经换过了
+			_allocator = ReadAllocatorHeadFrom(&reader, [this](size_t pageIndex)
+			{
+				FileReader r(nullptr, ReadSource(), LabelPagesStart + pageIndex * LabelTable::PageByteSize);
+				auto bytes = r.Read(LabelTable::PageByteSize);
+				return vector<char>(reinterpret_cast<char*>(bytes.data()), reinterpret_cast<char*>(bytes.data()) + bytes.size());
+			});
+			_relationTreeSize = ByteConverter<size_t>::ReadOut(&reader);
+			_objRelationTree.reset();
+			_relationTreeChanged = false;
+		}
+		else if (CheckFileValid(s, oldSlogan))
+		{
+			// 全部读出来，下次检查点按现在的格式全部写下。这种格式大小不知道，只能从文件里边读边解析
+			FileReader fileReader(nullptr, ReadSource(), MetadataStart + sizeof(oldSlogan));
+			_formatVersion = FormatVersion::Fixed;
+			_metadataSize = ByteConverter<pos_int>::ReadOut(&fileReader);
+			_allocator = ByteConverter<StorageAllocator>::ReadOut(&fileReader);
+			_objRelationTree = ReadObjRelationTreeFrom(&fileReader);
+			_relationTreeChanged = true;
+		}
+		else
+		{
+			throw Basic::InvalidOperationException(string(*_filename) + " is invalid");
+		}
+	}
+
+	vector<char> File::MetadataHeadBytes() const
+	{
+		ObjectBytes head(FileLabel);
+		if (_formatVersion == FormatVersion::Fixed)
+		{
+			head.Add(slogan, sizeof(slogan));
+		}
+		else
+		{
+			head.Add(versionedSlogan, sizeof(versionedSlogan));
+			ByteConverter<FormatVersion>::WriteDown(_formatVersion, &head);
+		}
+		ByteConverter<pos_int>::WriteDown(_metadataSize, &head);
+		WriteAllocatorHeadTo(_allocator, &head);
+		ByteConverter<size_t>::WriteDown(_relationTreeSize, &head);
+
+		vector<char> bytes;
+		head.WriteIn([&bytes](vector<char> const* b)
+		{
+			bytes = *b;
+		});
+		return bytes;
+	}
+
+	bool File::CompactEncoding() const
+	{
+		return _formatVersion >= FormatVersion::Compact;
+	}
+
+	bool File::UseDirectIo(size_t size)
+	{
+		return DirectIoForLargeObjects and size >= LargeObjectSize;
+	}
+
+	pos_int File::RelationTreeStart() const
+	{
+		return LabelPagesStart + _allocator.StoredLabelPageCount() * LabelTable::PageByteSize;
+	}
+
+	ObjectRelationTree const* File::RelationTree()
+	{
+		if (not _objRelationTree.has_value())
+		{
+			if (_relationTreeSize == 0)
+			{
+				_objRelationTree = ObjectRelationTree();
+			}
+			else
+			{
+				// 大小是知道的，一次读进来在内存里解析
+				vector<char> bytes(_relationTreeSize);
+				ReadSource()->Read(RelationTreeStart(), reinterpret_cast<byte*>(bytes.data()), bytes.size());
+				BytesReader reader(bytes.data(), bytes.size());
+				_objRelationTree = ReadObjRelationTreeFrom(&reader);
+			}
+		}
+
+		return &_objRelationTree.value();
+	}
+
+	ObjectRelationTree* File::MutableRelationTree()
+	{
+		RelationTree();
+		_relationTreeChanged = true;
+		return &_objRelationTree.value();
+	}
+
+	void File::Checkpoint()
+	{
+		// 先让之前写进文件的数据落盘，日志才可以清掉
+		SyncFile(*_filename);
+
+		// label 表多了页，对象关系要挪到后面
+		if (_allocator.LabelPageCount() != _allocator.StoredLabelPageCount())
+		{
+			MutableRelationTree();
+		}
+
+		auto pageCount = _allocator.LabelPageCount();
+		optional<vector<char>> relationTreeBytes;
+		if (_relationTreeChanged)
+		{
+			ObjectBytes bytes(FileLabel);
+			WriteObjRelationTree(*RelationTree(), &bytes);
+			bytes.WriteIn([&relationTreeBytes](vector<char> const* b)
+			{
+				relationTreeBytes = *b;
+			});
+		}
+
+		auto relationTreeStart = LabelPagesStart + pageCount * LabelTable::PageByteSize;
+		auto relationTreeSize = relationTreeBytes.has_value() ? relationTreeBytes->size() : _relationTreeSize;
+		if (auto size = relationTreeStart + relationTreeSize; size > _metadataSize)
+		{
+			GrowMetadataTo(GetFitSpaceSize(size, _metadataSize));
+		}
+
+		// 只写改过的部分，头部最后写
+		vector<pair<pos_int, vector<char>>> writes;
+		_allocator.TakeDirtyLabelPages([&writes](size_t index, vector<char> bytes)
+		{
+			writes.push_back({ LabelPagesStart + index * LabelTable::PageByteSize, move(bytes) });
 		});
+		if (relationTreeBytes.has_value())
+		{
+			writes.push_back({ relationTreeStart, move(*relationTreeBytes) });
+			_relationTreeSize = relationTreeSize;
+			_relationTreeChanged = false;
+		}
+		writes.push_back({ MetadataStart, MetadataHeadBytes() });
+
+		// 元信息是原位覆盖写的，写一半崩溃了要靠日志里的这份恢复
+		ObjectBytes record(FileLabel);
+		AddLogOp(&record, LogOp::Metadata);
+		ByteConverter<size_t>::WriteDown(writes.size(), &record);
+		for (auto& [pos, bytes] : writes)
+		{
+			ByteConverter<pos_int>::WriteDown(pos, &record);
+			ByteConverter<vector<char>>::WriteDown(bytes, &record);
+		}
+		CommitLog(record);
 
-		// Store
-		auto fileStoreProcess = [this](ObjectBytes* writer)
 		{
-			writer->Add(slogan, sizeof(slogan));
-			ByteConverter<File>::WriteDown(*this, writer);
+			CreateIfNotExist(_filename.get());
+			auto fs = MakeFileStream(_filename.get());
+			for (auto& [pos, bytes] : writes)
+			{
+				WriteBytes(&fs, pos, bytes);
+			}
+		}
+
+		SyncFile(*_filename);
+		_wal->Reset();
+	}
+
+	/// 挪好数据的新文件先写到临时文件里，落盘后改名替换原文件
+	/// 改名是原子的，中间崩溃了原文件和它的头部都还是完整的，日志按原来的元信息区大小重放
+	void File::GrowMetadataTo(pos_int newSize)
+	{
+		using ::std::ifstream;
+		using ::std::ofstream;
+		using ::std::filesystem::rename;
+
+		// 要挪动所有数据，等备份读完
+		WaitBackup();
+		CreateIfNotExist(_filename.get());
+		auto oldSize = _metadataSize;
+		auto tempFilename = path(*_filename).concat(".grow");
+		{
+			ifstream from(*_filename, ifstream::binary);
+			ofstream to(tempFilename, ofstream::binary | ofstream::trunc);
+			CopyBytes(&from, &to, oldSize);
+			to.seekp(newSize, ofstream::beg);
+			from.clear();
+			from.seekg(oldSize, ifstream::beg);
+			CopyBytes(&from, &to, nullopt);
+
+			// 头部里其他的还是文件里现在的样子，只改了大小
+			_metadataSize = newSize;
+			auto head = MetadataHeadBytes();
+			_metadataSize = oldSize;
+			to.seekp(MetadataStart, ofstream::beg);
+			to.write(head.data(), head.size());
+			to.flush();
+			if (not to)
+			{
+				throw Basic::InvalidOperationException("Cannot write " + string(tempFilename));
+			}
+		}
+
+		SyncFile(tempFilename);
+		rename(tempFilename, *_filename);
+		SyncDirectoryOf(*_filename);
+		_metadataSize = newSize;
+		// 原来打开的是改名前的那个文件，正在用它读的线程读完才关掉
+		auto readSource = make_shared<PositionalFile const>(*_filename);
+		shared_ptr<IoEngine> io = IoEngine::Open(*_filename);
+		lock_guard<mutex> guard(_sourceMutex);
+		_readSource = move(readSource);
+		_io = move(io);
+	}
+
+	void File::CommitLog(ObjectBytes const& logRecord)
+	{
+		logRecord.WriteIn([this](vector<char> const* bytes)
+		{
+			_wal->Commit(*bytes);
+		});
+	}
+
+	void File::CommitStore(ObjectBytes* topBytes, WriteQueue* toWrites, AllocateSpaceQueue* toAllocates, ResizeSpaceQueue* toResizes)
+	{
+		ObjectBytes record(FileLabel);
+		auto topNode = ReadStateLabelNode::ConsNodeWith(topBytes);
+		AddRelationLog(&record, LogOp::UpdateRelation, topNode);
+		MutableRelationTree()->UpdateWith(move(topNode));
+		StoreLeftDirtyObjects(toWrites, toAllocates, toResizes, &record);
+
+		auto allocate = [&](ObjectBytes* bytes)
+		{
+			auto size = bytes->Size();
+			_allocator.GiveSpaceTo(bytes->Label(), size);
+		};
+
+		auto resize = [&](ObjectBytes* bytes)
+		{
+			_allocator.ResizeSpaceTo(bytes->Label(), bytes->Size());
+			if (_snapshot != nullptr)
+			{
+				_snapshot->Release(bytes->Label());
+			}
+		};
+
+		auto log = [&](ObjectBytes* bytes)
+		{
+			auto label = bytes->Label();
+			bytes->WriteIn([&](vector<char> const* data)
+			{
+				AddWriteLog(&record, label, _allocator.GetConcretePos(label), *data);
+			});
 		};
-		
-		ObjectBytes metadataBytes(FileLabel);
-		fileStoreProcess(&metadataBytes);
-		printf("byte size %zu\n", metadataBytes.Size());
 
+		*toResizes > resize > log; // Resize first, then allocate. Below allocates can reuse place.
+		*toAllocates > allocate > log;
+		*toWrites > log;
+		CommitLog(record);
+
+		// 这次存储的所有对象作为一批交给 I/O 引擎
+		vector<WriteRequest> requests;
+		auto write = [&](ObjectBytes* bytes)
+		{
+			auto start = _allocator.GetConcretePos(bytes->Label()) + _metadataSize;
+			bytes->WriteIn([&](vector<char> const* data)
+			{
+				if (not data->empty())
+				{
+					requests.push_back({ start, data->data(), data->size(), UseDirectIo(data->size()) });
+				}
+			});
+		};
+
+		*toResizes > write;
+		*toAllocates > write;
+		*toWrites > write;
+		Io()->Write(requests);
+
+		auto recycle = [&](ObjectBytes* bytes)
+		{
+			bytes->GiveBufferTo(&_bytesPool);
+		};
+		*toResizes > recycle;
+		*toAllocates > recycle;
+		*toWrites > recycle;
+
+		if (_compactor.has_value())
+		{
+			_compactor->Invalidate();
+		}
+		CheckpointIfLogTooBig();
+	}
+
+	void File::CommitFree(ReadStateLabelNode topNode)
+	{
+		ObjectBytes record(FileLabel);
+		AddRelationLog(&record, LogOp::FreeRelation, topNode);
+		CommitLog(record);
+		MutableRelationTree()->Free(move(topNode));
+	}
+
+	void File::CheckpointIfLogTooBig()
+	{
+		if (_wal->Size() > CheckpointLogSize)
+		{
+			Checkpoint();
+		}
+	}
+
+	void File::Replay(vector<vector<char>> const& logRecords)
+	{
 		CreateIfNotExist(_filename.get());
 		auto fs = MakeFileStream(_filename.get());
-		if (auto size = metadataBytes.Size(); size > _metadataSize) // TODO 测一下
+		for (auto& r : logRecords)
 		{
-			printf("File metadata size too big, adjust space");
-			auto data = ReadRemainDataFrom(&fs, _metadataSize);
-			ObjectBytes dataBytes(FileLabel, move(data));
+			BytesReader reader(r.data(), r.size());
+			while (not reader.AtEnd())
+			{
+				switch (static_cast<LogOp>(ByteConverter<char>::ReadOut(&reader)))
+				{
+				case LogOp::Write:
+					{
+						auto label = ByteConverter<pos_label>::ReadOut(&reader);
+						auto pos = ByteConverter<pos_int>::ReadOut(&reader);
+						auto data = ByteConverter<vector<char>>::ReadOut(&reader);
+						WriteBytes(&fs, pos + _metadataSize, data);
+						_allocator.ApplyLoggedSpace(label, pos, data.size());
+						_notStoredLabels.erase(label);
+					}
+					break;
+				case LogOp::UpdateRelation:
+					MutableRelationTree()->UpdateWith(ReadStateLabelNodeFrom(&reader));
+					break;
+				case LogOp::UpdateRelationInPlace:
+					MutableRelationTree()->UpdateInPlace(ReadStateLabelNodeFrom(&reader));
+					break;
+				case LogOp::FreeRelation:
+					MutableRelationTree()->Free(ReadStateLabelNodeFrom(&reader));
+					break;
+				case LogOp::Metadata:
+					{
+						auto count = ByteConverter<size_t>::ReadOut(&reader);
+						for (size_t i = 0; i < count; ++i)
+						{
+							auto pos = ByteConverter<pos_int>::ReadOut(&reader);
+							auto data = ByteConverter<vector<char>>::ReadOut(&reader);
+							WriteBytes(&fs, pos, data);
+						}
+						// 之前重做的都已经在这次检查点里了，从文件里重新读
+						fs.flush();
+						LoadMetadata();
+					}
+					break;
+				default:
+					throw Basic::InvalidOperationException(string(*_filename) + " has invalid log record");
+				}
+			}
+		}
+		fs.flush();
+	}
+
+	bool File::Compact(milliseconds timeSlice)
+	{
+		using ::std::chrono::steady_clock;
+		using ::std::filesystem::resize_file;
+
+		// 挪动会覆盖备份还要读的空间，等备份做完再整理
+		if (BackingUp())
+		{
+			return false;
+		}
 
-			_metadataSize = GetFitSpaceSize(size, _metadataSize);
-			ObjectBytes newMetadataBytes(FileLabel);
-			newMetadataBytes.WriteIn(&fs, MetadataStart);
-			dataBytes.WriteIn(&fs, _metadataSize);
+		auto deadline = steady_clock::now() + timeSlice;
+		if (not _compactor.has_value())
+		{
+			_compactor.emplace(GetCompactOrder());
 		}
-		else
+
+		{
+			CreateIfNotExist(_filename.get());
+			auto fs = MakeFileStream(_filename.get());
+			// 挪动的都记在一条日志里只提交一次，提交后再写到新位置，新位置可能是前面刚挪走的对象的旧位置
+			// key 是还没写下去的新位置
+			map<pos_int, vector<char>> moved;
+			size_t movedBytes = 0;
+			optional<ObjectBytes> record;
+			auto commit = [&]
+			{
+				if (record.has_value())
+				{
+					CommitLog(*record);
+					for (auto& [to, data] : moved)
+					{
+						WriteBytes(&fs, to + _metadataSize, data);
+					}
+					moved.clear();
+					movedBytes = 0;
+					record.reset();
+				}
+			};
+			auto mover = [&](pos_label label, pos_int from, pos_int to, size_t size)
+			{
+				vector<char> data;
+				if (auto it = moved.find(from); it != moved.end())
+				{
+					// 这次刚挪过去的又要挪走，旧位置上的不用再写了
+					data = move(it->second);
+					moved.erase(it);
+				}
+				else
+				{
+					data = ReadBytes(&fs, from + _metadataSize, size);
+				}
+
+				if (not record.has_value())
+				{
+					record.emplace(FileLabel);
+				}
+				// 记下挪过去的内容而不是挪动这个操作，这样重做多少次都一样
+				AddWriteLog(&*record, label, to, data);
+				movedBytes += data.size();
+				moved.insert_or_assign(to, move(data));
+				// 一次挪的太多时先提交，攒着的内容不超过这么多
+				if (movedBytes >= CheckpointLogSize)
+				{
+					commit();
+				}
+			};
+
+			auto done = _compactor->Step(&_allocator, mover, deadline);
+			commit();
+			if (not done)
+			{
+				return false;
+			}
+		}
+
+		_compactor.reset();
+		auto end = _allocator.ShrinkToUsing();
+		// 截掉之前先让元信息里的位置都是新的
+		Checkpoint();
+		resize_file(*_filename, _metadataSize + end);
+		return true;
+	}
+
+	shared_future<void> File::Backup(path const& target, size_t bytesPerSecond)
+	{
+		if (BackingUp())
+		{
+			throw Basic::InvalidOperationException(string(*_filename) + " is backing up");
+		}
+		if (::std::filesystem::exists(target) and ::std::filesystem::equivalent(target, *_filename))
+		{
+			throw Basic::InvalidOperationException("cannot back up " + string(*_filename) + " to itself");
+		}
+		_snapshot.reset();
+
+		// 日志合进文件后文件本身就是一致的，备份不用带日志
+		Checkpoint();
+		vector<char> metadata(_metadataSize);
+		// 元信息区后面没用到的部分文件里可能还没有
+		ReadSource()->Read(MetadataStart, reinterpret_cast<byte*>(metadata.data()), metadata.size(), true);
+		vector<pair<pos_label, Snapshot::Extent>> extents;
+		for (auto [pos, label] : _allocator.GetUsingLabelsSortedByPos())
+		{
+			extents.push_back({ label, { pos, _allocator.GetAllocatedSize(label) } });
+		}
+
+		// 目标路径上旧的日志打开备份时会被重放
+		::std::filesystem::remove(WriteAheadLog::LogPathOf(target));
+		_snapshot = make_unique<Snapshot>(ReadSource(), move(metadata), _metadataSize, extents, target, bytesPerSecond);
+		return _snapshot->Finished();
+	}
+
+	bool File::BackingUp() const
+	{
+		return _snapshot != nullptr and not _snapshot->Done();
+	}
+
+	void File::CancelBackup()
+	{
+		if (_snapshot != nullptr)
+		{
+			_snapshot->Cancel();
+			_snapshot->Finished().wait();
+		}
+	}
+
+	void File::WaitBackup()
+	{
+		if (_snapshot != nullptr)
 		{
-			metadataBytes.WriteIn(&fs, MetadataStart);
+			_snapshot->Finished().wait();
 		}
 	}
 
-	File::File(pos_int metadataSize, FileCache cache, shared_ptr<path> filename, StorageAllocator allocator, ObjectRelationTree relationTree)
-		: _metadataSize(metadataSize), _filename(move(filename)), _cache(move(cache)), _allocator(move(allocator)),
-		  _objRelationTree(move(relationTree))
-	{ }
+	void File::StoreLeftDirtyObjects(WriteQueue* toWrites, AllocateSpaceQueue* toAllocates, ResizeSpaceQueue* toResizes, ObjectBytes* logRecord)
+	{
+		// 父对象没改动时存储不会走到下面改动过的对象，这里单独存
+		vector<pos_label> labels;
+		{
+			lock_guard<mutex> guard(_dirtyMutex);
+			::std::erase_if(_dirtyObjects, [](auto const& item) { return item.second.Object.expired(); });
+			for (auto& [label, _] : _dirtyObjects)
+			{
+				labels.push_back(label);
+			}
+		}
+
+		for (auto label : labels)
+		{
+			// 顶层对象由它的持有者负责 Store，没存过的对象等引用它的对象存的时候再存
+			auto parent = RelationTree()->ParentOf(label);
+			if (not _allocator.Ready(label) or (parent.has_value() and parent.value() == FileLabel))
+			{
+				continue;
+			}
+
+			function<void(ObjectBytes*)> storeProcess;
+			{
+				lock_guard<mutex> guard(_dirtyMutex);
+				// 前面的存储过程可能已经存了它
+				auto it = _dirtyObjects.find(label);
+				if (it == _dirtyObjects.end())
+				{
+					continue;
+				}
+				storeProcess = move(it->second.Store);
+			}
+
+			// 存的过程里会再拿 _dirtyMutex
+			ObjectBytes bytes{ label, toWrites, toAllocates, toResizes };
+			bytes.Pool = &_bytesPool;
+			bytes.Compact = CompactEncoding();
+			storeProcess(&bytes);
+			// 对象关系里没有的（比如旧文件里的）只写内容
+			if (parent.has_value())
+			{
+				auto node = ReadStateLabelNode::ConsNodeWith(&bytes);
+				AddRelationLog(logRecord, LogOp::UpdateRelationInPlace, node);
+				MutableRelationTree()->UpdateInPlace(move(node));
+			}
+		}
+	}
+
+	bool File::IsDirty(pos_label label)
+	{
+		lock_guard<mutex> guard(_dirtyMutex);
+		return _dirtyObjects.contains(label);
+	}
+
+	void File::ClearDirty(pos_label label)
+	{
+		lock_guard<mutex> guard(_dirtyMutex);
+		_dirtyObjects.erase(label);
+	}
+
+	vector<pos_label> File::GetCompactOrder()
+	{
+		vector<pos_label> order;
+		set<pos_label> added;
+		auto add = [&](pos_label label)
+		{
+			if (_allocator.Ready(label) and added.insert(label).second)
+			{
+				order.push_back(label);
+			}
+		};
+
+		// 按对象关系的顺序排，这样 B+ 树里相关的节点会挨在一起
+		RelationTree()->TraverseInUse(add);
+		// 关系里没记录到的按原来的位置排在后面
+		for (auto [pos, label] : _allocator.GetUsingLabelsSortedByPos())
+		{
+			add(label);
+		}
+
+		return order;
+	}
 
 	fstream File::MakeFileStream(path const* filename)
 	{
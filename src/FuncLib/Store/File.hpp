@@ -1,16 +1,28 @@
 #pragma once
 #include <set>
+#include <map>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <future>
 #include <memory>
 #include <utility>
+#include <optional>
 #include <filesystem>
 #include <type_traits>
 #include "../../Basic/TypeTrait.hpp"
 #include "StaticConfig.hpp"
 #include "FileCache.hpp"
 #include "FileReader.hpp"
+#include "BytesReader.hpp"
+#include "IoEngine.hpp"
 #include "ObjectBytes.hpp"
 #include "ObjectBytesQueue.hpp"
 #include "StorageAllocator.hpp"
+#include "Compactor.hpp"
+#include "WriteAheadLog.hpp"
+#include "Snapshot.hpp"
 // 这里用到 ByteConverter，但因为 DiskPos 里面有功能依赖 File，所以这里只能声明 ByteConverter
 #include "../Persistence/FriendFuncLibDeclare.hpp"
 #include "ObjectRelation/ObjectRelationTree.hpp"
@@ -25,34 +37,88 @@ namespace FuncLib::Store
 	using FuncLib::Persistence::DiskPos;
 	using FuncLib::Persistence::Switch;
 	using FuncLib::Persistence::TakeWithDiskPos;
+	using ::std::atomic;
 	using ::std::enable_shared_from_this;
+	using ::std::exception_ptr;
 	using ::std::fstream;
+	using ::std::function;
 	using ::std::is_base_of_v;
+	using ::std::lock_guard;
 	using ::std::make_shared;
+	using ::std::make_unique;
+	using ::std::map;
 	using ::std::move;
+	using ::std::mutex;
+	using ::std::optional;
 	using ::std::pair;
 	using ::std::remove_const_t;
 	using ::std::remove_reference_t;
 	using ::std::set;
+	using ::std::promise;
+	using ::std::shared_future;
 	using ::std::shared_ptr;
+	using ::std::unique_lock;
+	using ::std::unique_ptr;
+	using ::std::vector;
+	using ::std::weak_ptr;
+	using ::std::chrono::milliseconds;
 	using ::std::filesystem::path;
 
 	class File : public enable_shared_from_this<File>
 	{
 	private:
-		friend struct FuncLib::Persistence::ByteConverter<File, false>;
-		static inline unsigned int FileCount = 0;
-
-		pos_int _metadataSize; // Byte
+		struct DirtyObject
+		{
+			/// 不持有对象，没人用了（比如被删了）就不用再存
+			weak_ptr<void const> Object;
+			/// 存这个对象的过程
+			function<void(ObjectBytes*)> Store;
+		};
+
+		static inline atomic<unsigned int> FileCount = 0;
+		/// 当前线程从硬盘读对象的嵌套层数，读的过程中构造对象的访问不算改动
+		static inline thread_local unsigned int ReadingDepth = 0;
+		/// 预读时相隔不超过这么多的对象合成一次读
+		static constexpr size_t PrefetchMergeGap = 4096;
+
+		pos_int _metadataSize = 0; // Byte
+		/// 打开的旧文件按它自己的版本读写
+		FormatVersion _formatVersion = CurrentFormatVersion;
 		shared_ptr<path> _filename;
+		/// 元信息区变大时文件会被换掉（见 GrowMetadataTo），换 _readSource 和 _io 时加这个锁
+		/// 用的时候通过 ReadSource() 和 Io() 复制一份，正在用旧的读的不受影响
+		mutable mutex _sourceMutex;
+		/// 读都用这个，按位置读，多个线程可以同时用
+		shared_ptr<PositionalFile const> _readSource;
+		/// 对象数据的读写走这个
+		shared_ptr<IoEngine> _io;
 		FileCache _cache;
 		StorageAllocator _allocator;
 		set<pos_label> _notStoredLabels;// 之后可以基于这个调整文件大小，这个是为了对象从 New 到 Store 保证的
-		ObjectRelationTree _objRelationTree;
+		/// 用到时才从文件里读
+		optional<ObjectRelationTree> _objRelationTree;
+		/// 文件里存的对象关系的大小
+		size_t _relationTreeSize = 0;
+		bool _relationTreeChanged = false;
+		/// 读的线程通过 DiskPtr 的非 const 访问会同时标记，_dirtyObjects 都在这个锁里用
+		mutex _dirtyMutex;
+		/// 存过之后又被改动的对象
+		map<pos_label, DirtyObject> _dirtyObjects;
+		/// 正在从硬盘读的对象，别的线程要读同一个就等它读完
+		mutex _loadingMutex;
+		map<pos_label, shared_future<void>> _loadings;
+		optional<Compactor> _compactor;
+		unique_ptr<WriteAheadLog> _wal;
+		/// 存储时对象字节的缓冲区，写完就还回来
+		BytesPool _bytesPool;
+		/// 正在做的在线备份
+		unique_ptr<Snapshot> _snapshot;
 	public:
+		/// 大对象（比如编译出来的二进制）的读写绕过系统的页缓存，它们读一次就放到 FileCache 里了
+		static inline bool DirectIoForLargeObjects = true;
 		static shared_ptr<File> GetFile(path const& filename);
 		/// below for make_shared use in File class only
-		File(pos_int metadataSize, FileCache cache, shared_ptr<path> filename, StorageAllocator allocator, ObjectRelationTree relationTree);
+		File(FileCache cache, shared_ptr<path> filename);
 		File(File&& that) noexcept = delete;
 		File(File const& that) = delete;
 		~File();
@@ -72,6 +138,135 @@ namespace FuncLib::Store
 			return obj;
 		}
 
+		template <typename T>
+		struct ReadAwaiter
+		{
+			/// 读完之前 File 不能析构
+			shared_ptr<File> This;
+			pos_label Label;
+			IoEngine::Executor Executor;
+			/// 位置是按这个引擎打开的文件算的，读完之前文件被换掉也接着用它
+			shared_ptr<IoEngine> Io;
+			pos_int Start = 0;
+			size_t Size = 0;
+			vector<char> Bytes;
+			/// 创建时已经读进来了的话就是它
+			shared_ptr<T> Result;
+			exception_ptr ExceptionPtr = nullptr;
+
+			bool await_ready() const
+			{
+				return Result != nullptr;
+			}
+
+			/// 在 Executor 的线程里恢复
+			void await_suspend(auto handle)
+			{
+				Bytes.resize(Size);
+				Io->ReadAsync({ Start, Bytes.data(), Bytes.size(), UseDirectIo(Bytes.size()) }, Executor, [this, handle](exception_ptr exception) mutable
+				{
+					ExceptionPtr = exception;
+					if (exception == nullptr)
+					{
+						try
+						{
+							// 别的线程同时在读的话用它读的
+							Result = This->LoadWith<T>(Label, [this] { return This->ReadOutFrom<T>(Bytes.data(), Bytes.size()); });
+						}
+						catch (...)
+						{
+							ExceptionPtr = ::std::current_exception();
+						}
+					}
+					handle.resume();
+				});
+			}
+
+			shared_ptr<T> await_resume()
+			{
+				if (ExceptionPtr != nullptr)
+				{
+					::std::rethrow_exception(ExceptionPtr);
+				}
+				return move(Result);
+			}
+		};
+
+		/// 不阻塞当前线程的读，co_await 它得到对象，读完在 executor 里恢复
+		/// 对象在文件里的位置在这里就查好，和别的改动文件的操作一样要在调用方的锁里调用，co_await 时不用
+		template <typename T>
+		ReadAwaiter<T> ReadAsync(pos_label posLabel, IoEngine::Executor executor)
+		{
+			ReadAwaiter<T> awaiter{ shared_from_this(), posLabel, move(executor) };
+			if (HasRead<T>(posLabel))
+			{
+				awaiter.Result = Read<T>(posLabel);
+			}
+			else
+			{
+				awaiter.Io = Io();
+				awaiter.Start = _allocator.GetConcretePos(posLabel) + _metadataSize;
+				awaiter.Size = _allocator.GetAllocatedSize(posLabel);
+			}
+			return awaiter;
+		}
+
+		/// 提示接下来会读这些对象，没读进来的一次提交一起读进来
+		template <typename T>
+		void Prefetch(vector<pos_label> const& labels)
+		{
+			struct Extent
+			{
+				pos_label Label;
+				pos_int Pos;
+				size_t Size;
+				size_t Request;
+			};
+
+			vector<Extent> extents;
+			for (auto l : labels)
+			{
+				if (not HasRead<T>(l) and _allocator.Ready(l))
+				{
+					extents.push_back({ l, _allocator.GetConcretePos(l), _allocator.GetAllocatedSize(l), 0 });
+				}
+			}
+			::std::sort(extents.begin(), extents.end(), [](auto& a, auto& b) { return a.Pos < b.Pos; });
+
+			// 一起存的对象在文件里是挨着的，离得近的合成一次读
+			vector<pair<pos_int, size_t>> ranges;
+			for (auto& e : extents)
+			{
+				if (not ranges.empty())
+				{
+					auto& [start, size] = ranges.back();
+					if (e.Pos <= start + size + PrefetchMergeGap)
+					{
+						size = ::std::max(size, e.Pos + e.Size - start);
+						e.Request = ranges.size() - 1;
+						continue;
+					}
+				}
+				ranges.push_back({ e.Pos, e.Size });
+				e.Request = ranges.size() - 1;
+			}
+
+			vector<vector<char>> buffers;
+			vector<ReadRequest> requests;
+			for (auto [start, size] : ranges)
+			{
+				auto& b = buffers.emplace_back(size);
+				requests.push_back({ start + _metadataSize, b.data(), size });
+			}
+			Io()->Read(requests);
+
+			for (auto& e : extents)
+			{
+				auto bytes = buffers[e.Request].data() + (e.Pos - ranges[e.Request].first);
+				LoadWith<T>(e.Label, [&] { return ReadOutFrom<T>(bytes, e.Size); });
+			}
+		}
+
 		/// New 的时候要用本来的类型，而不要用动态类型
 		template <typename T>
 		auto New(T&& t)
@@ -101,40 +296,16 @@ namespace FuncLib::Store
 		void Store(pos_label posLabel, shared_ptr<T> const& object)
 		{
 			_notStoredLabels.erase(posLabel);
-			CreateIfNotExist(_filename.get());
-
-			auto fs = MakeFileStream(_filename.get());
-			auto allocate = [&](ObjectBytes* bytes)
-			{
-				auto size = bytes->Size();
-				_allocator.GiveSpaceTo(bytes->Label(), size);
-			};
-
-			auto resize = [&](ObjectBytes* bytes)
-			{
-				_allocator.ResizeSpaceTo(bytes->Label(), bytes->Size());
-			};
-
-			auto write = [&](ObjectBytes* bytes)
-			{
-				auto start = _allocator.GetConcretePos(bytes->Label());
-				bytes->WriteIn(&fs, start + _metadataSize);
-			};
 
 			// 这里的 SizeStable 不考虑指针指向的对象，牵涉到 ByteConverter<DiskPtr> 和这下面的 if
 			WriteQueue toWrites;
 			AllocateSpaceQueue toAllocates;
 			ResizeSpaceQueue toResize;
 			ObjectBytes bytes{ posLabel, &toWrites, &toAllocates, &toResize };
+			bytes.Pool = &_bytesPool;
+			bytes.Compact = CompactEncoding();
 			ProcessStore(posLabel, object, &bytes);
-
-			toResize > resize > write; // Resize first, then allocate. Below allocates can reuse place.
-			toAllocates > allocate > write;
-			toWrites > write;
-			fs.flush();
-
-			auto readStateNode = ReadStateLabelNode::ConsNodeWith(&bytes);
-			_objRelationTree.UpdateWith(move(readStateNode));
+			CommitStore(&bytes, &toWrites, &toAllocates, &toResize);
 		}
 
 		/// Precondition: object is not null
@@ -142,6 +313,12 @@ namespace FuncLib::Store
 		void StoreInner(pos_label posLabel, shared_ptr<T> const& object, ObjectBytes* writer)
 		{
 			_notStoredLabels.erase(posLabel);
+			// 存过且没改过的对象不用再写，它下面的对象也不用看，writer 不写东西，对象关系会沿用之前的
+			if (_allocator.Ready(posLabel) and not IsDirty(posLabel))
+			{
+				return;
+			}
+
 			ProcessStore(posLabel, object, writer);
 		}
 
@@ -149,6 +326,7 @@ namespace FuncLib::Store
 		template <typename T>
 		void StoreInner(pos_label posLabel, shared_ptr<T> const& object, FakeObjectBytes* writer)
 		{
+			ClearDirty(posLabel);
 			ProcessFakeStore(posLabel, object, writer);
 
 			using SearchRoutine = typename Cons<T, typename GenerateOtherSearchRoutine<T>::Result>::Result;
@@ -160,10 +338,9 @@ namespace FuncLib::Store
 		void Delete(pos_label posLabel, shared_ptr<T> object) // 这个模仿 delete 这个接口，但暂不处理 object
 		{
 			FakeObjectBytes writer{ posLabel };
+			ClearDirty(posLabel);
 			ProcessFakeStore(posLabel, object, &writer);
-
-			auto readStateNode = ReadStateLabelNode::ConsNodeWith(&writer);
-			_objRelationTree.Free(move(readStateNode));
+			CommitFree(ReadStateLabelNode::ConsNodeWith(&writer));
 
 			using SearchRoutine = typename Cons<T, typename GenerateOtherSearchRoutine<T>::Result>::Result;
 			TryRemoveCache<SearchRoutine>(posLabel);
@@ -175,7 +352,61 @@ namespace FuncLib::Store
 			_cache.RegisterSetter(posLable, move(setter));
 		}
 
+		/// 标记对象被改动了，下次 Store 时会写它
+		template <typename T>
+		void MarkDirty(pos_label posLabel, shared_ptr<T> const& object)
+		{
+			if (ReadingDepth == 0)
+			{
+				lock_guard<mutex> guard(_dirtyMutex);
+				if (not _dirtyObjects.contains(posLabel))
+				{
+					weak_ptr<T> weak = object;
+					_dirtyObjects.emplace(posLabel, DirtyObject{ weak, [this, posLabel, weak](ObjectBytes* bytes)
+					{
+						ProcessStore(posLabel, shared_ptr<T>(weak), bytes);
+					} });
+				}
+			}
+		}
+
+		/// 整理文件空间：把在用的对象按对象关系的顺序挪到文件前部，再截掉末尾不用的空间
+		/// 每次调用最多做 timeSlice 这么久，没做完的下次调用接着做。Return true when compact is completed
+		bool Compact(milliseconds timeSlice);
+		/// 把日志里的内容合到文件里：文件数据落盘，写元信息，然后清空日志
+		void Checkpoint();
+		/// 在线备份：冻结现在已经存下的内容，在后台按大块顺序复制到 target，复制期间改动的对象写到新的位置
+		/// 冻结的旧空间之后由 Compact 收回。bytesPerSecond 限制复制的速度，为 0 时不限速
+		shared_future<void> Backup(path const& target, size_t bytesPerSecond = 0);
+		/// 停掉还在复制的备份，等复制线程停下后返回，target 上不会留下备份
+		void CancelBackup();
+
 	private:
+		bool BackingUp() const;
+		void WaitBackup();
+		vector<pos_label> GetCompactOrder();
+		void StoreLeftDirtyObjects(WriteQueue* toWrites, AllocateSpaceQueue* toAllocates, ResizeSpaceQueue* toResizes, ObjectBytes* logRecord);
+		/// 分配空间，记日志，日志落盘后再写进文件
+		void CommitStore(ObjectBytes* topBytes, WriteQueue* toWrites, AllocateSpaceQueue* toAllocates, ResizeSpaceQueue* toResizes);
+		void CommitFree(ReadStateLabelNode topNode);
+		void CommitLog(ObjectBytes const& logRecord);
+		void Replay(vector<vector<char>> const& logRecords);
+		void CheckpointIfLogTooBig();
+		/// 只读元信息区的头部，label 表的页和对象关系用到时再读
+		void LoadMetadata();
+		bool CompactEncoding() const;
+		static bool UseDirectIo(size_t size);
+		vector<char> MetadataHeadBytes() const;
+		/// 元信息区变成 newSize 这么大，后面的数据跟着挪
+		void GrowMetadataTo(pos_int newSize);
+		shared_ptr<PositionalFile const> ReadSource() const;
+		shared_ptr<IoEngine> Io() const;
+		pos_int RelationTreeStart() const;
+		ObjectRelationTree const* RelationTree();
+		ObjectRelationTree* MutableRelationTree();
+		bool IsDirty(pos_label label);
+		void ClearDirty(pos_label label);
+
 		template <typename SearchTypeList>
 		void TryRemoveCache(pos_label label)
 		{
@@ -228,7 +459,7 @@ namespace FuncLib::Store
 
 			if constexpr (OtherSearchTypeList::IsNull)
 			{
-				return SetItUp(ReadOn<Des>(label), label);
+				return Load<Des>(label);
 			}
 			else
 			{
@@ -242,13 +473,80 @@ namespace FuncLib::Store
 			}
 		}
 
+		template <typename T>
+		shared_ptr<T> Load(pos_label label)
+		{
+			return LoadWith<T>(label, [this, label] { return ReadOn<T>(label); });
+		}
+
+		/// 同一个对象同时只有一个线程从硬盘读，其他的等它读完从缓存里拿
+		/// readOut 返回读出来的对象
+		/// Precondition: label not cached when called
+		template <typename T>
+		shared_ptr<T> LoadWith(pos_label label, auto const& readOut)
+		{
+			unique_lock<mutex> lock(_loadingMutex);
+			if (auto it = _loadings.find(label); it != _loadings.end())
+			{
+				auto loading = it->second;
+				lock.unlock();
+				loading.wait();
+				// 读的线程失败了的话，这里会重新读
+				return Read<T>(label);
+			}
+
+			promise<void> loaded;
+			_loadings.emplace(label, loaded.get_future().share());
+			lock.unlock();
+			struct LoadingGuard
+			{
+				File* This;
+				pos_label Label;
+				promise<void>* Loaded;
+
+				~LoadingGuard()
+				{
+					{
+						lock_guard<mutex> guard(This->_loadingMutex);
+						This->_loadings.erase(Label);
+					}
+					Loaded->set_value();
+				}
+			} guard{ this, label, &loaded };
+
+			// 查缓存和登记之间别的线程可能刚读完
+			using SearchRoutine = typename Cons<T, typename GenerateOtherSearchRoutine<T>::Result>::Result;
+			if (HasCached<SearchRoutine>(label))
+			{
+				return Read<T>(label);
+			}
+
+			return SetItUp(readOut(), label);
+		}
+
 		template <typename T>
 		auto ReadOn(pos_label posLabel)
 		{
-			// 触发 读 的唯一一个地方
+			// 触发 读 的唯一一个地方，整个对象一次读进来
 			auto start = _allocator.GetConcretePos(posLabel);
-			// printf("read from %lu\n", start + _metadataSize);
-			auto reader = FileReader::MakeReader(this, *_filename, start + _metadataSize);
+			vector<char> bytes(_allocator.GetAllocatedSize(posLabel));
+			if (not bytes.empty())
+			{
+				Io()->Read({ ReadRequest{ start + _metadataSize, bytes.data(), bytes.size(), UseDirectIo(bytes.size()) } });
+			}
+			return ReadOutFrom<T>(bytes.data(), bytes.size());
+		}
+
+		template <typename T>
+		auto ReadOutFrom(char const* bytes, size_t size)
+		{
+			BytesReader reader(bytes, size, this);
+			reader.Compact = CompactEncoding();
+			struct ReadingDepthGuard
+			{
+				ReadingDepthGuard() { ++ReadingDepth; }
+				~ReadingDepthGuard() { --ReadingDepth; }
+			} guard;
 			return ByteConverter<T>::ReadOut(&reader);
 		}
 
@@ -285,9 +583,25 @@ namespace FuncLib::Store
 			return obj;
 		}
 
+		/// 预计对象写下来的大小，大小固定的类型直接用 Size，不然用上次存的大小
+		template <typename T>
+		size_t SizeHint(pos_label posLabel) const
+		{
+			if constexpr (ByteConverter<T>::SizeStable)
+			{
+				return ByteConverter<T>::Size;
+			}
+			else
+			{
+				return _allocator.Ready(posLabel) ? _allocator.GetAllocatedSize(posLabel) : 0;
+			}
+		}
+
 		template <typename T>
 		void ProcessStore(pos_label posLabel, shared_ptr<T> const& object, ObjectBytes* bytes)
 		{
+			ClearDirty(posLabel);
+			bytes->Reserve(SizeHint<T>(posLabel));
 			ByteConverter<T>::WriteDown(*object, bytes);// 这里把 bytes 准备好，这里的 bytes 都是和地址无关的
 
 			// 决定下一步去向
@@ -301,20 +615,27 @@ namespace FuncLib::Store
 					{
 						// 加入重分配区
 						// printf("%s add to Resizes label %d size %lu\n", typeid(T).name(), posLabel, bytes->Size());
-						bytes->ToResizes->Add(move(*bytes)); // move bytes to queue
+						bytes->ToResizes->Add(bytes->TakeOut()); // move bytes content to queue
 						return;
 					}
 				}
 
+				// 备份还在读旧的位置，不能原位写，挪到新位置
+				if (BackingUp() and _snapshot->Frozen(posLabel))
+				{
+					bytes->ToResizes->Add(bytes->TakeOut());
+					return;
+				}
+
 				// 加入待写区
 				// printf("%s add to Writes label %d size %lu\n", typeid(T).name(), posLabel, bytes->Size());
-				bytes->ToWrites->Add(move(*bytes));
+				bytes->ToWrites->Add(bytes->TakeOut());
 			}
 			else
 			{
 				// 加入待分配区
 				// printf("%s add to Allocates label %d size %lu\n", typeid(T).name(), posLabel, bytes->Size());
-				bytes->ToAllocates->Add(move(*bytes));
+				bytes->ToAllocates->Add(bytes->TakeOut());
 			}
 		}
 
@@ -4,6 +4,12 @@ namespace FuncLib::Store
 {
     FileCache::FileCache(id_int fileId) : _fileId(fileId) { }
 
+    FileCache::FileCache(FileCache&& that) noexcept
+        : _fileId(that._fileId), _registeredTypes(move(that._registeredTypes)), _unloader(move(that._unloader))
+    {
+        that._unloader = []() {};
+    }
+
     FileCache::~FileCache()
     {
         _unloader();
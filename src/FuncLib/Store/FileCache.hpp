@@ -1,24 +1,35 @@
 #pragma once
 #include <map>
+#include <set>
+#include <array>
+#include <mutex>
 #include <memory>
 #include <vector>
+#include <utility>
+#include <limits>
 #include <variant>
 #include <functional>
 #include "StaticConfig.hpp"
 
 namespace FuncLib::Store
 {
+	using ::std::array;
 	using ::std::function;
 	using ::std::get;
 	using ::std::holds_alternative;
+	using ::std::lock_guard;
 	using ::std::map;
 	using ::std::move;
+	using ::std::mutex;
+	using ::std::pair;
+	using ::std::set;
 	using ::std::shared_ptr;
 	using ::std::variant;
 	using ::std::vector;
 
 	/// 不支持继承体系下的动态类型，所以需要使用者注意存取的类型
 	/// 一个 File 仅有一个 FileCache
+	/// 同一个类型的缓存按 (file id, pos label) 分到几个分片里，每个分片一把锁，多个线程可以同时用
 	class FileCache
 	{
 	public:
@@ -27,35 +38,55 @@ namespace FuncLib::Store
 		template <typename T>
 		using SettersOf = vector<function<void(T*)>>;
 		template <typename T>
-		/// file id, pos label, setters or object
-		inline static map<id_int, map<pos_label, variant<SettersOf<T>, shared_ptr<T>>>> Cache = {};
+		struct Shard
+		{
+			mutex Mutex;
+			/// key: file id, pos label. value: setters or object
+			map<pair<id_int, pos_label>, variant<SettersOf<T>, shared_ptr<T>>> Items;
+		};
+		static constexpr size_t ShardCount = 16;
+		template <typename T>
+		inline static array<Shard<T>, ShardCount> Shards = {};
+		/// 每个类型一个，用它的地址区分类型
+		template <typename T>
+		inline static char TypeToken = 0;
 
 		id_int _fileId;
+		mutex _unloaderMutex;
+		set<char const*> _registeredTypes;
 		function<void()> _unloader = []() {};
 	public:
 		FileCache(id_int fileId);
+		FileCache(FileCache&& that) noexcept;
 		~FileCache();
 
 		template <typename T>
 		bool Cached(pos_label posLabel) const
 		{
-			return Cache<T>.contains(_fileId) 
-				and Cache<T>[_fileId].contains(posLabel)
-				and holds_alternative<shared_ptr<T>>(Cache<T>[_fileId][posLabel]);
+			auto& shard = ShardOf<T>(posLabel);
+			lock_guard<mutex> guard(shard.Mutex);
+			auto it = shard.Items.find({ _fileId, posLabel });
+			return it != shard.Items.end() and holds_alternative<shared_ptr<T>>(it->second);
 		}
 
 		template <typename T>
 		void RegisterSetter(pos_label posLabel, function<void(T*)> setter)
 		{
-			if (holds_alternative<SettersOf<T>>(Cache<T>[_fileId][posLabel]))
-			{
-				get<SettersOf<T>>(Cache<T>[_fileId][posLabel]).push_back(move(setter));
-			}
-			else
+			shared_ptr<T> obj;
 			{
-				auto& obj = get<shared_ptr<T>>(Cache<T>[_fileId][posLabel]);
-				setter(obj.get());
+				auto& shard = ShardOf<T>(posLabel);
+				lock_guard<mutex> guard(shard.Mutex);
+				auto& item = shard.Items[{ _fileId, posLabel }];
+				if (holds_alternative<SettersOf<T>>(item))
+				{
+					get<SettersOf<T>>(item).push_back(move(setter));
+					return;
+				}
+
+				obj = get<shared_ptr<T>>(item);
 			}
+
+			setter(obj.get());
 			// 如果析构的时候仍有 setters，那就需要读一下，读一下，以及设置下就有个顺序的问题，采用队列吧 TODO
 			// 或者先报异常不是处理吧
 		}
@@ -63,24 +94,21 @@ namespace FuncLib::Store
 		template <typename T>
 		bool HasSetter(pos_label posLabel)
 		{
-			if (Cache<T>[_fileId].contains(posLabel))
-			{
-				if (holds_alternative<SettersOf<T>>(Cache<T>[_fileId][posLabel]))
-				{
-					return not get<SettersOf<T>>(Cache<T>[_fileId][posLabel]).empty();
-				}
-			}
-
-			return false;
+			auto& shard = ShardOf<T>(posLabel);
+			lock_guard<mutex> guard(shard.Mutex);
+			auto it = shard.Items.find({ _fileId, posLabel });
+			return it != shard.Items.end()
+				and holds_alternative<SettersOf<T>>(it->second)
+				and not get<SettersOf<T>>(it->second).empty();
 		}
 
 		/// Precondition: HasSetter return true
 		template <typename T>
 		void Set(pos_label label, T* object)
 		{
-			auto& v = Cache<T>[_fileId][label];
-			auto& setters = std::get<SettersOf<T>>(v);
-			for (auto& s : setters)
+			auto& shard = ShardOf<T>(label);
+			lock_guard<mutex> guard(shard.Mutex);
+			for (auto& s : get<SettersOf<T>>(shard.Items[{ _fileId, label }]))
 			{
 				s(object);
 			}
@@ -89,33 +117,64 @@ namespace FuncLib::Store
 		template <typename T>
 		void Add(pos_label posLabel, shared_ptr<T> object)
 		{
-			if (not Cache<T>.contains(_fileId))
-			{
-				_unloader = [fileId = _fileId, previousUnloader = move(_unloader)]()
-				{
-					previousUnloader();
-					Cache<T>.erase(fileId);
-				};
-			}
+			RegisterUnloader<T>();
 
-			if (HasSetter<T>(posLabel))
+			auto& shard = ShardOf<T>(posLabel);
+			lock_guard<mutex> guard(shard.Mutex);
+			auto& item = shard.Items[{ _fileId, posLabel }];
+			if (holds_alternative<SettersOf<T>>(item))
 			{
-				Set<T>(posLabel, object.get());
+				for (auto& s : get<SettersOf<T>>(item))
+				{
+					s(object.get());
+				}
 			}
 
-			Cache<T>[_fileId][posLabel] = object;
+			item = move(object);
 		}
 
 		template <typename T>
 		void Remove(pos_label posLabel)
 		{
-			Cache<T>[_fileId].erase(posLabel);
+			auto& shard = ShardOf<T>(posLabel);
+			lock_guard<mutex> guard(shard.Mutex);
+			shard.Items.erase({ _fileId, posLabel });
 		}
 
 		template <typename T>
 		shared_ptr<T> Read(pos_label posLabel)
 		{
-			return get<shared_ptr<T>>(Cache<T>[_fileId][posLabel]);
+			auto& shard = ShardOf<T>(posLabel);
+			lock_guard<mutex> guard(shard.Mutex);
+			return get<shared_ptr<T>>(shard.Items[{ _fileId, posLabel }]);
+		}
+
+	private:
+		template <typename T>
+		Shard<T>& ShardOf(pos_label posLabel) const
+		{
+			auto h = static_cast<size_t>(_fileId) * 0x9E3779B9u + static_cast<size_t>(posLabel);
+			return Shards<T>[h % ShardCount];
+		}
+
+		template <typename T>
+		void RegisterUnloader()
+		{
+			lock_guard<mutex> guard(_unloaderMutex);
+			if (_registeredTypes.insert(&TypeToken<T>).second)
+			{
+				_unloader = [fileId = _fileId, previousUnloader = move(_unloader)]()
+				{
+					previousUnloader();
+					for (auto& shard : Shards<T>)
+					{
+						lock_guard<mutex> guard(shard.Mutex);
+						auto begin = shard.Items.lower_bound({ fileId, ::std::numeric_limits<pos_label>::min() });
+						auto end = shard.Items.upper_bound({ fileId, ::std::numeric_limits<pos_label>::max() });
+						shard.Items.erase(begin, end);
+					}
+				};
+			}
 		}
 	};
-}
\ No newline at end of file
+}
@@ -1,48 +1,100 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include "../Basic/Exception.hpp"
 #include "FileReader.hpp"
 
 namespace FuncLib::Store
 {
-	using ::std::ifstream;
+	using Basic::InvalidOperationException;
+	using ::std::error_code;
+	using ::std::make_shared;
+	using ::std::memset;
+	using ::std::move;
+	using ::std::string;
+	using ::std::system_error;
+	using ::std::to_string;
 
-	vector<byte> ReadByte(ifstream* readStream, pos_int start, size_t size)
+	PositionalFile::PositionalFile(path const& filename)
+		: _filename(filename), _fd(::open(filename.c_str(), O_RDONLY))
+	{ }
+
+	PositionalFile::~PositionalFile()
 	{
-		if (size == 0)
+		if (_fd != -1)
 		{
-			return { };
+			::close(_fd);
 		}
+	}
 
-		// fs.unsetf(ifstream::skipws); // Stop eating new lines in binary mode
-		readStream->seekg(start);
-		vector<byte> mem(size);
-		readStream->read(reinterpret_cast<char*>(mem.data()), size);
+	void PositionalFile::Read(pos_int start, byte* des, size_t size, bool sparse) const
+	{
+		if (_fd == -1)
+		{
+			throw InvalidOperationException("cannot open " + string(_filename) + " to read");
+		}
 
-		return mem;
+		size_t readSize = 0;
+		while (readSize < size)
+		{
+			auto n = ::pread(_fd, des + readSize, size - readSize, start + readSize);
+			if (n == -1)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				throw system_error(error_code(errno, ::std::generic_category()), "read " + string(_filename) + " failed");
+			}
+			if (n == 0)
+			{
+				break;
+			}
+			readSize += n;
+		}
+
+		if (readSize < size)
+		{
+			// 当成对象读出来的话是错的数据，不能填 0 了事
+			if (not sparse)
+			{
+				throw InvalidOperationException("unexpected end of " + string(_filename) + " at " + to_string(start + readSize));
+			}
+			memset(des + readSize, 0, size - readSize);
+		}
 	}
 
 	FileReader FileReader::MakeReader(File* file, path const& filename, pos_int pos)
 	{
-		ifstream fs(filename, ifstream::in | ifstream::binary);
-		return FileReader(file, move(fs), pos);
+		return FileReader(file, make_shared<PositionalFile const>(filename), pos);
 	}
 
-	FileReader::FileReader(ifstream readStream, pos_int startPos)
-		: FileReader(nullptr, move(readStream), startPos)
-	{ }
-
-	FileReader::FileReader(File *file, ifstream readStream, pos_int startPos)
-		: _file(file), _readStream(move(readStream)), _pos(startPos)
+	FileReader::FileReader(File *file, shared_ptr<PositionalFile const> source, pos_int startPos)
+		: _file(file), _source(move(source)), _pos(startPos)
 	{ }
 
 	vector<byte> FileReader::Read(size_t size)
 	{
-		auto pos = _pos;
+		vector<byte> mem(size);
+		ReadTo(mem.data(), size);
+		return mem;
+	}
+
+	void FileReader::ReadTo(byte* des, size_t size)
+	{
+		if (size != 0)
+		{
+			_source->Read(_pos, des, size);
+		}
 		_pos += size;
-		return ReadByte(&_readStream, pos, size);
 	}
 
 	void FileReader::Skip(size_t size)
 	{
-		Read(size);
+		_pos += size;
 	}
 
 	File* FileReader::GetLessOwnershipFile() const
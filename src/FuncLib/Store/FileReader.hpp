@@ -1,52 +1,51 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <memory>
 #include <cstddef>
 #include <filesystem>
-#include <fstream>
 #include "StaticConfig.hpp"
 
 namespace FuncLib::Store
 {
 	using ::std::array;
 	using ::std::byte;
-	using ::std::ifstream;
 	using ::std::shared_ptr;
 	using ::std::size_t;
 	using ::std::vector;
 	using ::std::filesystem::path;
 
-	vector<byte> ReadByte(ifstream* readStream, pos_int start, size_t size);
-
-	template <size_t N>
-	array<byte, N> ReadByte(ifstream* readStream, pos_int start)
+	/// 只读打开的文件，按位置读，没有共享的读位置，多个线程可以同时读
+	class PositionalFile
 	{
-		if constexpr (N == 0)
-		{
-			return {};
-		}
-
-		readStream->seekg(start);
-		array<byte, N> mem;
-		readStream->read(reinterpret_cast<char *>(&mem[0]), N);
-
-		return mem;
-	}
+	private:
+		path _filename;
+		int _fd;
+	public:
+		PositionalFile(path const& filename);
+		PositionalFile(PositionalFile const& that) = delete;
+		~PositionalFile();
+		/// 打不开、读出错或者没读满都抛异常
+		/// sparse 为 true 时超出文件末尾的部分填 0，只用在读可能还没写满的元信息区
+		void Read(pos_int start, byte* des, size_t size, bool sparse = false) const;
+	};
 
 	class File;
 	class FileReader
 	{
 	private:
 		File* _file;
-		ifstream _readStream;
+		shared_ptr<PositionalFile const> _source;
 		pos_int _pos;
 	public:
 		static FileReader MakeReader(File *file, path const &filename, pos_int pos);
-		FileReader(ifstream readStream, pos_int startPos);
-		/// if you want to use File pointer in the read process, you should chose this constructor
-		FileReader(File* file, ifstream readStream, pos_int startPos);
+		/// if you want to use File pointer in the read process, you should give file
+		FileReader(File* file, shared_ptr<PositionalFile const> source, pos_int startPos);
 		/// has side effect: move forward size positions
 		vector<byte> Read(size_t size);
+		/// 直接读到 des 里，has side effect: move forward size positions
+		void ReadTo(byte* des, size_t size);
+		/// 只移动读的位置，不读
 		void Skip(size_t size);
 		File* GetLessOwnershipFile() const;
 
@@ -54,9 +53,13 @@ namespace FuncLib::Store
 		template <size_t N>
 		array<byte, N> Read()
 		{
-			auto pos = _pos;
+			array<byte, N> mem;
+			if constexpr (N != 0)
+			{
+				_source->Read(_pos, mem.data(), N);
+			}
 			_pos += N;
-			return ReadByte<N>(&_readStream, pos);
+			return mem;
 		}
 	};
 }
@@ -0,0 +1,264 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <stdexcept>
+#include <system_error>
+#include "IoEngine.hpp"
+#include "UringIoEngine.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::aligned_alloc;
+	using ::std::current_exception;
+	using ::std::error_code;
+	using ::std::make_unique;
+	using ::std::memcpy;
+	using ::std::memset;
+	using ::std::move;
+	using ::std::out_of_range;
+	using ::std::system_error;
+	using ::std::unique_ptr;
+
+	size_t ReadAllAt(int fd, pos_int pos, char* des, size_t size)
+	{
+		size_t readSize = 0;
+		while (readSize < size)
+		{
+			auto n = ::pread(fd, des + readSize, size - readSize, pos + readSize);
+			if (n == -1)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				throw system_error(error_code(errno, ::std::generic_category()), "read store file failed");
+			}
+			if (n == 0)
+			{
+				memset(des + readSize, 0, size - readSize);
+				break;
+			}
+			readSize += n;
+		}
+		return readSize;
+	}
+
+	void WriteAllAt(int fd, pos_int pos, char const* src, size_t size)
+	{
+		size_t written = 0;
+		while (written < size)
+		{
+			auto n = ::pwrite(fd, src + written, size - written, pos + written);
+			if (n == -1)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				throw system_error(error_code(errno, ::std::generic_category()), "write store file failed");
+			}
+			written += n;
+		}
+	}
+
+	namespace
+	{
+		pos_int AlignDown(pos_int pos)
+		{
+			return pos - pos % DiskBlockSize;
+		}
+
+		pos_int AlignUp(pos_int pos)
+		{
+			return AlignDown(pos + DiskBlockSize - 1);
+		}
+
+		/// 绕过页缓存的读写，内存也要按页对齐
+		auto MakeAlignedBuffer(size_t size)
+		{
+			auto p = static_cast<char*>(aligned_alloc(DiskBlockSize, size));
+			if (p == nullptr)
+			{
+				throw ::std::bad_alloc();
+			}
+			return unique_ptr<char, void(*)(void*)>(p, &::std::free);
+		}
+
+		/// pos 和 size 都是对齐的，dataEnd 之前是要用的数据，之后只是对齐多读的
+		/// 文件在 dataEnd 之前就结束了的话抛出异常，文件末尾到 pos + size 之间对齐多出来的部分填 0
+		void ReadAlignedAt(int fd, pos_int pos, char* des, size_t size, pos_int dataEnd)
+		{
+			size_t readSize = 0;
+			while (readSize < size)
+			{
+				auto n = ::pread(fd, des + readSize, size - readSize, pos + readSize);
+				if (n == -1)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					throw system_error(error_code(errno, ::std::generic_category()), "read store file failed");
+				}
+				// 绕过页缓存读到文件末尾时返回的大小不是对齐的，不能接着从那读
+				if (n == 0 or n % DiskBlockSize != 0)
+				{
+					if (pos + readSize + n < dataEnd)
+					{
+						throw out_of_range("read past the end of store file");
+					}
+					memset(des + readSize + n, 0, size - readSize - n);
+					return;
+				}
+				readSize += n;
+			}
+		}
+	}
+
+	int OpenDirect(path const& filename)
+	{
+#ifdef __APPLE__
+		auto fd = ::open(filename.c_str(), O_RDWR);
+		if (fd != -1)
+		{
+			::fcntl(fd, F_NOCACHE, 1);
+		}
+		return fd;
+#else
+		return ::open(filename.c_str(), O_RDWR | O_DIRECT);
+#endif
+	}
+
+	void DirectReadAt(int fd, pos_int pos, char* des, size_t size)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+
+		auto start = AlignDown(pos);
+		auto end = AlignUp(pos + size);
+		auto buffer = MakeAlignedBuffer(end - start);
+		ReadAlignedAt(fd, start, buffer.get(), end - start, pos + size);
+		memcpy(des, buffer.get() + (pos - start), size);
+	}
+
+	void DirectWriteAt(int fd, pos_int pos, char const* src, size_t size)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+
+		auto start = AlignDown(pos);
+		auto end = AlignUp(pos + size);
+		auto buffer = MakeAlignedBuffer(end - start);
+		// 两头的页里还有别的对象的数据，写到文件末尾后面时页里没有数据，不用读到什么
+		if (pos != start)
+		{
+			ReadAlignedAt(fd, start, buffer.get(), DiskBlockSize, start);
+		}
+		if (pos + size != end and (end - DiskBlockSize != start or pos == start))
+		{
+			ReadAlignedAt(fd, end - DiskBlockSize, buffer.get() + (end - DiskBlockSize - start), DiskBlockSize, end - DiskBlockSize);
+		}
+		memcpy(buffer.get() + (pos - start), src, size);
+		WriteAllAt(fd, start, buffer.get(), end - start);
+	}
+
+	/// 同步的 pread/pwrite，异步读整个放到 executor 里做
+	class SyncIoEngine : public IoEngine
+	{
+	private:
+		int _fd;
+		/// 大对象的读写用这个，-1 时大对象也走 _fd
+		int _directFd;
+
+	public:
+		SyncIoEngine(path const& filename) : _fd(::open(filename.c_str(), O_RDWR)), _directFd(OpenDirect(filename))
+		{
+			if (_fd == -1)
+			{
+				throw system_error(error_code(errno, ::std::generic_category()), "open store file failed");
+			}
+		}
+
+		~SyncIoEngine() override
+		{
+			::close(_fd);
+			if (_directFd != -1)
+			{
+				::close(_directFd);
+			}
+		}
+
+		void Read(vector<ReadRequest> const& requests) override
+		{
+			for (auto& r : requests)
+			{
+				ReadOne(r);
+			}
+		}
+
+		void Write(vector<WriteRequest> const& requests) override
+		{
+			for (auto& r : requests)
+			{
+				if (r.Direct and _directFd != -1)
+				{
+					DirectWriteAt(_directFd, r.Pos, r.Src, r.Size);
+				}
+				else
+				{
+					WriteAllAt(_fd, r.Pos, r.Src, r.Size);
+				}
+			}
+		}
+
+		void ReadAsync(ReadRequest request, Executor const& executor, ReadCallback callback) override
+		{
+			executor([this, request, callback = move(callback)]
+			{
+				exception_ptr exception = nullptr;
+				try
+				{
+					ReadOne(request);
+				}
+				catch (...)
+				{
+					exception = current_exception();
+				}
+				callback(exception);
+			});
+		}
+
+	private:
+		void ReadOne(ReadRequest const& request)
+		{
+			if (request.Direct and _directFd != -1)
+			{
+				DirectReadAt(_directFd, request.Pos, request.Des, request.Size);
+			}
+			else
+			{
+				ReadAllAt(_fd, request.Pos, request.Des, request.Size);
+			}
+		}
+	};
+
+	unique_ptr<IoEngine> IoEngine::Open(path const& filename)
+	{
+#ifdef FUNCLIB_IO_URING
+		// 内核不支持或者不让用就退回同步的
+		if (auto engine = UringIoEngine::Open(filename); engine != nullptr)
+		{
+			return engine;
+		}
+#endif
+		return make_unique<SyncIoEngine>(filename);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <filesystem>
+#include "StaticConfig.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::exception_ptr;
+	using ::std::function;
+	using ::std::unique_ptr;
+	using ::std::vector;
+	using ::std::filesystem::path;
+
+	/// Direct 的请求绕过系统的页缓存，用在大对象上，免得把页缓存挤满。系统不支持时当普通请求
+	struct ReadRequest
+	{
+		pos_int Pos;
+		char* Des;
+		size_t Size;
+		bool Direct = false;
+	};
+
+	struct WriteRequest
+	{
+		pos_int Pos;
+		char const* Src;
+		size_t Size;
+		bool Direct = false;
+	};
+
+	/// File 读写对象数据用的 I/O 引擎，一批请求一起提交
+	/// 默认用 pread/pwrite，编译时定义了 FUNCLIB_IO_URING 并且系统支持的话用 io_uring（它暂时不区分 Direct）
+	class IoEngine
+	{
+	public:
+		/// callback's arg is nullptr when read succeed
+		using ReadCallback = function<void(exception_ptr)>;
+		/// 把任务交给调用方的线程池去跑，引擎自己不在它的线程里调用 callback
+		using Executor = function<void(function<void()>)>;
+
+		/// Precondition: file exists
+		static unique_ptr<IoEngine> Open(path const& filename);
+		virtual ~IoEngine() = default;
+		/// 全部完成才返回，超出文件末尾的部分填 0
+		virtual void Read(vector<ReadRequest> const& requests) = 0;
+		/// 全部完成才返回
+		virtual void Write(vector<WriteRequest> const& requests) = 0;
+		/// 提交后马上返回，读完在 executor 里调用 callback，callback 里可以阻塞
+		virtual void ReadAsync(ReadRequest request, Executor const& executor, ReadCallback callback) = 0;
+	};
+
+	/// 下面两个处理了被打断和读写不完整的情况
+	/// 读到文件末尾时后面填 0，返回从文件里读到的大小
+	size_t ReadAllAt(int fd, pos_int pos, char* des, size_t size);
+	void WriteAllAt(int fd, pos_int pos, char const* src, size_t size);
+	/// 打开一个绕过页缓存的 fd，不支持时返回 -1
+	int OpenDirect(path const& filename);
+	/// fd 是 OpenDirect 打开的。位置和大小不用对齐，内部按页对齐读写，写时两头不满一页的部分先读出来拼上
+	/// 读的范围超过文件末尾时抛出 out_of_range
+	void DirectReadAt(int fd, pos_int pos, char* des, size_t size);
+	void DirectWriteAt(int fd, pos_int pos, char const* src, size_t size);
+}
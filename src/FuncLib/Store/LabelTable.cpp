@@ -0,0 +1,164 @@
+#include <cstring>
+#include <algorithm>
+#include "LabelTable.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::memcpy;
+	using ::std::move;
+
+	LabelTable::LabelTable(size_t storedPageCount, PageLoader loader)
+		: _storedPageCount(storedPageCount), _loader(move(loader))
+	{ }
+
+	LabelTable::LabelTable(LabelTable&& that) noexcept
+		: _pages(move(that._pages)), _storedPageCount(that._storedPageCount), _loader(move(that._loader))
+	{ }
+
+	LabelTable& LabelTable::operator= (LabelTable&& that) noexcept
+	{
+		lock_guard<mutex> guard(_mutex);
+		_pages = move(that._pages);
+		_storedPageCount = that._storedPageCount;
+		_loader = move(that._loader);
+		return *this;
+	}
+
+	bool LabelTable::Is(pos_label label, LabelState state) const
+	{
+		lock_guard<mutex> guard(_mutex);
+		if (auto page = PageOf(label, false); page != nullptr)
+		{
+			return page->Entries[label % EntryCountPerPage].State == state;
+		}
+
+		return state == LabelState::None;
+	}
+
+	LabelEntry LabelTable::EntryOf(pos_label label) const
+	{
+		lock_guard<mutex> guard(_mutex);
+		return PageOf(label, false)->Entries[label % EntryCountPerPage];
+	}
+
+	void LabelTable::Set(pos_label label, LabelEntry entry)
+	{
+		lock_guard<mutex> guard(_mutex);
+		auto page = PageOf(label, true);
+		page->Entries[label % EntryCountPerPage] = entry;
+		page->Dirty = true;
+	}
+
+	size_t LabelTable::PageCount() const
+	{
+		lock_guard<mutex> guard(_mutex);
+		if (_pages.empty())
+		{
+			return _storedPageCount;
+		}
+
+		return ::std::max(_storedPageCount, _pages.rbegin()->first + 1);
+	}
+
+	size_t LabelTable::StoredPageCount() const
+	{
+		lock_guard<mutex> guard(_mutex);
+		return _storedPageCount;
+	}
+
+	void LabelTable::TakeDirtyPages(function<void(size_t, vector<char>)> const& writer)
+	{
+		auto count = PageCount();
+		lock_guard<mutex> guard(_mutex);
+		for (size_t index = 0; index < count; ++index)
+		{
+			auto it = _pages.find(index);
+			if (it == _pages.end())
+			{
+				if (index >= _storedPageCount)
+				{
+					writer(index, vector<char>(PageByteSize, 0));
+				}
+				continue;
+			}
+
+			auto& page = it->second;
+			if (not page.Dirty)
+			{
+				continue;
+			}
+
+			vector<char> bytes(PageByteSize);
+			auto p = bytes.data();
+			for (auto& e : page.Entries)
+			{
+				*p = static_cast<char>(e.State);
+				memcpy(p + sizeof(char), &e.Pos, sizeof(e.Pos));
+				memcpy(p + sizeof(char) + sizeof(e.Pos), &e.Size, sizeof(e.Size));
+				p += EntryByteSize;
+			}
+
+			writer(index, move(bytes));
+			page.Dirty = false;
+		}
+
+		_storedPageCount = count;
+	}
+
+	bool LabelTable::operator== (LabelTable const& that) const
+	{
+		vector<pair<pos_label, LabelEntry>> entries;
+		Traverse([&entries](pos_label label, LabelEntry const& e)
+		{
+			entries.push_back({ label, e });
+		});
+
+		vector<pair<pos_label, LabelEntry>> thatEntries;
+		that.Traverse([&thatEntries](pos_label label, LabelEntry const& e)
+		{
+			thatEntries.push_back({ label, e });
+		});
+
+		return entries == thatEntries;
+	}
+
+	auto LabelTable::PageOf(pos_label label, bool createIfNotExist) const -> Page*
+	{
+		size_t index = label / EntryCountPerPage;
+		if (auto it = _pages.find(index); it != _pages.end())
+		{
+			return &it->second;
+		}
+
+		if (index < _storedPageCount)
+		{
+			Page page;
+			auto bytes = _loader(index);
+			auto p = bytes.data();
+			for (auto& e : page.Entries)
+			{
+				e.State = static_cast<LabelState>(*p);
+				memcpy(&e.Pos, p + sizeof(char), sizeof(e.Pos));
+				memcpy(&e.Size, p + sizeof(char) + sizeof(e.Pos), sizeof(e.Size));
+				p += EntryByteSize;
+			}
+
+			return &_pages.emplace(index, page).first->second;
+		}
+
+		if (createIfNotExist)
+		{
+			return &_pages.emplace(index, Page()).first->second;
+		}
+
+		return nullptr;
+	}
+
+	void LabelTable::LoadAll() const
+	{
+		for (size_t index = 0; index < _storedPageCount; ++index)
+		{
+			PageOf(static_cast<pos_label>(index * EntryCountPerPage), false);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <map>
+#include <array>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <functional>
+#include "StaticConfig.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::array;
+	using ::std::function;
+	using ::std::lock_guard;
+	using ::std::map;
+	using ::std::mutex;
+	using ::std::pair;
+	using ::std::vector;
+
+	enum class LabelState : char
+	{
+		None = 0,
+		Using,
+		Deleted,
+	};
+
+	struct LabelEntry
+	{
+		LabelState State = LabelState::None;
+		pos_int Pos = 0;
+		size_t Size = 0;
+
+		bool operator== (LabelEntry const& that) const = default;
+	};
+
+	/// label 到空间的表，按 label 分成定长的页
+	/// 存的页用到时才通过 loader 读进来，存的时候只交出改过的页
+	/// 读页时加锁，多个线程可以同时查
+	class LabelTable
+	{
+	public:
+		static constexpr size_t EntryCountPerPage = 256;
+		static constexpr size_t EntryByteSize = sizeof(char) + sizeof(pos_int) + sizeof(size_t);
+		static constexpr size_t PageByteSize = EntryCountPerPage * EntryByteSize;
+		/// arg is page index, return bytes of that page
+		using PageLoader = function<vector<char>(size_t)>;
+
+	private:
+		struct Page
+		{
+			array<LabelEntry, EntryCountPerPage> Entries;
+			bool Dirty = false;
+		};
+
+		mutable mutex _mutex;
+		mutable map<size_t, Page> _pages;
+		size_t _storedPageCount = 0;
+		PageLoader _loader;
+
+	public:
+		LabelTable() = default;
+		LabelTable(size_t storedPageCount, PageLoader loader);
+		LabelTable(LabelTable&& that) noexcept;
+		LabelTable& operator= (LabelTable&& that) noexcept;
+
+		bool Is(pos_label label, LabelState state) const;
+		/// Precondition: label's state is not None
+		LabelEntry EntryOf(pos_label label) const;
+		void Set(pos_label label, LabelEntry entry);
+		/// visitor's args: pos_label, LabelEntry const&. Will load all stored pages
+		void Traverse(auto const& visitor) const
+		{
+			lock_guard<mutex> guard(_mutex);
+			LoadAll();
+			for (auto& [index, page] : _pages)
+			{
+				for (size_t i = 0; i < EntryCountPerPage; ++i)
+				{
+					if (page.Entries[i].State != LabelState::None)
+					{
+						visitor(static_cast<pos_label>(index * EntryCountPerPage + i), page.Entries[i]);
+					}
+				}
+			}
+		}
+
+		size_t PageCount() const;
+		size_t StoredPageCount() const;
+		/// writer's args: page index, page bytes. Pages between stored and new ones are given out as empty page
+		void TakeDirtyPages(function<void(size_t, vector<char>)> const& writer);
+		bool operator== (LabelTable const& that) const;
+
+	private:
+		Page* PageOf(pos_label label, bool createIfNotExist) const;
+		void LoadAll() const;
+	};
+}
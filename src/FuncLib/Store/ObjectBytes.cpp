@@ -33,25 +33,43 @@ namespace FuncLib::Store
 		return _bytes.size();
 	}
 	
-	void ObjectBytes::Add(char const* begin, size_t size)
+	void ObjectBytes::Reserve(size_t size)
 	{
-		for (size_t i = 0; i < size; ++i)
+		if (Pool != nullptr and _bytes.capacity() == 0)
+		{
+			_bytes = Pool->Take(size);
+		}
+		else
 		{
-			_bytes.push_back(begin[i]);
+			_bytes.reserve(size);
 		}
 	}
 
+	void ObjectBytes::GiveBufferTo(BytesPool* pool)
+	{
+		pool->Give(move(_bytes));
+		_bytes = {};
+	}
+
+	void ObjectBytes::Add(char const* begin, size_t size)
+	{
+		_bytes.insert(_bytes.end(), begin, begin + size);
+	}
+
 	void ObjectBytes::AddBlank(size_t size)
 	{
-		for (size_t i = 0; i < size; ++i)
-		{
-			_bytes.push_back(Blank);
-		}
+		_bytes.insert(_bytes.end(), size, Blank);
 	}
 
 	bool ObjectBytes::Written() const
 	{
-		return not _bytes.empty();
+		return _written or not _bytes.empty();
+	}
+
+	ObjectBytes ObjectBytes::TakeOut()
+	{
+		_written = true;
+		return ObjectBytes(_label, move(_bytes));
 	}
 
 	ObjectBytes* ObjectBytes::ConstructSub(pos_label label)
@@ -60,6 +78,8 @@ namespace FuncLib::Store
 		sub->ToWrites = ToWrites;
 		sub->ToAllocates = ToAllocates;
 		sub->ToResizes = ToResizes;
+		sub->Pool = Pool;
+		sub->Compact = Compact;
 		return sub;
 	}
 }
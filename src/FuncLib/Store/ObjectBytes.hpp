@@ -3,6 +3,7 @@
 #include <fstream>
 #include <vector>
 #include "StaticConfig.hpp"
+#include "BytesPool.hpp"
 #include "../../Btree/Enumerator.hpp"
 #include "ObjectRelation/LabelNodeBase.hpp"
 
@@ -23,6 +24,7 @@ namespace FuncLib::Store
 	private:
 		using Base = LabelNodeBase<ObjectBytes>;
 		vector<char> _bytes;
+		bool _written = false;
 
 	public:
 		static constexpr char Blank = ' ';
@@ -30,6 +32,10 @@ namespace FuncLib::Store
 		WriteQueue* ToWrites = nullptr;
 		AllocateSpaceQueue* ToAllocates = nullptr;
 		ResizeSpaceQueue* ToResizes = nullptr;
+		/// 有的话缓冲区从这里拿
+		BytesPool* Pool = nullptr;
+		/// 用紧凑编码写，见 CompactInt
+		bool Compact = false;
 
 		ObjectBytes(pos_label label, WriteQueue* writeQueuen = nullptr, AllocateSpaceQueue* allocateQueue = nullptr, ResizeSpaceQueue* resizeQueue = nullptr);
 		ObjectBytes(pos_label label, vector<char> bytes);
@@ -39,12 +45,18 @@ namespace FuncLib::Store
 		using Base::Label;
 
 		bool Written() const;
+		/// 把内容移出来交给写入队列，自己保留 label 结构，用来构建对象关系
+		ObjectBytes TakeOut();
 		void WriteIn(fstream* fileStream, pos_int pos) const;
 		void WriteIn(auto const& writer) const
 		{
 			writer(&_bytes);
 		}
 		size_t Size() const;
+		/// 写之前按预计的大小准备好缓冲区
+		void Reserve(size_t size);
+		/// 内容写完之后把缓冲区还给 pool
+		void GiveBufferTo(BytesPool* pool);
 		void Add(char const* begin, size_t size);
 		void AddBlank(size_t count);
 	};
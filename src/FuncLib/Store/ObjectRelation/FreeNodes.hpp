@@ -3,18 +3,34 @@
 
 namespace FuncLib::Store::ObjectRelation
 {
+	/// 不再被引用的节点，挂在根下面，之后又被引用了可以挪回去
 	class FreeNodes : private LabelTree
 	{
 	private:
 		using Base = LabelTree;
 	public:
 		using Base::Base;
-		using Base::AddSub;
-		using Base::Take;
+		using Base::Contains;
+		using Base::EqualTo;
+
+		/// 把 from 里 label 的子树收进来
+		void Collect(LabelTree* from, pos_label label)
+		{
+			from->MoveSubtreeTo(label, this, _rootLabel);
+		}
+
+		/// 把 label 的子树挪回 to 里，挂在 parent 下面
+		void Revive(pos_label label, LabelTree* to, pos_label parent)
+		{
+			MoveSubtreeTo(label, to, parent);
+		}
 
 		void ReleaseAll(auto const& releaser)
 		{
-			_fileRoot.ReleaseAll(releaser);
+			Traverse(releaser);
+			_subs.clear();
+			_parents.clear();
+			_subs[_rootLabel];
 		}
 	};	
 }
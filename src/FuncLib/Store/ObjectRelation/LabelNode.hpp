@@ -41,5 +41,15 @@ namespace FuncLib::Store::ObjectRelation
 			_subNodes.clear();
 		}
 
+		/// visitor's arg is pos_label, visit in depth first order
+		void Traverse(auto const& visitor) const
+		{
+			visitor(_label);
+			for (auto& n : _subNodes)
+			{
+				n.Traverse(visitor);
+			}
+		}
+
 	};	
 }
\ No newline at end of file
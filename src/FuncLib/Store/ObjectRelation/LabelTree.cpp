@@ -1,25 +1,124 @@
+#include <algorithm>
 #include "LabelTree.hpp"
 
 namespace FuncLib::Store::ObjectRelation
 {
+	using ::std::lower_bound;
 	using ::std::move;
 
-	LabelTree::LabelTree() : _fileRoot(FileLabel) {}
-	LabelTree::LabelTree(LabelNode root) : _fileRoot(move(root)) {}
+	LabelTree::LabelTree() : LabelTree(LabelNode(FileLabel))
+	{ }
 
-	optional<LabelNode> LabelTree::Take(pos_label label)
+	LabelTree::LabelTree(LabelNode root) : _rootLabel(root.Label())
 	{
-		// because label cannot equal to FileLabel, so take internal directly
-		return _fileRoot.TakeInside(label);
+		_subs[_rootLabel];
+		auto e = root.CreateSortedSubNodeEnumerator();
+		while (e.MoveNext())
+		{
+			AddNode(_rootLabel, e.Current());
+		}
 	}
 
-	void LabelTree::AddSub(LabelNode node)
+	bool LabelTree::Contains(pos_label label) const
 	{
-		_fileRoot.AddSub(move(node));
+		return _subs.contains(label);
+	}
+
+	vector<pos_label> const& LabelTree::SubsOf(pos_label label) const
+	{
+		return _subs.at(label);
+	}
+
+	optional<pos_label> LabelTree::ParentLabelOf(pos_label label) const
+	{
+		if (auto it = _parents.find(label); it != _parents.end())
+		{
+			return it->second;
+		}
+
+		return {};
+	}
+
+	void LabelTree::Add(pos_label parent, pos_label label)
+	{
+		_subs[label];
+		AddToSubs(parent, label);
+	}
+
+	void LabelTree::Attach(pos_label parent, pos_label label)
+	{
+		Detach(label);
+		AddToSubs(parent, label);
+	}
+
+	void LabelTree::Detach(pos_label label)
+	{
+		if (auto it = _parents.find(label); it != _parents.end())
+		{
+			auto& subs = _subs.at(it->second);
+			subs.erase(lower_bound(subs.begin(), subs.end(), label));
+			_parents.erase(it);
+		}
+	}
+
+	void LabelTree::MoveSubtreeTo(pos_label label, LabelTree* des, pos_label parent)
+	{
+		Detach(label);
+		vector<pos_label> labels{ label };
+		for (size_t i = 0; i < labels.size(); ++i)
+		{
+			auto l = labels[i];
+			auto it = _subs.find(l);
+			labels.insert(labels.end(), it->second.begin(), it->second.end());
+			for (auto sub : it->second)
+			{
+				des->_parents[sub] = l;
+				_parents.erase(sub);
+			}
+			des->_subs[l] = move(it->second);
+			_subs.erase(it);
+		}
+
+		des->AddToSubs(parent, label);
 	}
 
 	bool LabelTree::EqualTo(LabelTree const& that) const
 	{
-		return _fileRoot.EqualTo(that._fileRoot);
+		return _rootLabel == that._rootLabel and SameSubtree(_rootLabel, that);
+	}
+
+	void LabelTree::AddNode(pos_label parent, LabelNode const& node)
+	{
+		Add(parent, node.Label());
+		auto e = node.CreateSortedSubNodeEnumerator();
+		while (e.MoveNext())
+		{
+			AddNode(node.Label(), e.Current());
+		}
+	}
+
+	void LabelTree::AddToSubs(pos_label parent, pos_label label)
+	{
+		auto& subs = _subs.at(parent);
+		subs.insert(lower_bound(subs.begin(), subs.end(), label), label);
+		_parents[label] = parent;
+	}
+
+	bool LabelTree::SameSubtree(pos_label label, LabelTree const& that) const
+	{
+		auto& subs = SubsOf(label);
+		if (not that.Contains(label) or subs != that.SubsOf(label))
+		{
+			return false;
+		}
+
+		for (auto l : subs)
+		{
+			if (not SameSubtree(l, that))
+			{
+				return false;
+			}
+		}
+		return true;
 	}
 }
@@ -1,17 +1,63 @@
 #pragma once
+#include <vector>
+#include <optional>
+#include <unordered_map>
 #include "LabelNode.hpp"
 
 namespace FuncLib::Store::ObjectRelation
 {
+	using ::std::optional;
+	using ::std::unordered_map;
+	using ::std::vector;
+
+	/// 按 label 索引的树，找节点、找父节点、挪子树都不用遍历整棵树
 	class LabelTree
 	{
 	protected:
-		LabelNode _fileRoot{ FileLabel };
+		pos_label _rootLabel;
+		/// 每个节点的子节点，按 label 从小到大
+		unordered_map<pos_label, vector<pos_label>> _subs;
+		/// 根和摘下来还没挂回去的节点没有父节点
+		unordered_map<pos_label, pos_label> _parents;
+
 	public:
 		LabelTree();
 		LabelTree(LabelNode root);
-		optional<LabelNode> Take(pos_label label);
-		void AddSub(LabelNode node);
+		bool Contains(pos_label label) const;
+		/// Precondition: label is in this tree
+		vector<pos_label> const& SubsOf(pos_label label) const;
+		optional<pos_label> ParentLabelOf(pos_label label) const;
+		/// 加一个没有子节点的新节点
+		/// Precondition: parent is in this tree, label is not
+		void Add(pos_label parent, pos_label label);
+		/// 挂到 parent 下面，原来有父节点的先摘下来，子树跟着走
+		/// Precondition: parent and label are in this tree
+		void Attach(pos_label parent, pos_label label);
+		/// 从父节点上摘下来，子树还留在这棵树里，之后可以再 Attach
+		void Detach(pos_label label);
+		/// 把 label 的整个子树挪到 des 里，挂在 parent 下面
+		void MoveSubtreeTo(pos_label label, LabelTree* des, pos_label parent);
 		bool EqualTo(LabelTree const& that) const;
+
+		/// visitor's arg is pos_label, visit in depth first order
+		void Traverse(auto const& visitor) const
+		{
+			Traverse(_rootLabel, visitor);
+		}
+
+	protected:
+		void Traverse(pos_label label, auto const& visitor) const
+		{
+			visitor(label);
+			for (auto l : _subs.at(label))
+			{
+				Traverse(l, visitor);
+			}
+		}
+
+	private:
+		void AddNode(pos_label parent, LabelNode const& node);
+		void AddToSubs(pos_label parent, pos_label label);
+		bool SameSubtree(pos_label label, LabelTree const& that) const;
 	};
 }
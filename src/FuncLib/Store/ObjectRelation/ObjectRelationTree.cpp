@@ -1,11 +1,9 @@
 #include <vector>
-#include <exception>
 #include "ObjectRelationTree.hpp"
 
 namespace FuncLib::Store::ObjectRelation
 {
 	using ::std::move;
-	using ::std::out_of_range;
 	using ::std::vector;
 
 	ObjectRelationTree::ObjectRelationTree(LabelTree tree, FreeNodes freeNodes)
@@ -14,141 +12,91 @@ namespace FuncLib::Store::ObjectRelation
 
 	void ObjectRelationTree::UpdateWith(ReadStateLabelNode topNode)
 	{
-		Complete(&topNode);
-		Base::AddSub(topNode.GenLabelNode());
+		vector<pos_label> detached;
+		Apply(topNode, FileLabel, &detached);
+		CollectDetached(detached);
+	}
+
+	void ObjectRelationTree::UpdateInPlace(ReadStateLabelNode node)
+	{
+		auto parent = Base::ParentLabelOf(node.Label()).value();
+		vector<pos_label> detached;
+		Apply(node, parent, &detached);
+		CollectDetached(detached);
+	}
+
+	optional<pos_label> ObjectRelationTree::ParentOf(pos_label label) const
+	{
+		return Base::ParentLabelOf(label);
 	}
 
 	void ObjectRelationTree::Free(ReadStateLabelNode topNode)
 	{
-		Complete(&topNode);
-		_freeNodes.AddSub(topNode.GenLabelNode());
+		vector<pos_label> detached;
+		Apply(topNode, FileLabel, &detached);
+		_freeNodes.Collect(this, topNode.Label());
+		CollectDetached(detached);
 	}
 
-	void ObjectRelationTree::Complete(ReadStateLabelNode *newNode)
+	void ObjectRelationTree::Apply(ReadStateLabelNode const& node, pos_label parent, vector<pos_label>* detached)
 	{
-		if (auto r = Take(newNode->Label()); r.has_value())
+		auto label = node.Label();
+		if (Base::Contains(label))
+		{
+			if (Base::ParentLabelOf(label) != parent)
+			{
+				Base::Attach(parent, label);
+			}
+		}
+		else if (_freeNodes.Contains(label))
 		{
-			auto oldNode = move(r.value());
-			Complete(newNode, move(oldNode));
+			_freeNodes.Revive(label, this, parent);
 		}
 		else
 		{
-			auto e = newNode->CreateSortedSubNodeEnumerator();
-			while (e.MoveNext())
-			{
-				Complete(&e.Current());
-			}
+			Base::Add(parent, label);
 		}
-	}
 
-	void ObjectRelationTree::Complete(ReadStateLabelNode *newNode, LabelNode oldNode)
-	{
-		if (newNode->SubsEmpty())
+		if (node.SubsEmpty() and not node.Read)
 		{
-			if (not newNode->Read)
-			{
-				newNode->SetSubs(oldNode.GiveSubs());
-				return;
-			}
+			return;
 		}
 
-		auto oldSubs = oldNode.CreateSortedSubNodeEnumerator();
-		auto newSubs = newNode->CreateSortedSubNodeEnumerator();
-		unsigned char state = 0;
-		constexpr unsigned char newCurrentValidFlag = 0b0000'0001;
-		constexpr unsigned char oldCurrentValidFlag = 0b0000'0010;
-
-		auto setOldCurrent = [&state](bool moved)
-		{
-			if (moved)
-			{
-				state |= oldCurrentValidFlag;
-			}
-			else
-			{
-				state &= ~oldCurrentValidFlag;
-			}
-		};
-		auto setNewCurrent = [&state](bool moved)
+		// 下面挂上去的时候会改，所以复制一份
+		auto oldSubs = Base::SubsOf(label);
+		size_t i = 0;
+		auto e = node.CreateSortedSubNodeEnumerator();
+		while (e.MoveNext())
 		{
-			if (moved)
+			auto& sub = e.Current();
+			for (; i < oldSubs.size() and oldSubs[i] < sub.Label(); ++i)
 			{
-				state |= newCurrentValidFlag;
+				Base::Detach(oldSubs[i]);
+				detached->push_back(oldSubs[i]);
 			}
-			else
+			if (i < oldSubs.size() and oldSubs[i] == sub.Label())
 			{
-				state &= ~newCurrentValidFlag;
+				++i;
 			}
-		};
-		setOldCurrent(oldSubs.MoveNext());
-		setNewCurrent(newSubs.MoveNext());
-
-		while (true)
-		{
-			switch (state)
-			{
-			case 0:
-				return;
-
-			case 1:
-				do
-				{
-					Complete(&newSubs.Current());
-				} while (newSubs.MoveNext());
-				return;
-
-			case 2:
-				do
-				{
-					Collect(oldSubs.Current());
-				} while (oldSubs.MoveNext());
-				return;
-
-			case 3:
-				{
-					auto &oldSub = oldSubs.Current();
-					auto oldLabel = oldSub.Label();
-
-					auto &newSub = newSubs.Current();
-					auto newLabel = newSub.Label();
 
-					if (oldLabel < newLabel)
-					{
-						Collect(oldSub);
-						setOldCurrent(oldSubs.MoveNext());
-					}
-					else if (oldLabel == newLabel)
-					{
-						Complete(&newSub, move(oldSub));
-						setOldCurrent(oldSubs.MoveNext());
-						setNewCurrent(newSubs.MoveNext());
-					}
-					else // oldLabel > newLabel 说明 newLabel 没遇到过，可能来自 ObjectRelationTree 的其他地方或者是新加的
-					{
-						Complete(&newSub);
-						setNewCurrent(newSubs.MoveNext());
-					}
-				}
-				break;
-
-			default:
-				throw out_of_range("state out of range");
-			}
+			Apply(sub, label, detached);
 		}
-	}
 
-	optional<LabelNode> ObjectRelationTree::Take(pos_label label)
-	{
-		if (auto r = Base::Take(label); r.has_value())
+		for (; i < oldSubs.size(); ++i)
 		{
-			return r;
+			Base::Detach(oldSubs[i]);
+			detached->push_back(oldSubs[i]);
 		}
-
-		return _freeNodes.Take(label);
 	}
 
-	void ObjectRelationTree::Collect(LabelNode node)
+	void ObjectRelationTree::CollectDetached(vector<pos_label> const& detached)
 	{
-		_freeNodes.AddSub(move(node));
+		for (auto l : detached)
+		{
+			if (Base::Contains(l) and not Base::ParentLabelOf(l).has_value())
+			{
+				_freeNodes.Collect(this, l);
+			}
+		}
 	}
 }
@@ -39,6 +39,11 @@ namespace FuncLib::Store
 
 			ObjectRelationTree(LabelTree tree = {}, FreeNodes freeNodes = {});
 			void UpdateWith(ReadStateLabelNode topNode);
+			/// 单独存储的内部对象用这个更新，更新后还挂在原来的父节点下面
+			/// Precondition: node's label is in use and not top level
+			void UpdateInPlace(ReadStateLabelNode node);
+			/// Return FileLabel for top level node, empty if not in use
+			optional<pos_label> ParentOf(pos_label label) const;
 			void Free(ReadStateLabelNode topNode);
 			/// releaser's arg is pos_label
 			void ReleaseFreeNodes(auto const &releaser)
@@ -46,13 +51,24 @@ namespace FuncLib::Store
 				_freeNodes.ReleaseAll(releaser);
 			}
 
+			/// visitor's arg is pos_label, not include free nodes
+			void TraverseInUse(auto const &visitor) const
+			{
+				Base::Traverse([&visitor](pos_label label)
+				{
+					if (label != FileLabel)
+					{
+						visitor(label);
+					}
+				});
+			}
+
 		private:
-			/// complete the content from old tree to new
-			void Complete(ReadStateLabelNode *newNode);
-			/// Precondition: newNode->Label() == oldNode.Label()
-			void Complete(ReadStateLabelNode *newNode, LabelNode oldNode);
-			optional<LabelNode> Take(pos_label label);
-			void Collect(LabelNode node);
+			/// 让 node 挂在 parent 下面。只看这次写了的节点，拿它新旧的子节点比较，
+			/// 加上的边挂上去，去掉的边摘下来放进 detached，没写的节点子节点照旧
+			void Apply(ReadStateLabelNode const& node, pos_label parent, vector<pos_label>* detached);
+			/// 摘下来后在这次更新里没有挂到别处的，整个子树回收到 free nodes
+			void CollectDetached(vector<pos_label> const& detached);
 		};
 	}
 }
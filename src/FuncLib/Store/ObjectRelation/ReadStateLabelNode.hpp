@@ -2,6 +2,18 @@
 #include "LabelNodeBase.hpp"
 #include "LabelNode.hpp"
 #include "PosLabelNodeConcept.hpp"
+#include "../../Persistence/IWriterIReaderConcept.hpp"
+
+namespace FuncLib::Store
+{
+	namespace ObjectRelation
+	{
+		class ReadStateLabelNode;
+	}
+
+	using Persistence::IReader;
+	ObjectRelation::ReadStateLabelNode ReadStateLabelNodeFrom(IReader auto* reader);
+}
 
 namespace FuncLib::Store::ObjectRelation
 {
@@ -10,6 +22,7 @@ namespace FuncLib::Store::ObjectRelation
 	class ReadStateLabelNode : private LabelNodeBase<ReadStateLabelNode>
 	{
 	private:
+		friend ReadStateLabelNode FuncLib::Store::ReadStateLabelNodeFrom(IReader auto* reader);
 		using Base = LabelNodeBase<ReadStateLabelNode>;
 
 	public:
@@ -0,0 +1,180 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <system_error>
+#include "../../Basic/Exception.hpp"
+#include "Snapshot.hpp"
+
+namespace FuncLib::Store
+{
+	using ::Basic::InvalidOperationException;
+	using ::std::max;
+	using ::std::min;
+	using ::std::move;
+	using ::std::promise;
+	using ::std::string;
+	using ::std::chrono::duration;
+	using ::std::chrono::duration_cast;
+	using ::std::error_code;
+	using ::std::chrono::steady_clock;
+	using ::std::filesystem::remove;
+	using ::std::filesystem::rename;
+
+	namespace
+	{
+		/// 区间之间空出来的（删掉的对象）不超过这么多就一起复制，读写更连续
+		constexpr size_t MergeGap = 64 * 1024;
+
+		void WriteAll(int fd, char const* data, size_t size, pos_int pos, path const& target)
+		{
+			for (size_t written = 0; written < size;)
+			{
+				auto n = ::pwrite(fd, data + written, size - written, pos + written);
+				if (n == -1 and errno == EINTR)
+				{
+					continue;
+				}
+				if (n <= 0)
+				{
+					throw InvalidOperationException("write snapshot to " + string(target) + " failed");
+				}
+				written += n;
+			}
+		}
+	}
+
+	Snapshot::Snapshot(shared_ptr<PositionalFile const> source, vector<char> metadata, pos_int dataStart,
+		vector<pair<pos_label, Extent>> const& extents, path target, size_t bytesPerSecond)
+	{
+		vector<Extent> ranges;
+		for (auto& [label, e] : extents)
+		{
+			_frozenLabels.insert(label);
+			ranges.push_back(e);
+		}
+
+		promise<void> finished;
+		_finished = finished.get_future().share();
+		_copier = thread([this, source = move(source), metadata = move(metadata), dataStart, ranges = move(ranges),
+			target = move(target), bytesPerSecond, finished = move(finished)]() mutable
+		{
+			try
+			{
+				Copy(move(source), metadata, dataStart, move(ranges), target, bytesPerSecond, _cancelled);
+				_done = true;
+				finished.set_value();
+			}
+			catch (...)
+			{
+				error_code ignored;
+				remove(path(target).concat(".part"), ignored);
+				_done = true;
+				finished.set_exception(::std::current_exception());
+			}
+		});
+	}
+
+	Snapshot::~Snapshot()
+	{
+		_copier.join();
+	}
+
+	bool Snapshot::Frozen(pos_label label) const
+	{
+		return not _done and _frozenLabels.contains(label);
+	}
+
+	void Snapshot::Release(pos_label label)
+	{
+		_frozenLabels.erase(label);
+	}
+
+	bool Snapshot::Done() const
+	{
+		return _done;
+	}
+
+	shared_future<void> Snapshot::Finished() const
+	{
+		return _finished;
+	}
+
+	void Snapshot::Cancel()
+	{
+		_cancelled = true;
+	}
+
+	void Snapshot::Copy(shared_ptr<PositionalFile const> source, vector<char> const& metadata, pos_int dataStart,
+		vector<Extent> extents, path const& target, size_t bytesPerSecond, atomic<bool> const& cancelled)
+	{
+		// 先写到临时文件，完整了再换上去，目标路径上不会出现写了一半的文件
+		auto tempTarget = path(target).concat(".part");
+		auto fd = ::open(tempTarget.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd == -1)
+		{
+			throw InvalidOperationException("cannot create snapshot file " + string(tempTarget));
+		}
+		struct FdGuard
+		{
+			int Fd;
+			~FdGuard() { ::close(Fd); }
+		} guard{ fd };
+
+		::std::sort(extents.begin(), extents.end(), [](auto& a, auto& b) { return a.Pos < b.Pos; });
+		vector<Extent> runs;
+		for (auto e : extents)
+		{
+			if (not runs.empty() and e.Pos <= runs.back().Pos + runs.back().Size + MergeGap)
+			{
+				auto& r = runs.back();
+				r.Size = max(r.Size, e.Pos + e.Size - r.Pos);
+				continue;
+			}
+			runs.push_back(e);
+		}
+
+		WriteAll(fd, metadata.data(), metadata.size(), 0, target);
+
+		// 按限速算出每块最早什么时候可以开始，超前了就等一下
+		auto start = steady_clock::now();
+		size_t copied = 0;
+		vector<char> buffer(ChunkSize);
+		pos_int end = 0;
+		for (auto [pos, size] : runs)
+		{
+			for (size_t offset = 0; offset < size;)
+			{
+				if (cancelled)
+				{
+					throw InvalidOperationException("backup to " + string(target) + " is cancelled");
+				}
+				auto n = min(ChunkSize, size - offset);
+				source->Read(dataStart + pos + offset, reinterpret_cast<byte*>(buffer.data()), n);
+				WriteAll(fd, buffer.data(), n, dataStart + pos + offset, target);
+				offset += n;
+				copied += n;
+
+				if (bytesPerSecond != 0)
+				{
+					duration<double> due(static_cast<double>(copied) / bytesPerSecond);
+					::std::this_thread::sleep_until(start + duration_cast<steady_clock::duration>(due));
+				}
+			}
+			end = pos + size;
+		}
+
+		if (cancelled)
+		{
+			throw InvalidOperationException("backup to " + string(target) + " is cancelled");
+		}
+		// 没有数据时文件也要有完整的元信息区
+		if (::ftruncate(fd, dataStart + end) == -1 or ::fsync(fd) == -1)
+		{
+			throw InvalidOperationException("sync snapshot file " + string(tempTarget) + " failed");
+		}
+		rename(tempTarget, target);
+	}
+}
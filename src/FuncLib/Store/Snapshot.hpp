@@ -0,0 +1,66 @@
+#pragma once
+#include <set>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <filesystem>
+#include "StaticConfig.hpp"
+#include "FileReader.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::atomic;
+	using ::std::pair;
+	using ::std::set;
+	using ::std::shared_future;
+	using ::std::shared_ptr;
+	using ::std::thread;
+	using ::std::vector;
+	using ::std::filesystem::path;
+
+	/// 文件某一时刻的一致视图：当时的元信息和在用对象的数据区间，在后台线程里顺序复制到目标文件
+	/// 复制完之前这些区间不能被原位改写，对象改动要写到新的位置，见 Frozen
+	class Snapshot
+	{
+	public:
+		struct Extent
+		{
+			pos_int Pos;
+			size_t Size;
+		};
+
+	private:
+		/// 一次读写这么多，大块顺序读写对前台的 I/O 影响小
+		static constexpr size_t ChunkSize = 1024 * 1024;
+		/// 只在存储的线程里用
+		set<pos_label> _frozenLabels;
+		atomic<bool> _done = false;
+		atomic<bool> _cancelled = false;
+		shared_future<void> _finished;
+		thread _copier;
+
+	public:
+		/// metadata 是整个元信息区，dataStart 是元信息区的大小，extents 的位置相对于 dataStart
+		/// bytesPerSecond 为 0 时不限速
+		Snapshot(shared_ptr<PositionalFile const> source, vector<char> metadata, pos_int dataStart,
+			vector<pair<pos_label, Extent>> const& extents, path target, size_t bytesPerSecond);
+		Snapshot(Snapshot const& that) = delete;
+		~Snapshot();
+		/// 还在复制并且 label 的数据还在冻结的区间里
+		bool Frozen(pos_label label) const;
+		/// label 的数据挪到新位置后调用
+		void Release(pos_label label);
+		bool Done() const;
+		/// 复制出错时 get 会抛出异常
+		shared_future<void> Finished() const;
+		/// 让复制在下一块之前停下，Finished 里是异常，目标路径上不留文件
+		void Cancel();
+
+	private:
+		static void Copy(shared_ptr<PositionalFile const> source, vector<char> const& metadata, pos_int dataStart,
+			vector<Extent> extents, path const& target, size_t bytesPerSecond, atomic<bool> const& cancelled);
+	};
+}
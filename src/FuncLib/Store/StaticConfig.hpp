@@ -7,8 +7,20 @@ namespace FuncLib::Store
 	using ::std::size_t;
 
 	constexpr size_t DiskBlockSize = 4096; // Depend on different OS setting
+	/// 不超过这么大的对象在文件里紧挨着放
+	constexpr size_t SmallObjectSize = DiskBlockSize / 8;
+	/// 不小于这么大的对象占满最后一页，读写可以绕过系统的页缓存
+	constexpr size_t LargeObjectSize = 16 * DiskBlockSize;
 	using pos_int = size_t;
 	using pos_label = int;
 	constexpr pos_label FileLabel = 0;
 	constexpr pos_label NonLabel = INT_MAX;
+
+	/// 文件格式的版本，从 Compact 开始对象里的长度、个数这些用 varint 存
+	enum class FormatVersion : unsigned int
+	{
+		Fixed = 1,
+		Compact = 2,
+	};
+	constexpr FormatVersion CurrentFormatVersion = FormatVersion::Compact;
 }
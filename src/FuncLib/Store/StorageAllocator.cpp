@@ -1,28 +1,44 @@
 #include <string>
+#include <algorithm>
 #include "../../Basic/Exception.hpp"
 #include "StorageAllocator.hpp"
 
 namespace FuncLib::Store
 {
+	using ::std::move;
+
 	StorageAllocator::StorageAllocator(pos_int currentPos, pos_label currentLabel, map<pos_label, pair<pos_int, size_t>> usingLabelTable, map<pos_label, pair<pos_int, size_t>> deletedLabelTable)
-		: _currentPos(currentPos), _currentLabel(currentLabel),
-		  _usingLabelTable(move(usingLabelTable)), _deletedLabelTable(move(deletedLabelTable))
+		: _currentPos(currentPos), _currentLabel(currentLabel)
+	{
+		for (auto& [label, info] : usingLabelTable)
+		{
+			_labelTable.Set(label, { LabelState::Using, info.first, info.second });
+		}
+
+		for (auto& [label, info] : deletedLabelTable)
+		{
+			_labelTable.Set(label, { LabelState::Deleted, info.first, info.second });
+		}
+	}
+
+	StorageAllocator::StorageAllocator(pos_int currentPos, pos_label currentLabel, LabelTable labelTable)
+		: _currentPos(currentPos), _currentLabel(currentLabel), _labelTable(move(labelTable))
 	{
 	}
 
 	bool StorageAllocator::Ready(pos_label posLabel) const
 	{
-		return _usingLabelTable.contains(posLabel);
+		return _labelTable.Is(posLabel, LabelState::Using);
 	}
 
 	pos_int StorageAllocator::GetConcretePos(pos_label posLabel) const
 	{
-		return _usingLabelTable.find(posLabel)->second.first;
+		return _labelTable.EntryOf(posLabel).Pos;
 	}
 
 	size_t StorageAllocator::GetAllocatedSize(pos_label posLabel) const
 	{
-		return _usingLabelTable.find(posLabel)->second.second;
+		return _labelTable.EntryOf(posLabel).Size;
 	}
 
 	void StorageAllocator::AllocateSpecifiedLabel(pos_label posLabel)
@@ -31,7 +47,7 @@ namespace FuncLib::Store
 		using ::std::to_string;
 
 		// 下面是简单的检测 posLabel 是否合法
-		if (_usingLabelTable.contains(posLabel))
+		if (Ready(posLabel))
 		{
 			throw invalid_argument("label is in using: " + to_string(posLabel));
 		}
@@ -51,7 +67,7 @@ namespace FuncLib::Store
 		++_currentLabel;
 		if (not _allocatedLables.contains(_currentLabel))
 		{
-			if (not _usingLabelTable.contains(_currentLabel))
+			if (not Ready(_currentLabel))
 			{
 				_allocatedLables.insert(_currentLabel);
 				return _currentLabel;
@@ -63,17 +79,17 @@ namespace FuncLib::Store
 
 	void StorageAllocator::DeallocatePosLabel(pos_label posLabel)
 	{
-		if (_usingLabelTable.contains(posLabel))
+		if (Ready(posLabel))
 		{
-			auto allocateInfoIter = _usingLabelTable.find(posLabel);
-			_deletedLabelTable.insert(*allocateInfoIter);
-			_usingLabelTable.erase(posLabel);
+			auto entry = _labelTable.EntryOf(posLabel);
+			entry.State = LabelState::Deleted;
+			_labelTable.Set(posLabel, entry);
 			// 那是什么时候调整分配大小，那时候调用上面具体位置的地方就会受影响，所以要尽量少的依赖具体位置
 		}
 	}
 
 #define VALID_CHECK                                                                                     \
-	if (_deletedLabelTable.contains(posLabel))                                                          \
+	if (_labelTable.Is(posLabel, LabelState::Deleted))                                                  \
 	{                                                                                                   \
 		using ::Basic::InvalidAccessException;                                                          \
 		throw InvalidAccessException("Apply space for deleted label, it means have wrong code logic."); \
@@ -83,21 +99,21 @@ namespace FuncLib::Store
 	{
 		VALID_CHECK;
 		
-		// 这里是个粗糙的内存分配算法实现
-		_usingLabelTable.insert({ posLabel, { _currentPos, size }});
+		// 这里是个粗糙的内存分配算法实现，只往后放
+		auto pos = PlaceFor(_currentPos, size);
+		_labelTable.Set(posLabel, { LabelState::Using, pos, size });
 		_allocatedLables.erase(posLabel);
-		_currentPos += size;
+		_currentPos = EndOf(pos, size);
 	}
 
 	void StorageAllocator::ResizeSpaceTo(pos_label posLabel, size_t biggerSize)
 	{
 		VALID_CHECK;
 
-		using ::std::make_pair;
-		auto allocateInfoIter = _usingLabelTable.find(posLabel);
-		_deletedLabelTable.insert({ FileLabel, allocateInfoIter->second });
-		allocateInfoIter->second = make_pair(_currentPos, biggerSize);
-		_currentPos += biggerSize;
+		// 原来的空间等整理时收回
+		auto pos = PlaceFor(_currentPos, biggerSize);
+		_labelTable.Set(posLabel, { LabelState::Using, pos, biggerSize });
+		_currentPos = EndOf(pos, biggerSize);
 	}
 #undef VALID_CHECK
 
@@ -108,4 +124,119 @@ namespace FuncLib::Store
 			DeallocatePosLabel(p);
 		}
 	}
+
+	pos_int StorageAllocator::PlaceFor(pos_int from, size_t size)
+	{
+		auto offset = from % DiskBlockSize;
+		if (size <= SmallObjectSize or offset == 0)
+		{
+			return from;
+		}
+
+		// 一个 B+ 树节点这样大小的对象跨了页，读它就要读两页
+		if (size <= DiskBlockSize and offset + size <= DiskBlockSize)
+		{
+			return from;
+		}
+		return from - offset + DiskBlockSize;
+	}
+
+	pos_int StorageAllocator::EndOf(pos_int pos, size_t size)
+	{
+		auto end = pos + size;
+		if (size >= LargeObjectSize and end % DiskBlockSize != 0)
+		{
+			return end - end % DiskBlockSize + DiskBlockSize;
+		}
+		return end;
+	}
+
+	vector<pair<pos_int, pos_label>> StorageAllocator::GetUsingLabelsSortedByPos() const
+	{
+		vector<pair<pos_int, pos_label>> labels;
+		_labelTable.Traverse([&labels](pos_label label, LabelEntry const& entry)
+		{
+			if (entry.State == LabelState::Using)
+			{
+				labels.push_back({ entry.Pos, label });
+			}
+		});
+
+		::std::sort(labels.begin(), labels.end());
+		return labels;
+	}
+
+	pos_int StorageAllocator::GetEndPos() const
+	{
+		return _currentPos;
+	}
+
+	void StorageAllocator::MoveSpaceTo(pos_label posLabel, pos_int newPos)
+	{
+		auto entry = _labelTable.EntryOf(posLabel);
+		entry.Pos = newPos;
+		_labelTable.Set(posLabel, entry);
+		_currentPos = ::std::max(_currentPos, EndOf(newPos, entry.Size));
+	}
+
+	void StorageAllocator::ApplyLoggedSpace(pos_label posLabel, pos_int pos, size_t size)
+	{
+		_allocatedLables.erase(posLabel);
+		_labelTable.Set(posLabel, { LabelState::Using, pos, size });
+		_currentPos = ::std::max(_currentPos, EndOf(pos, size));
+	}
+
+	pos_int StorageAllocator::ShrinkToUsing()
+	{
+		pos_int end = 0;
+		vector<pos_label> deletedLabels;
+		_labelTable.Traverse([&](pos_label label, LabelEntry const& entry)
+		{
+			if (entry.State == LabelState::Using)
+			{
+				end = ::std::max(end, EndOf(entry.Pos, entry.Size));
+			}
+			else
+			{
+				deletedLabels.push_back(label);
+			}
+		});
+
+		for (auto l : deletedLabels)
+		{
+			_labelTable.Set(l, {});
+		}
+
+		_currentPos = end;
+		return end;
+	}
+
+	size_t StorageAllocator::LabelPageCount() const
+	{
+		return _labelTable.PageCount();
+	}
+
+	size_t StorageAllocator::StoredLabelPageCount() const
+	{
+		return _labelTable.StoredPageCount();
+	}
+
+	void StorageAllocator::TakeDirtyLabelPages(function<void(size_t, vector<char>)> const& writer)
+	{
+		_labelTable.TakeDirtyPages(writer);
+	}
+
+	map<pos_label, pair<pos_int, size_t>> StorageAllocator::LabelsIn(LabelState state) const
+	{
+		map<pos_label, pair<pos_int, size_t>> labels;
+		_labelTable.Traverse([&](pos_label label, LabelEntry const& entry)
+		{
+			if (entry.State == state)
+			{
+				labels.insert({ label, { entry.Pos, entry.Size } });
+			}
+		});
+
+		return labels;
+	}
 }
@@ -3,8 +3,10 @@
 #include <utility>
 #include <filesystem>
 #include <map>
+#include <vector>
 #include "StaticConfig.hpp"
 #include "ObjectBytes.hpp"
+#include "LabelTable.hpp"
 #include "../Persistence/FriendFuncLibDeclare.hpp"
 #include "../Persistence/IWriterIReaderConcept.hpp"
 
@@ -14,6 +16,7 @@ namespace FuncLib::Store
 	using ::std::map;
 	using ::std::pair;
 	using ::std::set;
+	using ::std::vector;
 	using ::std::filesystem::path;
 
 	class StorageAllocator
@@ -22,13 +25,15 @@ namespace FuncLib::Store
 		friend struct Persistence::ByteConverter<StorageAllocator, false>;
 		friend StorageAllocator ReadAllocatedInfoFrom(IReader auto* reader);
 		friend void WriteAllocatedInfoTo(StorageAllocator const& allocator, ObjectBytes* bytes);
-		pos_int _currentPos;
-		pos_label _currentLabel;
+		friend StorageAllocator ReadAllocatorHeadFrom(IReader auto* reader, LabelTable::PageLoader pageLoader);
+		friend void WriteAllocatorHeadTo(StorageAllocator const& allocator, ObjectBytes* bytes);
+		pos_int _currentPos = 0;
+		pos_label _currentLabel = 0;
 		// 实际上这里相当于是偏移，最后在 OutDiskPtr 里面可以加一个基础地址
 		// 分配的也是偏移
 		set<pos_label> _allocatedLables;
-		map<pos_label, pair<pos_int, size_t>> _usingLabelTable;
-		map<pos_label, pair<pos_int, size_t>> _deletedLabelTable; // 优先从这里分配
+		/// 在用和删除的 label 都在这里
+		LabelTable _labelTable;
 	public:
 		StorageAllocator() = default;
 		pos_label AllocatePosLabel();
@@ -42,7 +47,27 @@ namespace FuncLib::Store
 		void ResizeSpaceTo(pos_label posLabel, size_t biggerSize);
 		void DeallocatePosLabel(pos_label posLabel);
 		void DeallocatePosLabels(set<pos_label> const& posLabels);
+		/// 按大小决定对象从 from 往后放在哪：小对象紧挨着放，不超过一页的不跨页，更大的从页开头放
+		static pos_int PlaceFor(pos_int from, size_t size);
+		/// 放在 pos 的对象之后，下一个对象最早可以从哪开始。大对象占满最后一页
+		static pos_int EndOf(pos_int pos, size_t size);
+		/// below for compact
+		vector<pair<pos_int, pos_label>> GetUsingLabelsSortedByPos() const;
+		pos_int GetEndPos() const;
+		/// keep the allocated size, only change position
+		void MoveSpaceTo(pos_label posLabel, pos_int newPos);
+		/// 整理完后调用，丢掉删除的空间记录，把分配位置收缩到在用空间的末尾
+		/// Return new end position
+		pos_int ShrinkToUsing();
+		/// 重放日志用，把记录里的位置和大小设给 posLabel
+		void ApplyLoggedSpace(pos_label posLabel, pos_int pos, size_t size);
+		/// below for paged persistence
+		size_t LabelPageCount() const;
+		size_t StoredLabelPageCount() const;
+		void TakeDirtyLabelPages(function<void(size_t, vector<char>)> const& writer);
 	private:
 		StorageAllocator(pos_int currentPos, pos_label currentLabel, map<pos_label, pair<pos_int, size_t>> posLabelTable, map<pos_label, pair<pos_int, size_t>> deletedLabels);
+		StorageAllocator(pos_int currentPos, pos_label currentLabel, LabelTable labelTable);
+		map<pos_label, pair<pos_int, size_t>> LabelsIn(LabelState state) const;
 	};
 }
\ No newline at end of file
@@ -25,32 +25,60 @@ namespace FuncLib::Store
 		return nodes;
 	}
 
-	void WriteSubLabelsOf(LabelNode const* node, ObjectBytes* writer)
+	void WriteSubLabelsOf(pos_label label, auto const& subsOf, ObjectBytes* writer)
 	{
-		auto e1 = node->CreateSortedSubNodeEnumerator();
-		while (e1.MoveNext())
+		auto& subs = subsOf(label);
+		for (auto l : subs)
 		{
-			auto l = e1.Current().Label();
 			ByteConverter<pos_label>::WriteDown(l, writer);
 		}
 
 		ByteConverter<pos_label>::WriteDown(NonLabel, writer);
 
-		auto e2 = node->CreateSortedSubNodeEnumerator();
-		while (e2.MoveNext())
+		for (auto l : subs)
 		{
-			WriteSubLabelsOf(&e2.Current(), writer);
+			WriteSubLabelsOf(l, subsOf, writer);
 		}
 	}
 
 	void WriteObjRelationTree(ObjectRelationTree const& tree, ObjectBytes* writer)
 	{
-		ByteConverter<pos_label>::WriteDown(tree._fileRoot.Label(), writer);
-		WriteSubLabelsOf(&tree._fileRoot, writer);
+		auto subsOf = [&tree](pos_label label) -> vector<pos_label> const&
+		{
+			return tree.SubsOf(label);
+		};
+		ByteConverter<pos_label>::WriteDown(tree._rootLabel, writer);
+		WriteSubLabelsOf(tree._rootLabel, subsOf, writer);
+	}
+
+	void WriteReadStateLabelNode(ReadStateLabelNode const& node, ObjectBytes* writer)
+	{
+		ByteConverter<pos_label>::WriteDown(node.Label(), writer);
+		ByteConverter<bool>::WriteDown(node.Read, writer);
+		size_t count = 0;
+		auto e1 = node.CreateSortedSubNodeEnumerator();
+		while (e1.MoveNext())
+		{
+			++count;
+		}
+		ByteConverter<size_t>::WriteDown(count, writer);
+
+		auto e2 = node.CreateSortedSubNodeEnumerator();
+		while (e2.MoveNext())
+		{
+			WriteReadStateLabelNode(e2.Current(), writer);
+		}
 	}
 
 	void WriteAllocatedInfoTo(StorageAllocator const& allocator, ObjectBytes* bytes)
 	{
 		ByteConverter<StorageAllocator>::WriteDown(allocator, bytes);
 	}
-}
\ No newline at end of file
+
+	void WriteAllocatorHeadTo(StorageAllocator const& allocator, ObjectBytes* bytes)
+	{
+		ByteConverter<pos_int>::WriteDown(allocator._currentPos, bytes);
+		ByteConverter<pos_label>::WriteDown(allocator._currentLabel, bytes);
+		ByteConverter<size_t>::WriteDown(allocator.StoredLabelPageCount(), bytes);
+	}
+}
@@ -6,6 +6,7 @@
 /// 其他类支持 ByteConverter 的样板
 namespace FuncLib::Persistence
 {
+	using FuncLib::Store::LabelState;
 	using FuncLib::Store::StorageAllocator;
 
 	template <>
@@ -14,16 +15,16 @@ namespace FuncLib::Persistence
 		using ThisType = StorageAllocator;
 		using DataMember0 = decltype(declval<ThisType>()._currentPos);
 		using DataMember1 = decltype(declval<ThisType>()._currentLabel);
-		using DataMember2 = decltype(declval<ThisType>()._usingLabelTable);
-		using DataMember3 = decltype(declval<ThisType>()._deletedLabelTable);
+		using DataMember2 = map<pos_label, pair<pos_int, size_t>>;
+		using DataMember3 = map<pos_label, pair<pos_int, size_t>>;
 		static constexpr bool SizeStable = All<GetSizeStable, DataMember0, DataMember1, DataMember2, DataMember3>::Result;
 
 		static void WriteDown(ThisType const &p, IWriter auto *writer)
 		{
 			ByteConverter<DataMember0>::WriteDown(p._currentPos, writer);
 			ByteConverter<DataMember1>::WriteDown(p._currentLabel, writer);
-			ByteConverter<DataMember2>::WriteDown(p._usingLabelTable, writer);
-			ByteConverter<DataMember3>::WriteDown(p._deletedLabelTable, writer);
+			ByteConverter<DataMember2>::WriteDown(p.LabelsIn(LabelState::Using), writer);
+			ByteConverter<DataMember3>::WriteDown(p.LabelsIn(LabelState::Deleted), writer);
 		}
 
 		static ThisType ReadOut(IReader auto* reader)
@@ -85,10 +86,39 @@ namespace FuncLib::Store
 
 	void WriteObjRelationTree(ObjectRelationTree const& tree, ObjectBytes* writer);
 
+	ReadStateLabelNode ReadStateLabelNodeFrom(IReader auto* reader)
+	{
+		auto label = ByteConverter<pos_label>::ReadOut(reader);
+		auto read = ByteConverter<bool>::ReadOut(reader);
+		auto count = ByteConverter<size_t>::ReadOut(reader);
+		vector<ReadStateLabelNode> subs;
+		subs.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			subs.push_back(ReadStateLabelNodeFrom(reader));
+		}
+
+		return ReadStateLabelNode(label, move(subs), read);
+	}
+
+	void WriteReadStateLabelNode(ReadStateLabelNode const& node, ObjectBytes* writer);
+
 	StorageAllocator ReadAllocatedInfoFrom(IReader auto* reader)
 	{
 		return ByteConverter<StorageAllocator>::ReadOut(reader);
 	}
 
 	void WriteAllocatedInfoTo(StorageAllocator const &allocator, ObjectBytes *bytes);
+
+	/// 只读头部，label 表的页用到时再通过 pageLoader 读
+	StorageAllocator ReadAllocatorHeadFrom(IReader auto* reader, LabelTable::PageLoader pageLoader)
+	{
+		auto currentPos = ByteConverter<pos_int>::ReadOut(reader);
+		auto currentLabel = ByteConverter<pos_label>::ReadOut(reader);
+		auto pageCount = ByteConverter<size_t>::ReadOut(reader);
+		return StorageAllocator(currentPos, currentLabel, LabelTable(pageCount, move(pageLoader)));
+	}
+
+	/// 页数写的是已经存下的页数，先把页存下再调用这个
+	void WriteAllocatorHeadTo(StorageAllocator const &allocator, ObjectBytes *bytes);
 }
\ No newline at end of file
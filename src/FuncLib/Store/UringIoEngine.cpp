@@ -0,0 +1,422 @@
+#ifdef FUNCLIB_IO_URING
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <cerrno>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include "UringIoEngine.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::atomic_ref;
+	using ::std::current_exception;
+	using ::std::error_code;
+	using ::std::lock_guard;
+	using ::std::make_exception_ptr;
+	using ::std::memory_order_acquire;
+	using ::std::memory_order_release;
+	using ::std::min;
+	using ::std::move;
+	using ::std::out_of_range;
+	using ::std::pair;
+	using ::std::system_error;
+	using ::std::unique_lock;
+
+	namespace
+	{
+		constexpr unsigned RingEntries = 256;
+		/// 一个 sqe 的长度是 32 位，大的请求先提交这么多，剩下的按不完整读写补
+		constexpr size_t MaxSqeSize = 1 << 30;
+
+		int SetupRing(unsigned entries, io_uring_params* params)
+		{
+			return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+		}
+
+		int EnterRing(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+		{
+			return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+		}
+
+		system_error ErrorOf(int errorNum, char const* message)
+		{
+			return system_error(error_code(errorNum, ::std::generic_category()), message);
+		}
+
+		template <typename T>
+		T* At(void* base, unsigned offset)
+		{
+			return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+		}
+	}
+
+	unique_ptr<IoEngine> UringIoEngine::Open(path const& filename)
+	{
+		io_uring_params params{};
+		auto ringFd = SetupRing(RingEntries, &params);
+		if (ringFd < 0)
+		{
+			return nullptr;
+		}
+
+		auto fd = ::open(filename.c_str(), O_RDWR);
+		if (fd == -1)
+		{
+			auto e = errno;
+			::close(ringFd);
+			throw ErrorOf(e, "open store file failed");
+		}
+
+		unique_ptr<UringIoEngine> engine(new UringIoEngine(fd, ringFd, params));
+		if (not engine->MapRings(params))
+		{
+			return nullptr;
+		}
+
+		auto e = engine.get();
+		e->_reaper = thread([e] { e->Reap(); });
+		return engine;
+	}
+
+	UringIoEngine::UringIoEngine(int fd, int ringFd, io_uring_params const& params)
+		: _fd(fd), _ringFd(ringFd), _sqEntries(params.sq_entries), _cqEntries(params.cq_entries)
+	{ }
+
+	bool UringIoEngine::MapRings(io_uring_params const& params)
+	{
+		_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		auto singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (singleMap)
+		{
+			_sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+		}
+
+		auto map = [this](size_t size, off_t offset) -> void*
+		{
+			auto p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, offset);
+			return p == MAP_FAILED ? nullptr : p;
+		};
+
+		_sqRing = map(_sqRingSize, IORING_OFF_SQ_RING);
+		if (_sqRing == nullptr)
+		{
+			return false;
+		}
+		_cqRing = singleMap ? _sqRing : map(_cqRingSize, IORING_OFF_CQ_RING);
+		if (_cqRing == nullptr)
+		{
+			return false;
+		}
+		_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		_sqes = static_cast<io_uring_sqe*>(map(_sqesSize, IORING_OFF_SQES));
+		if (_sqes == nullptr)
+		{
+			return false;
+		}
+
+		_sqTail = At<unsigned>(_sqRing, params.sq_off.tail);
+		_sqMask = At<unsigned>(_sqRing, params.sq_off.ring_mask);
+		_sqArray = At<unsigned>(_sqRing, params.sq_off.array);
+		_cqHead = At<unsigned>(_cqRing, params.cq_off.head);
+		_cqTail = At<unsigned>(_cqRing, params.cq_off.tail);
+		_cqMask = At<unsigned>(_cqRing, params.cq_off.ring_mask);
+		_cqes = At<io_uring_cqe>(_cqRing, params.cq_off.cqes);
+		return true;
+	}
+
+	UringIoEngine::~UringIoEngine()
+	{
+		if (_reaper.joinable())
+		{
+			{
+				// 同步的读写都是等完成才返回的，只用等异步读的 callback 跑完
+				unique_lock<mutex> lock(_submitMutex);
+				_slotFreed.wait(lock, [this] { return _asyncsPending == 0; });
+			}
+			// user_data 为 0 的 nop 通知 reaper 退出
+			Submit({ PrepareSqe(IORING_OP_NOP, 0, nullptr, 0, nullptr) });
+			_reaper.join();
+		}
+
+		if (_sqes != nullptr)
+		{
+			::munmap(_sqes, _sqesSize);
+		}
+		if (_cqRing != nullptr and _cqRing != _sqRing)
+		{
+			::munmap(_cqRing, _cqRingSize);
+		}
+		if (_sqRing != nullptr)
+		{
+			::munmap(_sqRing, _sqRingSize);
+		}
+		::close(_ringFd);
+		::close(_fd);
+	}
+
+	void UringIoEngine::Read(vector<ReadRequest> const& requests)
+	{
+		if (requests.empty())
+		{
+			return;
+		}
+
+		Batch batch;
+		batch.Remaining = requests.size();
+		batch.Results.resize(requests.size());
+		vector<Op> ops(requests.size());
+		vector<io_uring_sqe> sqes;
+		sqes.reserve(requests.size());
+		for (size_t i = 0; auto& r : requests)
+		{
+			ops[i] = Op{ .OwnerBatch = &batch, .Index = i };
+			sqes.push_back(PrepareSqe(IORING_OP_READ, r.Pos, r.Des, r.Size, &ops[i]));
+			++i;
+		}
+
+		Submit(sqes);
+		{
+			unique_lock<mutex> lock(batch.Mutex);
+			batch.Done.wait(lock, [&] { return batch.Remaining == 0; });
+		}
+
+		for (size_t i = 0; auto& r : requests)
+		{
+			auto res = batch.Results[i++];
+			if (res < 0)
+			{
+				throw ErrorOf(-res, "read store file failed");
+			}
+			if (static_cast<size_t>(res) < r.Size)
+			{
+				ReadRestOf(r, res);
+			}
+		}
+	}
+
+	void UringIoEngine::Write(vector<WriteRequest> const& requests)
+	{
+		if (requests.empty())
+		{
+			return;
+		}
+
+		Batch batch;
+		batch.Remaining = requests.size();
+		batch.Results.resize(requests.size());
+		vector<Op> ops(requests.size());
+		vector<io_uring_sqe> sqes;
+		sqes.reserve(requests.size());
+		for (size_t i = 0; auto& r : requests)
+		{
+			ops[i] = Op{ .OwnerBatch = &batch, .Index = i };
+			sqes.push_back(PrepareSqe(IORING_OP_WRITE, r.Pos, r.Src, r.Size, &ops[i]));
+			++i;
+		}
+
+		Submit(sqes);
+		{
+			unique_lock<mutex> lock(batch.Mutex);
+			batch.Done.wait(lock, [&] { return batch.Remaining == 0; });
+		}
+
+		for (size_t i = 0; auto& r : requests)
+		{
+			auto res = batch.Results[i++];
+			if (res < 0)
+			{
+				throw ErrorOf(-res, "write store file failed");
+			}
+			if (static_cast<size_t>(res) < r.Size)
+			{
+				WriteAllAt(_fd, r.Pos + res, r.Src + res, r.Size - res);
+			}
+		}
+	}
+
+	void UringIoEngine::ReadAsync(ReadRequest request, Executor const& executor, ReadCallback callback)
+	{
+		auto op = new Op{ .AsyncRequest = request, .AsyncExecutor = executor, .Callback = move(callback) };
+		{
+			lock_guard<mutex> guard(_submitMutex);
+			++_asyncsPending;
+		}
+		try
+		{
+			Submit({ PrepareSqe(IORING_OP_READ, request.Pos, request.Des, request.Size, op) });
+		}
+		catch (...)
+		{
+			delete op;
+			{
+				lock_guard<mutex> guard(_submitMutex);
+				--_asyncsPending;
+			}
+			_slotFreed.notify_all();
+			throw;
+		}
+	}
+
+	io_uring_sqe UringIoEngine::PrepareSqe(unsigned char opcode, pos_int pos, void const* buffer, size_t size, Op* op) const
+	{
+		io_uring_sqe sqe{};
+		sqe.opcode = opcode;
+		sqe.fd = _fd;
+		sqe.off = pos;
+		sqe.addr = reinterpret_cast<decltype(sqe.addr)>(buffer);
+		sqe.len = static_cast<unsigned>(min(size, MaxSqeSize));
+		sqe.user_data = reinterpret_cast<decltype(sqe.user_data)>(op);
+		return sqe;
+	}
+
+	void UringIoEngine::Submit(vector<io_uring_sqe> const& sqes)
+	{
+		unique_lock<mutex> lock(_submitMutex);
+		for (size_t i = 0; i < sqes.size();)
+		{
+			// 在途的不超过 cq 的容量，completion 就不会溢出
+			_slotFreed.wait(lock, [this] { return _inFlight < _cqEntries; });
+			auto n = static_cast<unsigned>(min<size_t>({ sqes.size() - i, _sqEntries, _cqEntries - _inFlight }));
+
+			auto tail = *_sqTail;
+			for (unsigned j = 0; j < n; ++j, ++tail)
+			{
+				auto index = tail & *_sqMask;
+				_sqes[index] = sqes[i + j];
+				_sqArray[index] = index;
+			}
+			atomic_ref<unsigned>(*_sqTail).store(tail, memory_order_release);
+			_inFlight += n;
+
+			for (unsigned submitted = 0; submitted < n;)
+			{
+				auto ret = EnterRing(_ringFd, n - submitted, 0, 0);
+				if (ret < 0)
+				{
+					auto e = errno;
+					if (e == EINTR)
+					{
+						continue;
+					}
+					if (e == EAGAIN or e == EBUSY)
+					{
+						// 让 reaper 收一下
+						lock.unlock();
+						std::this_thread::yield();
+						lock.lock();
+						continue;
+					}
+					throw ErrorOf(e, "submit io_uring request failed");
+				}
+				submitted += ret;
+			}
+			i += n;
+		}
+	}
+
+	void UringIoEngine::Reap()
+	{
+		for (;;)
+		{
+			auto head = *_cqHead;
+			auto tail = atomic_ref<unsigned>(*_cqTail).load(memory_order_acquire);
+			if (head == tail)
+			{
+				if (EnterRing(_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 and errno != EINTR)
+				{
+					// 没法再收 completion，不可恢复
+					std::terminate();
+				}
+				continue;
+			}
+
+			vector<pair<Op*, int>> completions;
+			for (; head != tail; ++head)
+			{
+				auto& cqe = _cqes[head & *_cqMask];
+				completions.push_back({ reinterpret_cast<Op*>(cqe.user_data), cqe.res });
+			}
+			atomic_ref<unsigned>(*_cqHead).store(head, memory_order_release);
+
+			{
+				// 提交时 op 都是在这个锁之前准备好的
+				lock_guard<mutex> guard(_submitMutex);
+				_inFlight -= static_cast<unsigned>(completions.size());
+			}
+			_slotFreed.notify_all();
+
+			auto stop = false;
+			for (auto [op, res] : completions)
+			{
+				if (op == nullptr)
+				{
+					stop = true;
+				}
+				else if (op->OwnerBatch == nullptr)
+				{
+					op->AsyncExecutor([this, op, res] { CompleteAsync(op, res); });
+				}
+				else
+				{
+					auto batch = op->OwnerBatch;
+					lock_guard<mutex> guard(batch->Mutex);
+					batch->Results[op->Index] = res;
+					if (--batch->Remaining == 0)
+					{
+						batch->Done.notify_all();
+					}
+				}
+			}
+
+			if (stop)
+			{
+				return;
+			}
+		}
+	}
+
+	void UringIoEngine::ReadRestOf(ReadRequest const& request, size_t readSize)
+	{
+		auto rest = request.Size - readSize;
+		// 和同步的一样，大对象的读不能超过文件末尾
+		if (ReadAllAt(_fd, request.Pos + readSize, request.Des + readSize, rest) < rest and request.Direct)
+		{
+			throw out_of_range("read past the end of store file");
+		}
+	}
+
+	void UringIoEngine::CompleteAsync(Op* op, int res)
+	{
+		exception_ptr exception = nullptr;
+		auto& r = op->AsyncRequest;
+		if (res < 0)
+		{
+			exception = make_exception_ptr(ErrorOf(-res, "read store file failed"));
+		}
+		else if (static_cast<size_t>(res) < r.Size)
+		{
+			try
+			{
+				ReadRestOf(r, res);
+			}
+			catch (...)
+			{
+				exception = current_exception();
+			}
+		}
+		op->Callback(exception);
+		delete op;
+
+		{
+			lock_guard<mutex> guard(_submitMutex);
+			--_asyncsPending;
+		}
+		_slotFreed.notify_all();
+	}
+}
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+#ifdef FUNCLIB_IO_URING
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <linux/io_uring.h>
+#include "IoEngine.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::condition_variable;
+	using ::std::mutex;
+	using ::std::thread;
+
+	/// 直接用系统调用的 io_uring，一批请求尽量一次 io_uring_enter 提交
+	/// 完成由 reaper 线程收，收齐一批后唤醒提交的线程，异步读的 callback 交给调用方的 executor，免得 reaper 被 callback 堵住
+	class UringIoEngine : public IoEngine
+	{
+	private:
+		struct Batch
+		{
+			mutex Mutex;
+			condition_variable Done;
+			size_t Remaining;
+			vector<int> Results;
+		};
+
+		struct Op
+		{
+			Batch* OwnerBatch = nullptr;
+			size_t Index = 0;
+			ReadRequest AsyncRequest{};
+			Executor AsyncExecutor;
+			ReadCallback Callback;
+		};
+
+		int _fd;
+		int _ringFd;
+		unsigned _sqEntries;
+		unsigned _cqEntries;
+
+		void* _sqRing = nullptr;
+		size_t _sqRingSize = 0;
+		void* _cqRing = nullptr;
+		size_t _cqRingSize = 0;
+		io_uring_sqe* _sqes = nullptr;
+		size_t _sqesSize = 0;
+
+		unsigned* _sqTail;
+		unsigned* _sqMask;
+		unsigned* _sqArray;
+		unsigned* _cqHead;
+		unsigned* _cqTail;
+		unsigned* _cqMask;
+		io_uring_cqe* _cqes;
+
+		mutex _submitMutex;
+		condition_variable _slotFreed;
+		unsigned _inFlight = 0;
+		/// 提交了但 callback 还没跑完的异步读，析构时要等它们
+		unsigned _asyncsPending = 0;
+
+		thread _reaper;
+
+	public:
+		/// return nullptr if io_uring is not available
+		static unique_ptr<IoEngine> Open(path const& filename);
+		~UringIoEngine() override;
+
+		void Read(vector<ReadRequest> const& requests) override;
+		void Write(vector<WriteRequest> const& requests) override;
+		void ReadAsync(ReadRequest request, Executor const& executor, ReadCallback callback) override;
+
+	private:
+		UringIoEngine(int fd, int ringFd, io_uring_params const& params);
+		bool MapRings(io_uring_params const& params);
+		io_uring_sqe PrepareSqe(unsigned char opcode, pos_int pos, void const* buffer, size_t size, Op* op) const;
+		void Submit(vector<io_uring_sqe> const& sqes);
+		void Reap();
+		/// 只读到了 readSize 时接着读剩下的
+		void ReadRestOf(ReadRequest const& request, size_t readSize);
+		void CompleteAsync(Op* op, int res);
+	};
+}
+#endif
@@ -0,0 +1,230 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include "WriteAheadLog.hpp"
+
+namespace FuncLib::Store
+{
+	using ::std::current_exception;
+	using ::std::error_code;
+	using ::std::ifstream;
+	using ::std::lock_guard;
+	using ::std::memcpy;
+	using ::std::move;
+	using ::std::rethrow_exception;
+	using ::std::system_error;
+	using ::std::uint32_t;
+	using ::std::unique_lock;
+
+	// frame: record size(uint32_t), checksum(uint32_t), record
+	constexpr size_t FrameHeadSize = sizeof(uint32_t) * 2;
+
+	uint32_t Checksum(char const* begin, size_t size)
+	{
+		// FNV-1a
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= static_cast<unsigned char>(begin[i]);
+			hash *= 16777619u;
+		}
+
+		return hash;
+	}
+
+	void ThrowSystemError(char const* operation)
+	{
+		throw system_error(error_code(errno, ::std::generic_category()), operation);
+	}
+
+	path WriteAheadLog::LogPathOf(path const& filename)
+	{
+		auto p = filename;
+		p += ".wal";
+		return p;
+	}
+
+	vector<vector<char>> WriteAheadLog::ReadRecords(path const& logFilename)
+	{
+		ifstream fs(logFilename, ifstream::in | ifstream::binary);
+		vector<vector<char>> records;
+		if (not fs.is_open())
+		{
+			return records;
+		}
+
+		for (;;)
+		{
+			char head[FrameHeadSize];
+			if (not fs.read(head, FrameHeadSize))
+			{
+				break;
+			}
+
+			uint32_t size;
+			uint32_t checksum;
+			memcpy(&size, head, sizeof(size));
+			memcpy(&checksum, head + sizeof(size), sizeof(checksum));
+
+			vector<char> record(size);
+			// 崩溃时可能只写了一部分，到这里就结束
+			if (not fs.read(record.data(), size) or Checksum(record.data(), size) != checksum)
+			{
+				break;
+			}
+
+			records.push_back(move(record));
+		}
+
+		return records;
+	}
+
+	WriteAheadLog::WriteAheadLog(path const& logFilename)
+		: _fd(::open(logFilename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644))
+	{
+		if (_fd == -1)
+		{
+			ThrowSystemError("open write ahead log failed");
+		}
+
+		_size = static_cast<size_t>(::lseek(_fd, 0, SEEK_END));
+	}
+
+	WriteAheadLog::~WriteAheadLog()
+	{
+		::close(_fd);
+	}
+
+	uint64_t WriteAheadLog::Append(vector<char> const& record)
+	{
+		uint32_t size = record.size();
+		uint32_t checksum = Checksum(record.data(), record.size());
+
+		lock_guard<mutex> guard(_mutex);
+		_pending.insert(_pending.end(), reinterpret_cast<char const*>(&size), reinterpret_cast<char const*>(&size) + sizeof(size));
+		_pending.insert(_pending.end(), reinterpret_cast<char const*>(&checksum), reinterpret_cast<char const*>(&checksum) + sizeof(checksum));
+		_pending.insert(_pending.end(), record.begin(), record.end());
+		return ++_appendedSeq;
+	}
+
+	void WriteAheadLog::WaitDurable(uint64_t seq)
+	{
+		unique_lock<mutex> lock(_mutex);
+		while (_durableSeq < seq)
+		{
+			if (_failure != nullptr)
+			{
+				rethrow_exception(_failure);
+			}
+
+			if (_syncing)
+			{
+				// 有别的线程在写，等它写完看看自己的记录有没有被带上
+				_durableCond.wait(lock);
+				continue;
+			}
+
+			// 当 leader，把现在攒下的全部写下去
+			_syncing = true;
+			if (_beforeSync)
+			{
+				lock.unlock();
+				_beforeSync();
+				lock.lock();
+			}
+			auto frames = move(_pending);
+			_pending.clear();
+			auto target = _appendedSeq;
+			lock.unlock();
+
+			try
+			{
+				WriteAndSync(frames);
+			}
+			catch (...)
+			{
+				lock.lock();
+				// 截掉可能写了一半的 frame，截不掉的话读的时候校验不过也会停在这里
+				[[maybe_unused]] auto r = ::ftruncate(_fd, _size);
+				// 这批记录丢了，后面的记录不能越过它们落盘，所以之后等着的提交都报这个错
+				_failure = current_exception();
+				_pending.clear();
+				_syncing = false;
+				_durableCond.notify_all();
+				throw;
+			}
+
+			lock.lock();
+			_size += frames.size();
+			++_syncCount;
+			_durableSeq = target;
+			_syncing = false;
+			_durableCond.notify_all();
+		}
+	}
+
+	void WriteAheadLog::Commit(vector<char> const& record)
+	{
+		WaitDurable(Append(record));
+	}
+
+	void WriteAheadLog::Reset()
+	{
+		unique_lock<mutex> lock(_mutex);
+		_durableCond.wait(lock, [this] { return not _syncing; });
+		if (::ftruncate(_fd, 0) == -1)
+		{
+			ThrowSystemError("truncate write ahead log failed");
+		}
+		_size = 0;
+	}
+
+	size_t WriteAheadLog::Size()
+	{
+		lock_guard<mutex> guard(_mutex);
+		return _size;
+	}
+
+	size_t WriteAheadLog::SyncCount()
+	{
+		lock_guard<mutex> guard(_mutex);
+		return _syncCount;
+	}
+
+	void WriteAheadLog::SetBeforeSync(function<void()> callback)
+	{
+		lock_guard<mutex> guard(_mutex);
+		_beforeSync = move(callback);
+	}
+
+	void WriteAheadLog::WriteAndSync(vector<char> const& frames)
+	{
+		for (size_t written = 0; written < frames.size();)
+		{
+			auto n = ::write(_fd, frames.data() + written, frames.size() - written);
+			if (n == -1)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				ThrowSystemError("write ahead log failed");
+			}
+			written += n;
+		}
+
+#ifdef __APPLE__
+		// macOS 上 fsync 不保证写到盘上
+		auto r = ::fcntl(_fd, F_FULLFSYNC);
+#else
+		auto r = ::fdatasync(_fd);
+#endif
+		if (r == -1)
+		{
+			ThrowSystemError("sync write ahead log failed");
+		}
+	}
+}
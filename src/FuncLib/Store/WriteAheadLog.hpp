@@ -0,0 +1,66 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <filesystem>
+#include <condition_variable>
+
+namespace FuncLib::Store
+{
+	using ::std::condition_variable;
+	using ::std::exception_ptr;
+	using ::std::function;
+	using ::std::mutex;
+	using ::std::size_t;
+	using ::std::uint64_t;
+	using ::std::vector;
+	using ::std::filesystem::path;
+
+	/// File 的预写日志，只追加。一条记录落盘后才算提交成功
+	/// 同时等待落盘的多个提交由其中一个线程一起写入并 sync 一次（group commit）
+	/// 写入或 sync 失败后日志不再可用，还没落盘的提交都抛出这次的异常
+	class WriteAheadLog
+	{
+	private:
+		int _fd;
+		mutex _mutex;
+		condition_variable _durableCond;
+		/// 已经加进来还没写入文件的 frame
+		vector<char> _pending;
+		uint64_t _appendedSeq = 0;
+		uint64_t _durableSeq = 0;
+		bool _syncing = false;
+		size_t _size = 0;
+		size_t _syncCount = 0;
+		/// 写失败的异常，不为空时日志不再可用
+		exception_ptr _failure = nullptr;
+		function<void()> _beforeSync;
+
+	public:
+		static path LogPathOf(path const& filename);
+		/// Return records in log file in order, incomplete tail is ignored
+		static vector<vector<char>> ReadRecords(path const& logFilename);
+
+		WriteAheadLog(path const& logFilename);
+		WriteAheadLog(WriteAheadLog const& that) = delete;
+		~WriteAheadLog();
+
+		/// 加到待写的缓冲里，不等落盘. Return the sequence number of record
+		uint64_t Append(vector<char> const& record);
+		/// 等到 seq 以及之前的记录都落盘，没能落盘的话抛异常
+		void WaitDurable(uint64_t seq);
+		void Commit(vector<char> const& record);
+		/// 检查点做完后调用，清空日志
+		void Reset();
+		/// Byte size of durable records
+		size_t Size();
+		size_t SyncCount();
+		/// 当上 leader 后、取走待写的记录前调用，不持有锁。测试里用来等别的提交加进来
+		void SetBeforeSync(function<void()> callback);
+
+	private:
+		void WriteAndSync(vector<char> const& frames);
+	};
+}
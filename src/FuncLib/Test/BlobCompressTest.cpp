@@ -0,0 +1,150 @@
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <filesystem>
+#include "Util.hpp"
+#include "../TestFrame/FlyTest.hpp"
+#include "../TestFrame/Util.hpp"
+#include "../FuncBinaryLib.hpp"
+
+using namespace std;
+using ::Basic::InvalidOperationException;
+using namespace ::Test;
+using namespace FuncLib;
+using namespace FuncLib::Persistence;
+using namespace FuncLib::Store;
+using namespace FuncLib::Test;
+
+/// 模仿机器码：少量的“指令”反复出现，中间夹着随机的立即数
+vector<char> MakeBlob(size_t size)
+{
+	mt19937 gen(42);
+	vector<string> ops;
+	for (auto i = 0; i < 64; ++i)
+	{
+		string op(4 + gen() % 8, '\0');
+		for (auto& c : op)
+		{
+			c = static_cast<char>(gen());
+		}
+		ops.push_back(move(op));
+	}
+
+	vector<char> blob;
+	blob.reserve(size);
+	while (blob.size() < size)
+	{
+		auto& op = ops[gen() % ops.size()];
+		blob.insert(blob.end(), op.begin(), op.end());
+		blob.push_back(static_cast<char>(gen()));
+	}
+	blob.resize(size);
+	return blob;
+}
+
+TESTCASE("BlobCompress test")
+{
+	SECTION("Round trip")
+	{
+		auto check = [&](vector<char> const& data)
+		{
+			auto compressed = CompressBlock(data.data(), data.size());
+			vector<char> back(data.size());
+			DecompressBlock(compressed.data(), compressed.size(), back.data(), back.size());
+			ASSERT(back == data);
+			return compressed.size();
+		};
+
+		check({});
+		check({ 'a' });
+		check(vector<char>(13, 'a'));
+		ASSERT(check(vector<char>(100000, 'a')) < 1000);
+		check(MakeBlob(100000));
+
+		mt19937 gen(1);
+		vector<char> noise(100000);
+		for (auto& c : noise)
+		{
+			c = static_cast<char>(gen());
+		}
+		ASSERT(check(noise) > noise.size());
+	}
+
+	SECTION("Corrupted block")
+	{
+		auto data = MakeBlob(10000);
+		auto compressed = CompressBlock(data.data(), data.size());
+		vector<char> back(data.size());
+		ASSERT_THROW(InvalidOperationException, DecompressBlock(compressed.data(), compressed.size() / 2, back.data(), back.size()));
+		ASSERT_THROW(InvalidOperationException, DecompressBlock(compressed.data(), compressed.size(), back.data(), back.size() - 1));
+	}
+
+	SECTION("Store BinUnit")
+	{
+		using ::std::chrono::duration;
+		using ::std::chrono::steady_clock;
+		using ::std::filesystem::file_size;
+		using Converter = ByteConverter<BinUnit, false>;
+		auto bin = MakeBlob(4 * 1024 * 1024);
+		auto defaultThreshold = Converter::CompressThreshold;
+
+		auto storeAndLoad = [&](char const* filename, size_t threshold)
+		{
+			Converter::CompressThreshold = threshold;
+			pos_label label;
+			{
+				auto file = File::GetFile(filename);
+				auto [l, obj] = file->New(BinUnit{ 1, bin });
+				file->Store(l, obj);
+				label = l;
+			}
+
+			auto start = steady_clock::now();
+			{
+				auto file = File::GetFile(filename);
+				auto obj = file->Read<BinUnit>(label);
+				ASSERT(obj->RefCount == 1);
+				ASSERT(obj->Bin == bin);
+			}
+			duration<double> loadTime = steady_clock::now() - start;
+			return pair{ file_size(filename), loadTime.count() * 1000 };
+		};
+
+		Cleaner c0("blobTestRaw");
+		Cleaner c1("blobTestCompressed");
+		auto [rawSize, rawTime] = storeAndLoad("blobTestRaw", SIZE_MAX);
+		auto [compressedSize, compressedTime] = storeAndLoad("blobTestCompressed", defaultThreshold);
+		Converter::CompressThreshold = defaultThreshold;
+		ASSERT(compressedSize < rawSize);
+		printf("BinUnit of %zu bytes: raw file %zu bytes, load %.2fms; compressed file %zu bytes, load %.2fms\n",
+			bin.size(), static_cast<size_t>(rawSize), rawTime, static_cast<size_t>(compressedSize), compressedTime);
+	}
+
+	SECTION("Small BinUnit stays raw")
+	{
+		Cleaner c("blobTestSmall");
+		auto bin = vector<char>(100, 'a');
+		pos_label label;
+		{
+			auto file = File::GetFile("blobTestSmall");
+			auto [l, obj] = file->New(BinUnit{ 2, bin });
+			file->Store(l, obj);
+			label = l;
+		}
+		auto file = File::GetFile("blobTestSmall");
+		auto obj = file->Read<BinUnit>(label);
+		ASSERT(obj->RefCount == 2);
+		ASSERT(obj->Bin == bin);
+	}
+}
+
+void TestBlobCompress(bool executed)
+{
+	if (executed)
+	{
+		allTest();
+	}
+	_tests_.clear();
+}
@@ -0,0 +1,161 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <filesystem>
+#include "../TestFrame/FlyTest.hpp"
+#include "../TestFrame/Util.hpp"
+#include "../Store/WriteAheadLog.hpp"
+#include "../Compile/CompileCache.hpp"
+#include "../Compile/CompileProcess.hpp"
+
+using namespace std;
+using namespace ::Test;
+using namespace FuncLib::Compile;
+
+TESTCASE("CompileCache test")
+{
+	auto filename = "compileCacheTest";
+
+	SECTION("Hit and miss")
+	{
+		Cleaner c(filename);
+		auto bin = vector<char>(1000, 'a');
+		{
+			auto cache = CompileCache::GetFrom(filename);
+			ASSERT(not cache.Get("int Zero() { return 0; }").has_value());
+			cache.Put("int Zero() { return 0; }", bin);
+			ASSERT(cache.Get("int Zero() { return 0; }").value() == bin);
+			ASSERT(not cache.Get("int One() { return 1; }").has_value());
+
+			auto m = cache.GetMetrics();
+			ASSERT(m.Hits == 1);
+			ASSERT(m.Misses == 2);
+			ASSERT(cache.Count() == 1);
+			ASSERT(cache.Size() == bin.size());
+		}
+
+		auto cache = CompileCache::GetFrom(filename);
+		ASSERT(cache.Get("int Zero() { return 0; }").value() == bin);
+		ASSERT(cache.Size() == bin.size());
+	}
+
+	SECTION("Hit does not write")
+	{
+		using FuncLib::Store::WriteAheadLog;
+		using ::std::filesystem::exists;
+		using ::std::filesystem::file_size;
+
+		Cleaner c(filename);
+		auto cache = CompileCache::GetFrom(filename);
+		cache.Put("a", vector<char>(100, 'a'));
+		auto logFilename = WriteAheadLog::LogPathOf(filename);
+		auto written = [&] { return file_size(filename) + (exists(logFilename) ? file_size(logFilename) : 0); };
+		auto before = written();
+		for (auto i = 0; i < 100; ++i)
+		{
+			ASSERT(cache.Get("a").has_value());
+		}
+		ASSERT(written() == before);
+	}
+
+	SECTION("LRU eviction")
+	{
+		Cleaner c(filename);
+		auto cache = CompileCache::GetFrom(filename, 300);
+		cache.Put("a", vector<char>(100, 'a'));
+		cache.Put("b", vector<char>(100, 'b'));
+		cache.Put("c", vector<char>(100, 'c'));
+		// a 最近用过，淘汰的是 b
+		ASSERT(cache.Get("a").has_value());
+		cache.Put("d", vector<char>(100, 'd'));
+
+		ASSERT(cache.GetMetrics().Evictions == 1);
+		ASSERT(not cache.Get("b").has_value());
+		ASSERT(cache.Get("a").has_value());
+		ASSERT(cache.Get("c").has_value());
+		ASSERT(cache.Get("d").has_value());
+		ASSERT(cache.Size() == 300);
+
+		// 同样的 key 用新的结果
+		cache.Put("a", vector<char>(50, 'e'));
+		ASSERT(cache.Get("a").value() == vector<char>(50, 'e'));
+		ASSERT(cache.Size() == 250);
+
+		cache.Put("too large", vector<char>(301, 'f'));
+		ASSERT(not cache.Get("too large").has_value());
+		ASSERT(cache.Count() == 3);
+	}
+
+	SECTION("Compile with cache")
+	{
+		using ::std::chrono::duration;
+		using ::std::chrono::steady_clock;
+		using ::std::filesystem::exists;
+
+		// 编译要在放着 Unity.hpp 和运行时库的目录下
+		if (exists("Unity.hpp"))
+		{
+			Cleaner c(filename);
+			auto cache = CompileCache::GetFrom(filename);
+			auto compile = [&](string def)
+			{
+				auto start = steady_clock::now();
+				auto [funcs, bin] = Compile(FuncsDefReader(make_unique<istringstream>(move(def))), &cache);
+				duration<double> time = steady_clock::now() - start;
+				ASSERT(funcs.size() == 2);
+				return pair(move(bin), time.count());
+			};
+
+			auto [bin1, missTime] = compile("int Zero()\n{\n	return 0;\n}\nint One()\n{\n	return 1;\n}\n");
+			// 只差在行尾的空白和换行符
+			auto [bin2, hitTime] = compile("int Zero()  \r\n{\r\n	return 0;\r\n}\r\nint One()\n{\n	return 1;\n}\n\n");
+			ASSERT(bin1 == bin2);
+			ASSERT(cache.GetMetrics().Hits == 1);
+			ASSERT(cache.GetMetrics().Misses == 1);
+			printf("compile: miss %.3fs, hit %.4fs\n", missTime, hitTime);
+		}
+		else
+		{
+			printf("Unity.hpp not exist, jump over CompileCacheTest::Compile with cache");
+		}
+	}
+
+	SECTION("Reuse unchanged chunks")
+	{
+		using ::std::filesystem::exists;
+
+		if (exists("Unity.hpp"))
+		{
+			Cleaner c(filename);
+			auto cache = CompileCache::GetFrom(filename);
+			string def;
+			for (auto i = 0; i < 12; ++i)
+			{
+				def.append("int F" + to_string(i) + "()\n{\n	return " + to_string(i) + ";\n}\n");
+			}
+			Compile(FuncsDefReader(make_unique<istringstream>(def)), &cache, 3);
+			ASSERT(cache.GetMetrics().Misses == 4);
+
+			// 只改了最后一份里的函数，前两份的目标文件用缓存里的
+			def.replace(def.find("return 10;"), sizeof("return 10;") - 1, "return 20;");
+			Compile(FuncsDefReader(make_unique<istringstream>(def)), &cache, 3);
+			ASSERT(cache.GetMetrics().Hits == 2);
+			ASSERT(cache.GetMetrics().Misses == 6);
+		}
+		else
+		{
+			printf("Unity.hpp not exist, jump over CompileCacheTest::Reuse unchanged chunks");
+		}
+	}
+}
+
+void TestCompileCache(bool executed)
+{
+	if (executed)
+	{
+		allTest();
+	}
+	_tests_.clear();
+}
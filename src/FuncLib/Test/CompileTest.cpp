@@ -1,4 +1,7 @@
+#include <chrono>
+#include <cstdio>
 #include <fstream>
+#include <sstream>
 #include <filesystem>
 #include "../TestFrame/FlyTest.hpp"
 #include "../Compile/CompileProcess.hpp"
@@ -131,6 +134,194 @@ TESTCASE("CompileTest")
 		}
 	}
 
+	SECTION("Compile error points at user line")
+	{
+		using ::std::filesystem::exists;
+
+		// 生成的代码要 include 它，找不到的话编译器先报这个错
+		if (exists("Unity.hpp"))
+		{
+			auto def = "int Bad()\n"
+					   "{\n"
+					   "	return x;\n"
+					   "}\n";
+			auto reader = FuncsDefReader(make_unique<istringstream>(def));
+			string message;
+			try
+			{
+				Compile(move(reader));
+			}
+			catch (Basic::InvalidOperationException const& e)
+			{
+				message = e.what();
+			}
+			ASSERT(message.find("funcs_def:3:") != string::npos);
+			ASSERT(message.find("temp_compile_") == string::npos);
+		}
+		else
+		{
+			printf("Unity.hpp not exist, jump over CompileTest::Compile error");
+		}
+	}
+
+	SECTION("Malformed code reports compiler error")
+	{
+		using ::std::filesystem::exists;
+
+		ASSERT(ParseFunc("int Bad(\n").empty());
+		ASSERT(ParseFunc("int Bad() return 1; }\n").empty());
+
+		if (exists("Unity.hpp"))
+		{
+			// 括号不配对的解析不了，签名不完整的以前会让解析越界，都要报编译器的错误
+			for (auto def : { "int Bad()\n{\n	return 1;\n",
+							  "int Bad(\n",
+							  "int Good()\n{\n	return 1;\n}\nint Bad() return 1; }\n" })
+			{
+				string message;
+				try
+				{
+					Compile(FuncsDefReader(make_unique<istringstream>(def)));
+				}
+				catch (Basic::InvalidOperationException const& e)
+				{
+					message = e.what();
+				}
+				ASSERT(message.find("compile error") != string::npos);
+				ASSERT(message.find("funcs_def:") != string::npos);
+			}
+		}
+		else
+		{
+			printf("Unity.hpp not exist, jump over CompileTest::Malformed code");
+		}
+	}
+
+	SECTION("Compile in chunks")
+	{
+		using ::std::chrono::duration;
+		using ::std::chrono::steady_clock;
+		using ::std::filesystem::exists;
+
+		if (exists("Unity.hpp"))
+		{
+			// 每个函数调用前一个，跨份的调用要靠声明
+			constexpr auto count = 12;
+			string def = "#include <vector>\n";
+			for (auto i = 0; i < count; ++i)
+			{
+				def.append("// F" + to_string(i) + "\n");
+				def.append("int F" + to_string(i) + "()\n{\n");
+				def.append(i == 0 ? "	return 0;\n" : "	return F" + to_string(i - 1) + "() + 1;\n");
+				def.append("}\n");
+			}
+
+			auto compile = [](string def, size_t jobs)
+			{
+				auto start = steady_clock::now();
+				auto [funcs, bytes] = Compile(FuncsDefReader(make_unique<istringstream>(move(def))), nullptr, jobs);
+				duration<double> time = steady_clock::now() - start;
+				return pair(move(bytes), time.count());
+			};
+			auto [serialBytes, serialTime] = compile(def, 1);
+			auto [bytes, chunksTime] = compile(def, 3);
+			printf("compile %d funcs: one unit %.3fs, 3 chunks %.3fs\n", count, serialTime, chunksTime);
+
+			auto lib = SharedLibrary::OpenInMemory(bytes.data(), bytes.size());
+			ASSERT(lib.has_value());
+			auto r = lib->Invoke<JsonObject(JsonObject)>("F11_wrapper", JsonObject());
+			ASSERT(r.GetNumber() == 11);
+
+			// 两份里的错误都报出来，行号还是用户代码里的
+			auto bad = def;
+			bad.replace(bad.find("return 0;"), sizeof("return 0;") - 1, "return x;");
+			bad.replace(bad.find("return F9() + 1;"), sizeof("return F9() + 1;") - 1, "return y;");
+			string message;
+			try
+			{
+				compile(move(bad), 3);
+			}
+			catch (Basic::InvalidOperationException const& e)
+			{
+				message = e.what();
+			}
+			ASSERT(message.find("funcs_def:5:") != string::npos);
+			ASSERT(message.find("funcs_def:55:") != string::npos);
+
+			// 第一份和最后一份里的函数用同一个 static 变量，不能各有一个
+			string shared = "#include <vector>\nstatic int counter = 0;\n";
+			shared.append("int Increase()\n{\n	return ++counter;\n}\n");
+			for (auto i = 1; i < count - 1; ++i)
+			{
+				shared.append("int F" + to_string(i) + "()\n{\n	return " + to_string(i) + ";\n}\n");
+			}
+			shared.append("int Counter()\n{\n	return counter;\n}\n");
+			auto [sharedBytes, sharedTime] = compile(move(shared), 3);
+			auto sharedLib = SharedLibrary::OpenInMemory(sharedBytes.data(), sharedBytes.size());
+			ASSERT(sharedLib.has_value());
+			sharedLib->Invoke<JsonObject(JsonObject)>("Increase_wrapper", JsonObject());
+			sharedLib->Invoke<JsonObject(JsonObject)>("Increase_wrapper", JsonObject());
+			ASSERT(sharedLib->Invoke<JsonObject(JsonObject)>("Counter_wrapper", JsonObject()).GetNumber() == 2);
+		}
+		else
+		{
+			printf("Unity.hpp not exist, jump over CompileTest::Compile in chunks");
+		}
+	}
+
+	SECTION("Open in memory")
+	{
+		using ::std::chrono::duration;
+		using ::std::chrono::steady_clock;
+
+		auto name = "temp_open_in_memory";
+		auto cppFileName = string(name) + ".cpp";
+		auto soFileName = string(name) + ".so";
+		FilesCleaner c({ cppFileName, soFileName });
+		{
+			ofstream f(cppFileName);
+			// 编译出来的库带着 Json 这些，有几百 KB
+			f << "extern \"C\" char const Padding[512 * 1024] = { 1 };\n";
+			f << "extern \"C\" int Answer() { return 42; }\n";
+		}
+		ASSERT(system(("g++ -shared -fPIC -o " + soFileName + " " + cppFileName).c_str()) == 0);
+		auto bytes = ReadFileBytes(soFileName.c_str());
+
+		// 每次都是新打开的库，模仿调用 100 个不同的函数
+		constexpr auto count = 100;
+		auto measure = [&](auto open)
+		{
+			vector<SharedLibrary> libs;
+			auto start = steady_clock::now();
+			for (auto i = 0; i < count; ++i)
+			{
+				auto& lib = libs.emplace_back(open(i));
+				ASSERT(lib.template Invoke<int()>("Answer") == 42);
+			}
+			duration<double> time = steady_clock::now() - start;
+			return time.count() * 1000 / count;
+		};
+
+		FilesCleaner tempFiles;
+		auto fileTime = measure([&](int i)
+		{
+			auto tempFileName = "./temp_invoke" + to_string(i) + ".so";
+			{
+				ofstream of(tempFileName);
+				of.write(bytes.data(), bytes.size());
+			}
+			tempFiles.Add(tempFileName);
+			return SharedLibrary(tempFileName);
+		});
+		auto memoryTime = measure([&](int)
+		{
+			auto lib = SharedLibrary::OpenInMemory(bytes.data(), bytes.size());
+			ASSERT(lib.has_value());
+			return move(*lib);
+		});
+		printf("cold invoke of %d libraries: temp file %.3fms each, in memory %.3fms each\n", count, fileTime, memoryTime);
+	}
+
 	SECTION("FuncType")
 	{
 		{
@@ -29,7 +29,7 @@ TESTCASE("FileCache test")
 			*n = 20;
 		});
 		ASSERT(1 == *obj);
-		ASSERT(std::holds_alternative<FileCache::SettersOf<T>>(FileCache::Cache<T>[fileId][posLabel]));
+		ASSERT(std::holds_alternative<FileCache::SettersOf<T>>(cache.ShardOf<T>(posLabel).Items[{ cache._fileId, posLabel }]));
 		cache.Add(posLabel, obj);
 
 		ASSERT(cache.Cached<T>(posLabel));
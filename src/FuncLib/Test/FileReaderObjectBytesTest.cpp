@@ -2,10 +2,14 @@
 #include "Util.hpp"
 #include "../TestFrame/FlyTest.hpp"
 #include "../TestFrame/Util.hpp"
+#include "../../Basic/Exception.hpp"
 #include "../Store/FileReader.hpp"
 #include "../Store/ObjectBytes.hpp"
+#include "../Store/BytesReader.hpp"
+#include "../Persistence/ByteConverter.hpp"
 
 using namespace FuncLib::Store;
+using namespace FuncLib::Persistence;
 using namespace std;
 using namespace FuncLib::Test;
 using namespace ::Test;
@@ -40,6 +44,124 @@ TESTCASE("FileReaderObjectBytes test")
 
 		auto zeroBytes = reader.Read<0>();
 		static_assert(zeroBytes.size() == 0);
+
+		auto skipReader = FileReader::MakeReader(nullptr, MakeFilePath(path), 0);
+		skipReader.Skip(6);
+		auto world = skipReader.Read(5);
+		ASSERT(string(reinterpret_cast<char*>(world.data()), world.size()) == "World");
+
+		// 读过了文件末尾不能填 0 当成数据
+		auto pastEndReader = FileReader::MakeReader(nullptr, MakeFilePath(path), s.size() - 2);
+		ASSERT_THROW(Basic::InvalidOperationException, pastEndReader.Read(4));
+		auto missingReader = FileReader::MakeReader(nullptr, MakeFilePath("notExistFile"), 0);
+		ASSERT_THROW(Basic::InvalidOperationException, missingReader.Read(1));
+
+		PositionalFile source(MakeFilePath(path));
+		array<byte, 4> sparse;
+		source.Read(s.size() - 2, sparse.data(), sparse.size(), true);
+		ASSERT(static_cast<char>(sparse[1]) == 'd');
+		ASSERT(sparse[2] == byte(0) and sparse[3] == byte(0));
+	}
+
+	SECTION("Bulk container")
+	{
+		vector<int> ints{ 1, 2, 3, 4, 5 };
+		vector<char> chars(100000, 'a');
+		vector<string> strs{ "Hello", "", "World" };
+		auto writer = ObjectBytes(0);
+		ByteConverter<vector<int>>::WriteDown(ints, &writer);
+		// 整块写入的布局和逐个写入一样：个数后面跟着元素
+		ASSERT(writer.Size() == sizeof(size_t) + ints.size() * sizeof(int));
+		ByteConverter<vector<char>>::WriteDown(chars, &writer);
+		ByteConverter<vector<string>>::WriteDown(strs, &writer);
+		ByteConverter<string>::WriteDown(s, &writer);
+
+		vector<char> bytes;
+		writer.WriteIn([&](vector<char> const* b) { bytes = *b; });
+		auto reader = BytesReader(bytes.data(), bytes.size());
+		ASSERT(ByteConverter<vector<int>>::ReadOut(&reader) == ints);
+		ASSERT(ByteConverter<vector<char>>::ReadOut(&reader) == chars);
+		ASSERT(ByteConverter<vector<string>>::ReadOut(&reader) == strs);
+		ASSERT(ByteConverter<string>::ReadOut(&reader) == s);
+		ASSERT(reader.AtEnd());
+	}
+
+	SECTION("Varint")
+	{
+		auto writer = ObjectBytes(0);
+		writer.Compact = true;
+		vector<long> signedInts{ 0, 1, -1, 63, -64, 64, INT32_MIN, INT64_MAX, INT64_MIN };
+		vector<size_t> unsignedInts{ 0, 127, 128, 16383, 16384, SIZE_MAX };
+		for (auto i : signedInts)
+		{
+			CompactInt<long>::WriteDown(i, &writer);
+		}
+		for (auto i : unsignedInts)
+		{
+			CompactInt<size_t>::WriteDown(i, &writer);
+		}
+
+		vector<char> bytes;
+		writer.WriteIn([&](vector<char> const* b) { bytes = *b; });
+		auto reader = BytesReader(bytes.data(), bytes.size());
+		reader.Compact = true;
+		for (auto i : signedInts)
+		{
+			ASSERT(CompactInt<long>::ReadOut(&reader) == i);
+		}
+		for (auto i : unsignedInts)
+		{
+			ASSERT(CompactInt<size_t>::ReadOut(&reader) == i);
+		}
+		ASSERT(reader.AtEnd());
+	}
+
+	SECTION("Compact length")
+	{
+		vector<string> strs{ "a", "bc", string(200, 'd') };
+		auto compact = ObjectBytes(0);
+		compact.Compact = true;
+		ByteConverter<vector<string>>::WriteDown(strs, &compact);
+		// 个数 1 字节，前两个长度各 1 字节，200 要 2 字节
+		ASSERT(compact.Size() == 1 + (1 + 1) + (1 + 2) + (2 + 200));
+		auto fixed = ObjectBytes(0);
+		ByteConverter<vector<string>>::WriteDown(strs, &fixed);
+		ASSERT(fixed.Size() == 8 * 4 + 1 + 2 + 200);
+
+		vector<char> bytes;
+		compact.WriteIn([&](vector<char> const* b) { bytes = *b; });
+		auto reader = BytesReader(bytes.data(), bytes.size());
+		reader.Compact = true;
+		ASSERT(ByteConverter<vector<string>>::ReadOut(&reader) == strs);
+		ASSERT(reader.AtEnd());
+	}
+
+	SECTION("BytesPool")
+	{
+		BytesPool pool;
+		auto writer = ObjectBytes(0);
+		writer.Pool = &pool;
+		writer.Reserve(100);
+		writer.Add(s.c_str(), s.size());
+		auto data = [&]
+		{
+			char const* p;
+			writer.WriteIn([&](vector<char> const* b) { p = b->data(); });
+			return p;
+		};
+		auto buffer = data();
+		writer.GiveBufferTo(&pool);
+		ASSERT(pool.Count() == 1);
+
+		auto other = ObjectBytes(1);
+		other.Pool = &pool;
+		other.Reserve(10);
+		ASSERT(pool.Count() == 0);
+		ASSERT(other.Size() == 0);
+		other.Add(s.c_str(), s.size());
+		writer = move(other);
+		// 还回去的缓冲区被下一个拿去用了
+		ASSERT(data() == buffer);
 	}
 }
 
@@ -3,6 +3,13 @@
 #include <vector>
 #include <cstddef>
 #include <cstdio>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <optional>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Util.hpp"
 #include "../TestFrame/FlyTest.hpp"
 #include "../TestFrame/Util.hpp"
@@ -17,6 +24,37 @@ using namespace FuncLib::Persistence;
 using namespace FuncLib::Store;
 using namespace FuncLib::Test;
 
+namespace
+{
+	/// 让文件的页缓存失效，macOS 上没有对应的做法，什么也不做
+	void DropPageCache(char const* filename)
+	{
+#ifndef __APPLE__
+		auto fd = ::open(filename, O_RDONLY);
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		::close(fd);
+#endif
+	}
+
+	/// 进程从设备读了多少字节，只有 Linux 的 /proc/self/io 里有
+	optional<size_t> DeviceReadBytes()
+	{
+#ifndef __APPLE__
+		ifstream io("/proc/self/io");
+		string key;
+		size_t value;
+		while (io >> key >> value)
+		{
+			if (key == "read_bytes:")
+			{
+				return value;
+			}
+		}
+#endif
+		return nullopt;
+	}
+}
+
 TESTCASE("File test")
 {
 	auto filename = "fileTest";
@@ -141,6 +179,577 @@ TESTCASE("File test")
 		file->Store(label, treeObj);
 	}
 
+	SECTION("Compact")
+	{
+		using ::std::chrono::milliseconds;
+		using ::std::filesystem::file_size;
+		constexpr auto count = 20;
+		auto valueOf = [](int i) { return string(i * 10, 'a' + i); };
+		// 一次整理完时一条日志里有先挪开再挪进来的
+		for (auto slice : { 0, 1000 })
+		{
+			Cleaner c(filename);
+			{
+				auto file = File::GetFile(filename);
+				// 倒着存，整理时要先把占着位置的对象挪开
+				for (auto i = count; i > 0; --i)
+				{
+					auto [label, obj] = file->New(i, valueOf(i));
+					file->Store(label, obj);
+				}
+
+				for (auto i = 1; i <= count; i += 2)
+				{
+					file->Delete(i, file->Read<string>(i));
+				}
+			}
+
+			auto sizeBeforeCompact = file_size(filename);
+			{
+				auto file = File::GetFile(filename);
+				while (not file->Compact(milliseconds(slice)))
+				{ }
+
+				ASSERT(file_size(filename) < sizeBeforeCompact);
+				for (auto i = 2; i <= count; i += 2)
+				{
+					ASSERT(*file->Read<string>(i) == valueOf(i));
+				}
+			}
+
+			{
+				auto file = File::GetFile(filename);
+				for (auto i = 2; i <= count; i += 2)
+				{
+					ASSERT(*file->Read<string>(i) == valueOf(i));
+				}
+			}
+		}
+	}
+
+	SECTION("Store dirty objects only")
+	{
+		using T = string;
+		using Tree = Btree<4, T, T, StorePlace::Memory>;
+		using DiskTree = Btree<4, T, T, StorePlace::Disk>;
+		Cleaner c(filename);
+		constexpr pos_label l = 300;
+		auto n = 50;
+		auto newValueOf = [](int i) { return to_string(i) + "new"; };
+		{
+			auto file = File::GetFile(filename);
+			Tree b;
+			for (auto i = 0; i < n; ++i)
+			{
+				b.Add({ to_string(i), to_string(i) });
+			}
+
+			auto t = TypeConverter<Tree>::ConvertFrom(b, file.get());
+			auto [label, treeObj] = file->New(l, move(t));
+			file->Store(label, treeObj);
+			ASSERT(file->_dirtyObjects.empty());
+		}
+
+		{
+			auto file = File::GetFile(filename);
+			auto t = file->Read<DiskTree>(l);
+			for (auto i = 0; i < n; ++i)
+			{
+				ASSERT(t->ContainsKey(to_string(i)));
+			}
+			// 只读不会标记
+			ASSERT(file->_dirtyObjects.empty());
+
+			for (auto i = 0; i < n; i += 10)
+			{
+				auto k = to_string(i);
+				UniqueDiskRef<T> vs(MakeUnique(newValueOf(i), file.get()));
+				t->ModifyValue(k, move(vs));
+			}
+			ASSERT(not file->_dirtyObjects.empty());
+			file->Store(l, t);
+			ASSERT(file->_dirtyObjects.empty());
+		}
+
+		{
+			auto file = File::GetFile(filename);
+			auto t = file->Read<DiskTree>(l);
+			ASSERT(t->Count() == n);
+			for (auto i = 0; i < n; ++i)
+			{
+				auto k = to_string(i);
+				ASSERT(t->GetValue(k) == (i % 10 == 0 ? newValueOf(i) : k));
+			}
+		}
+	}
+
+	SECTION("Paged metadata")
+	{
+		Cleaner c(filename);
+		constexpr auto count = 1000;
+		{
+			auto file = File::GetFile(filename);
+			for (auto i = 1; i <= count; ++i)
+			{
+				auto [label, obj] = file->New(i, to_string(i));
+				file->Store(label, obj);
+			}
+			ASSERT(file->_allocator.LabelPageCount() == count / LabelTable::EntryCountPerPage + 1);
+		}
+
+		{
+			auto file = File::GetFile(filename);
+			// 打开时只读头部
+			ASSERT(file->_allocator._labelTable._pages.empty());
+			ASSERT(not file->_objRelationTree.has_value());
+
+			ASSERT(*file->Read<string>(count) == to_string(count));
+			ASSERT(file->_allocator._labelTable._pages.size() == 1);
+			ASSERT(not file->_objRelationTree.has_value());
+
+			auto obj = file->Read<string>(1);
+			*obj = "changed";
+			file->Store(1, obj);
+		}
+
+		{
+			auto file = File::GetFile(filename);
+			ASSERT(*file->Read<string>(1) == "changed");
+			for (auto i = 2; i <= count; ++i)
+			{
+				ASSERT(*file->Read<string>(i) == to_string(i));
+			}
+		}
+	}
+
+	SECTION("Grow metadata")
+	{
+		Cleaner c(filename);
+		auto growFilename = string(filename) + ".grow";
+		// 上次崩溃留下的临时文件会被覆盖
+		{
+			ofstream stale(growFilename);
+			stale << "stale";
+		}
+		constexpr auto count = 5000;
+		pos_int initialSize;
+		{
+			auto file = File::GetFile(filename);
+			initialSize = file->_metadataSize;
+			for (auto i = 1; i <= count; ++i)
+			{
+				auto [label, obj] = file->New(i, to_string(i));
+				file->Store(label, obj);
+			}
+		}
+
+		ASSERT(not filesystem::exists(growFilename));
+		{
+			auto file = File::GetFile(filename);
+			ASSERT(file->_metadataSize > initialSize);
+			for (auto i = 1; i <= count; ++i)
+			{
+				ASSERT(*file->Read<string>(i) == to_string(i));
+			}
+		}
+	}
+
+	SECTION("Concurrent read")
+	{
+		Cleaner c(filename);
+		constexpr auto count = 300;
+		constexpr auto threadCount = 16;
+		auto valueOf = [](int i) { return string(i % 50 + 1, 'a' + i % 26); };
+		{
+			auto file = File::GetFile(filename);
+			for (auto i = 1; i <= count; ++i)
+			{
+				auto [label, obj] = file->New(i, valueOf(i));
+				file->Store(label, obj);
+			}
+		}
+
+		auto file = File::GetFile(filename);
+		vector<vector<shared_ptr<string>>> results(threadCount, vector<shared_ptr<string>>(count + 1));
+		atomic<bool> allRight = true;
+		{
+			vector<thread> readers;
+			for (auto t = 0; t < threadCount; ++t)
+			{
+				readers.emplace_back([&, t]
+				{
+					for (auto round = 0; round < 3; ++round)
+					{
+						// 每个线程从不同的地方开始读，让它们同时读到没缓存的对象
+						for (auto j = 0; j < count; ++j)
+						{
+							auto i = (j + t * 7) % count + 1;
+							auto obj = file->Read<string>(i);
+							if (*obj != valueOf(i))
+							{
+								allRight = false;
+							}
+							results[t][i] = obj;
+
+							// 非 const 的访问会同时标记改动
+							OwnerLessDiskPtr<string> ptr(DiskPos<string>(file.get(), i), nullptr);
+							if (ptr->size() != obj->size() or static_cast<string*>(ptr) != obj.get())
+							{
+								allRight = false;
+							}
+						}
+					}
+				});
+			}
+
+			for (auto& r : readers)
+			{
+				r.join();
+			}
+		}
+
+		ASSERT(allRight);
+		ASSERT(file->_dirtyObjects.size() == count);
+		// 同一个对象只读了一次，大家拿到的是同一个
+		for (auto i = 1; i <= count; ++i)
+		{
+			for (auto t = 1; t < threadCount; ++t)
+			{
+				ASSERT(results[t][i] == results[0][i]);
+			}
+		}
+
+		// 标记改动不持有对象，对象释放了标记在下次存储时去掉
+		ASSERT(results[0][1].use_count() == threadCount + 1);
+		file->_cache.Remove<string>(1);
+		for (auto& r : results)
+		{
+			r[1].reset();
+		}
+		auto [l, obj] = file->New(string("new"));
+		file->Store(l, obj);
+		ASSERT(not file->_dirtyObjects.contains(1));
+		ASSERT(file->_dirtyObjects.size() == count - 1);
+	}
+
+	SECTION("Async read started before metadata grows")
+	{
+		Cleaner c(filename);
+		pos_label label;
+		{
+			auto file = File::GetFile(filename);
+			auto [l, obj] = file->New(string(300, 'a'));
+			file->Store(l, obj);
+			label = l;
+		}
+
+		auto file = File::GetFile(filename);
+		// 读完就在这个线程里恢复
+		auto awaiter = file->ReadAsync<string>(label, [](function<void()> task) { task(); });
+		// 位置按原来的元信息区算好了，读之前文件被换掉
+		file->GrowMetadataTo(file->_metadataSize * 2);
+		struct Handle
+		{
+			void resume() { }
+		};
+		awaiter.await_suspend(Handle());
+		ASSERT(*awaiter.await_resume() == string(300, 'a'));
+	}
+
+	SECTION("Prefetch during scan")
+	{
+		using ::std::chrono::duration;
+		using ::std::chrono::steady_clock;
+		using ::std::filesystem::file_size;
+		using T = string;
+		using Tree = Btree<4, T, T, StorePlace::Memory>;
+		using DiskTree = Btree<4, T, T, StorePlace::Disk>;
+		Cleaner c(filename);
+		constexpr auto count = 2000;
+		pos_label treeLabel;
+		{
+			auto file = File::GetFile(filename);
+			Tree b;
+			for (auto i = 0; i < count; ++i)
+			{
+				b.Add({ to_string(i), to_string(i) });
+			}
+			auto t = TypeConverter<Tree>::ConvertFrom(b, file.get());
+			auto [label, treeObj] = file->New(move(t));
+			file->Store(label, treeObj);
+			treeLabel = label;
+		}
+
+		duration<double> scanTime;
+		{
+			auto file = File::GetFile(filename);
+			auto t = file->Read<DiskTree>(treeLabel);
+			auto start = steady_clock::now();
+			auto g = t->GetStoredPairEnumerator();
+			auto n = 0;
+			auto ordered = true;
+			string last;
+			while (g.MoveNext())
+			{
+				auto const* p = g.Current();
+				string k = p->first;
+				ordered = ordered and last < k;
+				last = move(k);
+				++n;
+			}
+			scanTime = steady_clock::now() - start;
+			ASSERT(n == count);
+			ASSERT(ordered);
+			// 只读的扫描不会标记改动
+			ASSERT(file->_dirtyObjects.empty());
+		}
+
+		auto start = steady_clock::now();
+		{
+			ifstream f(filename, ifstream::binary);
+			vector<char> content(file_size(filename));
+			f.read(content.data(), content.size());
+		}
+		duration<double> rawTime = steady_clock::now() - start;
+		printf("full scan of %d keys: %.2fms, sequential read of file: %.2fms\n",
+			count, scanTime.count() * 1000, rawTime.count() * 1000);
+	}
+
+	SECTION("Format version")
+	{
+		Cleaner c(filename);
+		auto strs = vector<string>{ "Hello", "World" };
+		auto fixedFilename = "fileTestFixed";
+		Cleaner c1(fixedFilename);
+		pos_label label;
+		pos_label fixedLabel;
+		{
+			auto file = File::GetFile(filename);
+			ASSERT(file->_formatVersion == CurrentFormatVersion);
+			auto [l, obj] = file->New(strs);
+			file->Store(l, obj);
+			label = l;
+
+			// 模仿以前版本建的文件
+			auto fixedFile = File::GetFile(fixedFilename);
+			fixedFile->_formatVersion = FormatVersion::Fixed;
+			auto [fl, fixedObj] = fixedFile->New(strs);
+			fixedFile->Store(fl, fixedObj);
+			fixedLabel = fl;
+			ASSERT(file->_allocator.GetAllocatedSize(label) < fixedFile->_allocator.GetAllocatedSize(fixedLabel));
+		}
+
+		auto file = File::GetFile(filename);
+		ASSERT(file->_formatVersion == CurrentFormatVersion);
+		ASSERT(*file->Read<vector<string>>(label) == strs);
+		auto fixedFile = File::GetFile(fixedFilename);
+		ASSERT(fixedFile->_formatVersion == FormatVersion::Fixed);
+		ASSERT(*fixedFile->Read<vector<string>>(fixedLabel) == strs);
+	}
+
+	SECTION("Reuse store buffers")
+	{
+		Cleaner c(filename);
+		auto file = File::GetFile(filename);
+		auto [label, obj] = file->New(string(100, 'a'));
+		file->Store(label, obj);
+		auto count = file->_bytesPool.Count();
+		ASSERT(count > 0);
+		for (auto i = 0; i < 10; ++i)
+		{
+			obj->push_back('b');
+			file->Store(label, obj);
+			ASSERT(file->_bytesPool.Count() == count);
+		}
+	}
+
+	SECTION("Page aligned extents")
+	{
+		using ::std::filesystem::file_size;
+		Cleaner c(filename);
+		constexpr auto count = 500;
+		auto valueOf = [](int i) { return string(1500 + i * 37 % 2000, 'a' + i % 26); };
+		auto pagesOf = [](pos_int pos, size_t size) { return (pos + size - 1) / DiskBlockSize - pos / DiskBlockSize + 1; };
+		vector<pos_label> labels;
+		{
+			auto file = File::GetFile(filename);
+			for (auto i = 0; i < count; ++i)
+			{
+				auto [l, obj] = file->New(valueOf(i));
+				file->Store(l, obj);
+				labels.push_back(l);
+			}
+
+			for (auto i = 0; i < count; i += 3)
+			{
+				file->Delete(labels[i], file->Read<string>(labels[i]));
+			}
+			while (not file->Compact(milliseconds(0)))
+			{ }
+
+			// 一样的对象紧挨着放时平均每个要读几页
+			size_t packedPages = 0;
+			size_t pages = 0;
+			pos_int packedPos = 0;
+			auto usings = file->_allocator.GetUsingLabelsSortedByPos();
+			for (auto [pos, l] : usings)
+			{
+				auto size = file->_allocator.GetAllocatedSize(l);
+				packedPages += pagesOf(packedPos, size);
+				packedPos += size;
+				pages += pagesOf(pos, size);
+				ASSERT(pagesOf(pos, size) == 1);
+			}
+			printf("node-sized objects: %.2f pages per read when packed, %.2f pages when page aligned\n",
+				static_cast<double>(packedPages) / usings.size(), static_cast<double>(pages) / usings.size());
+		}
+
+		// 冷缓存下每次查找从设备读了多少，平台不支持就不统计
+		DropPageCache(filename);
+		auto file = File::GetFile(filename);
+		auto before = DeviceReadBytes();
+		size_t lookups = 0;
+		for (auto i = 1; i < count; i += 7)
+		{
+			if (i % 3 != 0)
+			{
+				ASSERT(*file->Read<string>(labels[i]) == valueOf(i));
+				++lookups;
+			}
+		}
+		if (auto after = DeviceReadBytes(); before.has_value() and after.has_value())
+		{
+			printf("cold cache: %.2f device bytes per lookup\n", static_cast<double>(*after - *before) / lookups);
+		}
+
+		// 大对象绕过页缓存读写，前后的对象不受影响
+		auto [small, smallObj] = file->New(string(100, 's'));
+		file->Store(small, smallObj);
+		auto [large, largeObj] = file->New(string(LargeObjectSize + 100, 'l'));
+		file->Store(large, largeObj);
+		ASSERT(file->_allocator.GetConcretePos(large) % DiskBlockSize == 0);
+		auto [after, afterObj] = file->New(string(100, 't'));
+		file->Store(after, afterObj);
+		largeObj->assign(LargeObjectSize + 50, 'm');
+		file->Store(large, largeObj);
+		file.reset();
+		smallObj.reset();
+		largeObj.reset();
+		afterObj.reset();
+
+		file = File::GetFile(filename);
+		ASSERT(*file->Read<string>(small) == string(100, 's'));
+		ASSERT(*file->Read<string>(large) == string(LargeObjectSize + 50, 'm'));
+		ASSERT(*file->Read<string>(after) == string(100, 't'));
+	}
+
+	SECTION("Page aligned extents in legacy file")
+	{
+		Cleaner c(filename);
+		pos_label large;
+		{
+			auto file = File::GetFile(filename);
+			// 以前的文件元信息区按 1024 增长，数据区不在页边界上
+			file->GrowMetadataTo(file->_metadataSize + 1024);
+			ASSERT(file->_metadataSize % DiskBlockSize != 0);
+			auto [l, obj] = file->New(string(LargeObjectSize + 100, 'l'));
+			file->Store(l, obj);
+			large = l;
+		}
+
+		auto file = File::GetFile(filename);
+		ASSERT(file->_metadataSize % DiskBlockSize == 0);
+		ASSERT(*file->Read<string>(large) == string(LargeObjectSize + 100, 'l'));
+		auto [l, obj] = file->New(string(LargeObjectSize + 200, 'm'));
+		file->Store(l, obj);
+		ASSERT((file->_allocator.GetConcretePos(l) + file->_metadataSize) % DiskBlockSize == 0);
+		ASSERT((file->_allocator.GetConcretePos(large) + file->_metadataSize) % DiskBlockSize == 0);
+	}
+
+	SECTION("Online backup")
+	{
+		Cleaner c(filename);
+		auto backupFilename = "fileTestBackup";
+		Cleaner c1(backupFilename);
+		constexpr auto count = 20;
+		constexpr size_t size = 200 * 1024;
+		vector<pair<pos_label, shared_ptr<string>>> objs;
+		auto file = File::GetFile(filename);
+		for (auto i = 0; i < count; ++i)
+		{
+			auto [l, obj] = file->New(string(size, 'a' + i));
+			file->Store(l, obj);
+			objs.push_back({ l, obj });
+		}
+
+		// 限速让复制要做一段时间，期间接着改
+		auto finished = file->Backup(backupFilename, 20 * 1024 * 1024);
+		ASSERT_THROW(Basic::InvalidOperationException, file->Backup(backupFilename));
+		ASSERT(not file->Compact(milliseconds(10)));
+		auto [label, obj] = objs.front();
+		auto oldPos = file->_allocator.GetConcretePos(label);
+		for (auto& [l, o] : objs)
+		{
+			o->assign(size, 'z');
+			file->Store(l, o);
+		}
+		ASSERT(not file->_snapshot->Done());
+		ASSERT(file->_allocator.GetConcretePos(label) != oldPos);
+		auto [newLabel, newObj] = file->New(string("new"));
+		file->Store(newLabel, newObj);
+		finished.get();
+
+		// 备份完原位写
+		auto pos = file->_allocator.GetConcretePos(label);
+		obj->assign(size, 'y');
+		file->Store(label, obj);
+		ASSERT(file->_allocator.GetConcretePos(label) == pos);
+
+		{
+			auto backup = File::GetFile(backupFilename);
+			for (auto i = 0; i < count; ++i)
+			{
+				ASSERT(*backup->Read<string>(objs[i].first) == string(size, 'a' + i));
+			}
+			ASSERT(not backup->_allocator.Ready(newLabel));
+		}
+		ASSERT(*file->Read<string>(objs.back().first) == string(size, 'z'));
+		ASSERT(*file->Read<string>(label) == string(size, 'y'));
+		while (not file->Compact(milliseconds(10)))
+		{ }
+		ASSERT(*file->Read<string>(label) == string(size, 'y'));
+	}
+
+	SECTION("Cancel backup")
+	{
+		using ::std::filesystem::exists;
+		Cleaner c(filename);
+		auto backupFilename = "fileTestBackup";
+		Cleaner c1(backupFilename);
+		constexpr auto count = 20;
+		constexpr size_t size = 200 * 1024;
+		auto file = File::GetFile(filename);
+		vector<pos_label> labels;
+		for (auto i = 0; i < count; ++i)
+		{
+			auto [l, obj] = file->New(string(size, 'a' + i));
+			file->Store(l, obj);
+			labels.push_back(l);
+		}
+
+		// 限速很慢，取消时还远没复制完
+		auto finished = file->Backup(backupFilename, 1024 * 1024);
+		file->CancelBackup();
+		ASSERT_THROW(Basic::InvalidOperationException, finished.get());
+		ASSERT(not exists(backupFilename));
+		ASSERT(not exists(string(backupFilename) + ".part"));
+
+		// 取消后可以重新备份
+		file->Backup(backupFilename).get();
+		auto backup = File::GetFile(backupFilename);
+		ASSERT(*backup->Read<string>(labels.back()) == string(size, 'a' + count - 1));
+	}
+
 	SECTION("Store and Read")
 	{
 		using T = string;
@@ -0,0 +1,95 @@
+#include <string>
+#include <vector>
+#include "../TestFrame/FlyTest.hpp"
+#include "../FuncTable.hpp"
+
+using namespace std;
+using namespace FuncLib;
+
+TESTCASE("FuncTable test")
+{
+	using Table = FuncTable<int>;
+
+	SECTION("Exact equality")
+	{
+		auto f = FuncType("int", "Add", { "int", "int" }, { "Math" });
+		ASSERT(f == FuncType("int", "Add", { "int", "int" }, { "Math" }));
+		ASSERT(not (f == FuncType("int", "Add", { "int" }, { "Math" })));
+		ASSERT(not (f == FuncType("int", "Add", { "int", "int" }, { "Basic" })));
+		ASSERT(not (f == FuncType("long", "Add", { "int", "int" }, { "Math" })));
+		// 和 ToKey 一致：没有包名的就是 Global 包
+		ASSERT(FuncType("int", "Zero", {}) == FuncType("int", "Zero", {}, { "Global" }));
+		ASSERT(FuncType("int", "Zero", {}).Hash() == FuncType("int", "Zero", {}, { "Global" }).Hash());
+		ASSERT(f.Hash() != FuncType("int", "Add", { "int" }, { "Math" }).Hash());
+	}
+
+	SECTION("Add, find and remove")
+	{
+		Table table;
+		auto n = 1000;
+		vector<Table::FuncId> ids;
+		for (auto i = 0; i < n; ++i)
+		{
+			ids.push_back(table.Add(FuncType("int", "F" + to_string(i), {}, { "Basic" }), i));
+		}
+		ASSERT(table.Size() == n);
+
+		for (auto i = 0; i < n; ++i)
+		{
+			auto id = table.Find(FuncType("int", "F" + to_string(i), {}, { "Basic" }));
+			ASSERT(id == ids[i]);
+			ASSERT(table[id] == i);
+			ASSERT(not table.Contains(FuncType("int", "F" + to_string(i), {}, { "Math" })));
+		}
+
+		for (auto i = 0; i < n; i += 2)
+		{
+			table.Remove(ids[i]);
+		}
+		ASSERT(table.Size() == n / 2);
+
+		for (auto i = 0; i < n; ++i)
+		{
+			auto found = table.Contains(FuncType("int", "F" + to_string(i), {}, { "Basic" }));
+			ASSERT(found == (i % 2 == 1));
+		}
+
+		// 删掉后留下的墓碑和空出来的 id 都能再用
+		for (auto i = 0; i < n; i += 2)
+		{
+			table.Add(FuncType("int", "G" + to_string(i), {}, { "Basic" }), -i);
+		}
+		ASSERT(table.Size() == n);
+		for (auto i = 0; i < n; i += 2)
+		{
+			auto id = table.Find(FuncType("int", "G" + to_string(i), {}, { "Basic" }));
+			ASSERT(id != Table::NoId);
+			ASSERT(table[id] == -i);
+		}
+	}
+
+	SECTION("Rekey keeps id and value")
+	{
+		Table table;
+		auto f = FuncType("int", "One", {}, { "Basic" });
+		auto id = table.Add(f, 1);
+		table.Add(FuncType("int", "Two", {}, { "Basic" }), 2);
+
+		auto g = f;
+		g.Package = { "Math" };
+		table.Rekey(id, g);
+		ASSERT(not table.Contains(f));
+		ASSERT(table.Find(g) == id);
+		ASSERT(table[id] == 1);
+		ASSERT(table.Size() == 2);
+	}
+}
+
+void TestFuncTable(bool executed)
+{
+	if (executed)
+	{
+		allTest();
+	}
+	_tests_.clear();
+}
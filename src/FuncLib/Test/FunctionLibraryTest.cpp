@@ -2,6 +2,7 @@
 #include "../TestFrame/Util.hpp"
 #include "Util.hpp"
 #include <sstream>
+#include <filesystem>
 #define private public
 #include "../FunctionLibrary.hpp"
 
@@ -85,6 +86,31 @@ TESTCASE("FunctionLibrary Test")
 		}
 	}
 
+	SECTION("Resolved func is cached")
+	{
+		auto lib = FunctionLibrary::GetFrom(".");
+		auto f = FuncType("int", "Two", {}, {"Basic"});
+		auto id = lib._funcs.Find(f);
+		ASSERT(id != FuncTable<ResolvedFuncEntry>::NoId);
+		ASSERT(lib._funcs[id].Func == nullptr);
+		auto invoker = lib.GetInvoker(f, JsonObject());
+		auto func = lib._funcs[id].Func;
+		ASSERT(func != nullptr);
+
+		for (auto i = 0; i < 3; ++i)
+		{
+			auto r = lib.Invoke(f, JsonObject());
+			ASSERT(r.GetNumber() == 2);
+		}
+		ASSERT(lib._funcs.Find(f) == id);
+		ASSERT(lib._funcs[id].Func == func);
+
+		lib.Remove(f);
+		ASSERT(not lib._funcs.Contains(f));
+		// 删掉之后已经拿到的 invoker 仍然持有库，可以调用
+		ASSERT(invoker().GetNumber() == 2);
+	}
+
 	SECTION("ModifyPackage")
 	{
 		auto lib = FunctionLibrary::GetFrom(".");
@@ -93,11 +119,106 @@ TESTCASE("FunctionLibrary Test")
 		lib.ModifyPackageOf(f, { "Math" });
 		ASSERT(lib.Contains(FuncType("int", "One", {}, {"Math"})));
 	}
+
+	SECTION("Warm up hot libraries")
+	{
+		using ::std::chrono::milliseconds;
+
+		auto three = FuncType("int", "Three", {}, {"Basic"});
+		{
+			auto lib = FunctionLibrary::GetFrom(".");
+			for (auto i = 0; i < 3; ++i)
+			{
+				lib.Invoke(three, JsonObject());
+			}
+			lib.Invoke(FuncType("int", "Four", {}, {"Basic"}), JsonObject());
+		}
+
+		// 调用次数在析构时存下，重新打开后按次数从多到少加载
+		auto lib = FunctionLibrary::GetFrom(".");
+		ASSERT(lib.LoadedLibCount() == 0);
+		WarmUpBudget budget;
+		budget.MaxLibs = 1;
+		while (not lib.WarmUp(budget, milliseconds(5)));
+		ASSERT(lib.LoadedLibCount() == 1);
+		ASSERT(lib._binLib._cache.contains(lib._funcs[lib._funcs.Find(three)].Label));
+
+		budget.MaxLibs = 64;
+		budget.MaxBytes = 0;
+		while (not lib.WarmUp(budget, milliseconds(5)));
+		ASSERT(lib.LoadedLibCount() == 1);
+	}
+
+	SECTION("Evict loaded libraries")
+	{
+		using ::std::chrono::milliseconds;
+
+		auto lib = FunctionLibrary::GetFrom(".");
+		LoadedLibLimit limit;
+		limit.MaxLibs = 2;
+		lib.SetLoadedLibLimit(limit);
+		auto five = FuncType("int", "Five", {}, {"Basic"});
+		auto six = FuncType("int", "Six", {}, {"Basic"});
+		auto seven = FuncType("int", "Seven", {}, {"Basic"});
+
+		// invoker 持有 Five 的库，最久没用也不卸载，卸载的是 Six
+		auto invoker = lib.GetInvoker(five, JsonObject());
+		lib.Invoke(six, JsonObject());
+		lib.Invoke(seven, JsonObject());
+		ASSERT(lib.LoadedLibCount() == 2);
+		ASSERT(lib._binLib._cache.contains(lib._funcs[lib._funcs.Find(five)].Label));
+		ASSERT(lib.LoadedLibMetrics().Evictions == 1);
+		ASSERT(invoker().GetNumber() == 5);
+
+		// 卸载过的重新加载
+		ASSERT(lib.Invoke(six, JsonObject()).GetNumber() == 6);
+		ASSERT(lib.LoadedLibMetrics().Evictions == 2);
+
+		limit.MaxIdle = milliseconds(1);
+		this_thread::sleep_for(milliseconds(5));
+		lib.SetLoadedLibLimit(limit);
+		ASSERT(lib.LoadedLibCount() == 1);
+		ASSERT(lib.LoadedLibMetrics().Evictions == 3);
+
+		// 调用已经加载的库不卸载闲置的，加载别的库时才卸载
+		limit.MaxLibs = 3;
+		limit.MaxIdle = milliseconds(20);
+		lib.SetLoadedLibLimit(limit);
+		lib.Invoke(six, JsonObject());
+		this_thread::sleep_for(milliseconds(30));
+		lib.Invoke(five, JsonObject());
+		ASSERT(lib.LoadedLibCount() == 2);
+		lib.Invoke(seven, JsonObject());
+		ASSERT(lib.LoadedLibCount() == 2);
+		ASSERT(not lib._binLib._cache.contains(lib._funcs[lib._funcs.Find(six)].Label));
+		ASSERT(lib.LoadedLibMetrics().Evictions == 4);
+	}
+
+	SECTION("Compact store in time slices")
+	{
+		using ::std::chrono::milliseconds;
+
+		using ::std::filesystem::file_size;
+
+		auto lib = FunctionLibrary::GetFrom(".");
+		lib.Remove(FuncType("int", "Eight", {}, {"Basic"}));
+		auto binSize = file_size("func_bin.lib");
+		// 两个文件共用一次调用的时间，整理完的索引不会每次重新整理，二进制文件也一直有进展
+		auto calls = 0;
+		while (not lib.CompactStore(milliseconds(1)))
+		{
+			ASSERT(++calls < 10000);
+		}
+		ASSERT(file_size("func_bin.lib") < binSize);
+		// 做完一轮后下一轮从索引重新开始，也能做完
+		ASSERT(lib.CompactStore(milliseconds(10'000)));
+		ASSERT(lib.Invoke(FuncType("int", "Three", {}, {"Basic"}), JsonObject()).GetNumber() == 3);
+	}
 }
 
 void TestFunctionLibrary(bool executed)
 {
-	Cleaner c1("func.idx"), c2("func_bin.lib");
+	Cleaner c1("func.idx"), c2("func_bin.lib"), c3("func_compile.cache"), c4("func_invoke.stat");
 	if (executed)
 	{
 		allTest();
@@ -0,0 +1,239 @@
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <string>
+#include <thread>
+#include <fstream>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include <condition_variable>
+#include "../TestFrame/FlyTest.hpp"
+#include "../TestFrame/Util.hpp"
+#include "../Store/File.hpp"
+#include "../Store/IoEngine.hpp"
+#include "../Persistence/ByteConverter.hpp"
+
+using namespace std;
+using namespace ::Test;
+using namespace FuncLib::Store;
+
+namespace
+{
+	/// 代替协程句柄，resume 时通知等着的线程
+	struct ResumeSignal
+	{
+		mutex Mutex;
+		condition_variable Resumed;
+		bool Done = false;
+
+		void Wait()
+		{
+			unique_lock<mutex> lock(Mutex);
+			Resumed.wait(lock, [this] { return Done; });
+		}
+	};
+
+	struct FakeHandle
+	{
+		ResumeSignal* Signal;
+
+		void resume()
+		{
+			// 锁里通知，等的线程醒了可能马上析构 Signal
+			lock_guard<mutex> guard(Signal->Mutex);
+			Signal->Done = true;
+			Signal->Resumed.notify_all();
+		}
+	};
+
+	/// 代替服务端的线程池，每个任务一个线程，析构时等它们跑完
+	struct Workers
+	{
+		vector<thread> Threads;
+		mutex Mutex;
+
+		IoEngine::Executor Executor()
+		{
+			return [this](function<void()> task)
+			{
+				lock_guard<mutex> guard(Mutex);
+				Threads.emplace_back(move(task));
+			};
+		}
+
+		~Workers()
+		{
+			lock_guard<mutex> guard(Mutex);
+			for (auto& t : Threads)
+			{
+				t.join();
+			}
+		}
+	};
+}
+
+TESTCASE("IoEngine test")
+{
+	auto filename = "ioEngineTest";
+
+	SECTION("Batch write and read")
+	{
+		Cleaner c(filename);
+		ofstream(filename).close();
+		auto engine = IoEngine::Open(filename);
+
+		constexpr auto count = 100;
+		vector<string> datas;
+		vector<WriteRequest> writes;
+		for (auto i = 0; i < count; ++i)
+		{
+			datas.push_back(string(50, 'a' + i % 26));
+		}
+		for (auto i = 0; i < count; ++i)
+		{
+			writes.push_back({ static_cast<pos_int>(i * 50), datas[i].data(), datas[i].size() });
+		}
+		engine->Write(writes);
+
+		vector<string> reads(count, string(50, ' '));
+		vector<ReadRequest> readRequests;
+		for (auto i = 0; i < count; ++i)
+		{
+			readRequests.push_back({ static_cast<pos_int>(i * 50), reads[i].data(), reads[i].size() });
+		}
+		engine->Read(readRequests);
+		ASSERT(reads == datas);
+
+		// 超出文件末尾的部分是 0
+		string tail(100, 'x');
+		engine->Read({ ReadRequest{ count * 50 - 50, tail.data(), tail.size() } });
+		ASSERT(tail.substr(0, 50) == datas.back());
+		ASSERT(tail.substr(50) == string(50, '\0'));
+	}
+
+	SECTION("Direct write and read")
+	{
+		Cleaner c(filename);
+		ofstream(filename).close();
+		auto engine = IoEngine::Open(filename);
+
+		// 不对齐的位置和大小，前后挨着的数据不能被覆盖
+		string before(5000, 'b');
+		string middle(3 * DiskBlockSize + 123, 'm');
+		string after(1000, 'a');
+		pos_int middlePos = before.size();
+		pos_int afterPos = middlePos + middle.size();
+		engine->Write({ WriteRequest{ 0, before.data(), before.size() } });
+		engine->Write({ WriteRequest{ afterPos, after.data(), after.size() } });
+		engine->Write({ WriteRequest{ middlePos, middle.data(), middle.size(), true } });
+
+		string all(afterPos + after.size(), ' ');
+		engine->Read({ ReadRequest{ 0, all.data(), all.size() } });
+		ASSERT(all == before + middle + after);
+
+		string read(middle.size(), ' ');
+		engine->Read({ ReadRequest{ middlePos, read.data(), read.size(), true } });
+		ASSERT(read == middle);
+
+		// 读到文件末尾为止，对齐多读的部分在文件外面
+		string tail(after.size(), ' ');
+		engine->Read({ ReadRequest{ afterPos, tail.data(), tail.size(), true } });
+		ASSERT(tail == after);
+
+		// 超出文件末尾的读是错的，不能当成 0
+		string pastEnd(2 * DiskBlockSize, 'x');
+		ASSERT_THROW(out_of_range, engine->Read({ ReadRequest{ afterPos, pastEnd.data(), pastEnd.size(), true } }));
+	}
+
+	SECTION("Async read")
+	{
+		Cleaner c(filename);
+		{
+			ofstream f(filename);
+			f << "hello io engine";
+		}
+		auto engine = IoEngine::Open(filename);
+		Workers workers;
+
+		string des(8, ' ');
+		ResumeSignal signal;
+		exception_ptr result = make_exception_ptr(0);
+		auto caller = this_thread::get_id();
+		auto resumedOn = caller;
+		engine->ReadAsync({ 6, des.data(), des.size() }, workers.Executor(), [&](exception_ptr e)
+		{
+			result = e;
+			resumedOn = this_thread::get_id();
+			FakeHandle{ &signal }.resume();
+		});
+		signal.Wait();
+		ASSERT(result == nullptr);
+		ASSERT(des == "io engin");
+		ASSERT(resumedOn != caller);
+	}
+
+	SECTION("Async read callbacks run in parallel")
+	{
+		Cleaner c(filename);
+		{
+			ofstream f(filename);
+			f << "hello io engine";
+		}
+		auto engine = IoEngine::Open(filename);
+		Workers workers;
+
+		// 第一个 callback 等第二个，都在一个线程里调用的话会一直等下去
+		string des1(5, ' ');
+		string des2(2, ' ');
+		ResumeSignal secondDone;
+		ResumeSignal firstDone;
+		engine->ReadAsync({ 0, des1.data(), des1.size() }, workers.Executor(), [&](exception_ptr)
+		{
+			secondDone.Wait();
+			FakeHandle{ &firstDone }.resume();
+		});
+		engine->ReadAsync({ 6, des2.data(), des2.size() }, workers.Executor(), [&](exception_ptr)
+		{
+			FakeHandle{ &secondDone }.resume();
+		});
+		firstDone.Wait();
+		ASSERT(des1 == "hello");
+		ASSERT(des2 == "io");
+	}
+
+	SECTION("File async read")
+	{
+		Cleaner c(filename);
+		Cleaner c1("ioEngineTest.wal");
+		auto file = File::GetFile(filename);
+		auto [label1, obj1] = file->New(string(300, 'a'));
+		file->Store(label1, obj1);
+		obj1.reset();
+		file.reset();
+
+		Workers workers;
+		file = File::GetFile(filename);
+		auto awaiter = file->ReadAsync<string>(label1, workers.Executor());
+		ASSERT(not awaiter.await_ready());
+		ResumeSignal signal;
+		awaiter.await_suspend(FakeHandle{ &signal });
+		signal.Wait();
+		auto s = awaiter.await_resume();
+		ASSERT(*s == string(300, 'a'));
+
+		// 已经读进来了，直接拿缓存里的
+		auto cached = file->ReadAsync<string>(label1, workers.Executor());
+		ASSERT(cached.await_ready());
+		ASSERT(cached.await_resume() == s);
+	}
+}
+
+void TestIoEngine(bool executed)
+{
+	if (executed)
+	{
+		allTest();
+	}
+	_tests_.clear();
+}
@@ -1,3 +1,5 @@
+#include <chrono>
+#include <cstdio>
 #include "../../TestFrame/FlyTest.hpp"
 #include "StringReader.hpp"
 #define private public
@@ -273,6 +275,107 @@ TESTCASE("ObjectRelationTree test")
 			ASSERT(tree._freeNodes.EqualTo(destFreeNodes));
 		}
 	}
+
+	SECTION("Update cost follows the change")
+	{
+		using ::std::chrono::duration;
+		using ::std::chrono::steady_clock;
+		// 每层 10 个子节点，5 层，十万多个节点
+		constexpr int fanout = 10;
+		constexpr int depth = 5;
+		pos_label next = 1;
+		auto build = [&](auto& self, int level) -> LabelNode
+		{
+			auto label = next++;
+			vector<LabelNode> subs;
+			if (level < depth)
+			{
+				for (auto i = 0; i < fanout; ++i)
+				{
+					subs.push_back(self(self, level + 1));
+				}
+			}
+			return LabelNode(label, move(subs));
+		};
+		auto top = build(build, 0);
+		auto bigTree = ObjectRelationTree(LabelNode(FileLabel, { top }));
+
+		// 改一个叶子：从上到叶子的父节点这条路径上的节点重写了，路径旁边的节点没动
+		auto changeOneLeaf = [&](pos_label newLeaf)
+		{
+			vector<pos_label> path{ top.Label() };
+			while (bigTree.SubsOf(path.back()).size() > 0 and not bigTree.SubsOf(bigTree.SubsOf(path.back()).front()).empty())
+			{
+				path.push_back(bigTree.SubsOf(path.back()).front());
+			}
+
+			auto leafParent = path.back();
+			auto oldLeaf = bigTree.SubsOf(leafParent).front();
+			// 叶子的父节点把第一个叶子换成新的，其他节点只换了路径上的那个子节点
+			auto cons = [&](auto& self, size_t i) -> ReadStateLabelNode
+			{
+				vector<ReadStateLabelNode> subs;
+				for (auto l : bigTree.SubsOf(path[i]))
+				{
+					if (i + 1 < path.size() and l == path[i + 1])
+					{
+						subs.push_back(self(self, i + 1));
+					}
+					else if (l != oldLeaf)
+					{
+						subs.push_back(ReadStateLabelNode(l, {}, false));
+					}
+				}
+				if (i + 1 == path.size())
+				{
+					subs.push_back(ReadStateLabelNode(newLeaf, {}, true));
+				}
+				return ReadStateLabelNode(path[i], move(subs), true);
+			};
+			auto node = cons(cons, 0);
+			bigTree.UpdateWith(move(node));
+			return pair{ oldLeaf, leafParent };
+		};
+
+		constexpr auto count = 100;
+		auto start = steady_clock::now();
+		for (auto i = 0; i < count; ++i)
+		{
+			auto newLeaf = next++;
+			auto [oldLeaf, leafParent] = changeOneLeaf(newLeaf);
+			ASSERT(bigTree.ParentOf(newLeaf).value() == leafParent);
+			ASSERT(not bigTree.ParentOf(oldLeaf).has_value());
+			ASSERT(bigTree._freeNodes.Contains(oldLeaf));
+		}
+		duration<double> time = steady_clock::now() - start;
+		ASSERT(bigTree.ParentOf(top.Label()).value() == FileLabel);
+		printf("one leaf change in a %d node relation tree: %.3fms per update\n", next - 1 - count, time.count() * 1000 / count);
+
+		// 父对象没改的脏对象单独存：找父节点和原地更新都只碰到它自己，不用遍历整棵树
+		vector<pos_label> dirty;
+		bigTree.TraverseInUse([&](pos_label label)
+		{
+			auto& subs = bigTree.SubsOf(label);
+			if (not subs.empty() and bigTree.SubsOf(subs.front()).empty())
+			{
+				dirty.push_back(label);
+			}
+		});
+		start = steady_clock::now();
+		for (auto label : dirty)
+		{
+			auto parent = bigTree.ParentOf(label).value();
+			vector<ReadStateLabelNode> subs;
+			for (auto l : bigTree.SubsOf(label))
+			{
+				subs.push_back(ReadStateLabelNode(l, {}, false));
+			}
+			bigTree.UpdateInPlace(ReadStateLabelNode(label, move(subs), true));
+			ASSERT(bigTree.ParentOf(label).value() == parent);
+		}
+		time = steady_clock::now() - start;
+		printf("in place update of %zu dirty objects: %.3fms\n", dirty.size(), time.count() * 1000);
+	}
 }
 
 DEF_TEST_FUNC(TestObjectRelationTree)
\ No newline at end of file
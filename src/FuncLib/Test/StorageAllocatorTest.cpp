@@ -38,8 +38,40 @@ TESTCASE("StorageAllocator test")
             auto copyAllocator = ReadAllocatedInfoFrom(&reader);
             ASSERT(copyAllocator._currentPos == alloca._currentPos);
             ASSERT(copyAllocator._currentLabel == alloca._currentLabel);
-            ASSERT(copyAllocator._deletedLabelTable == alloca._deletedLabelTable);
-            ASSERT(copyAllocator._usingLabelTable == alloca._usingLabelTable);
+            ASSERT(copyAllocator._labelTable == alloca._labelTable);
+        }
+
+        SECTION("Placement by size")
+        {
+            auto a = StorageAllocator();
+            auto give = [&](size_t size)
+            {
+                auto l = a.AllocatePosLabel();
+                a.GiveSpaceTo(l, size);
+                return pair{ a.GetConcretePos(l), size };
+            };
+
+            // 小对象紧挨着放
+            auto [p0, s0] = give(10);
+            auto [p1, s1] = give(100);
+            ASSERT(p1 == p0 + s0);
+            // 节点大小的对象不跨页
+            for (auto i = 0; i < 20; ++i)
+            {
+                auto [p, s] = give(1000 + i * 150);
+                ASSERT(p / DiskBlockSize == (p + s - 1) / DiskBlockSize);
+            }
+            auto [p2, s2] = give(DiskBlockSize);
+            ASSERT(p2 % DiskBlockSize == 0);
+            // 更大的从页开头放，大对象占满最后一页
+            auto [p3, s3] = give(DiskBlockSize + 1);
+            ASSERT(p3 % DiskBlockSize == 0);
+            auto [p4, s4] = give(LargeObjectSize + 1);
+            ASSERT(p4 % DiskBlockSize == 0);
+            ASSERT(a.GetEndPos() % DiskBlockSize == 0);
+            auto [p5, s5] = give(10);
+            ASSERT(p5 == a.GetEndPos() - s5);
+            ASSERT(p5 >= p4 + s4);
         }
 
         SECTION("Allocate Specified Label")
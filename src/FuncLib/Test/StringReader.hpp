@@ -30,6 +30,11 @@ namespace FuncLib::Test
 			return bytes;
 		}
 
+		void ReadTo(byte* des, size_t size)
+		{
+			_stream.read(reinterpret_cast<char*>(des), size);
+		}
+
 		template <size_t N>
 		array<byte, N> Read()
 		{
@@ -40,7 +45,7 @@ namespace FuncLib::Test
 
 		void Skip(size_t size)
 		{
-			Read(size);
+			_stream.seekg(size, stringstream::cur);
 		}
 	};
 }
@@ -9,6 +9,11 @@ extern void TestObjectRelationTree(bool executed);
 extern void TestTypeConverter(bool executed);
 extern void TestByteConverter(bool executed);
 extern void TestFunctionLibrary(bool executed);
+extern void TestWriteAheadLog(bool executed);
+extern void TestIoEngine(bool executed);
+extern void TestBlobCompress(bool executed);
+extern void TestCompileCache(bool executed);
+extern void TestFuncTable(bool executed);
 
 namespace FuncLib::Test
 {
@@ -21,6 +26,11 @@ namespace FuncLib::Test
 		TestCompile(executed);
 		TestStorageAllocator(executed);
 		TestFile(executed);
+		TestWriteAheadLog(executed);
+		TestIoEngine(executed);
+		TestBlobCompress(executed);
+		TestCompileCache(executed);
+		TestFuncTable(executed);
 		TestFunctionLibrary(executed);
 		// 有时间可以整理下面这两个
 		TestTypeConverter(false);
@@ -0,0 +1,299 @@
+#include <csignal>
+#include <sys/resource.h>
+#include <memory>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include "../TestFrame/FlyTest.hpp"
+#include "../TestFrame/Util.hpp"
+#include "../Store/File.hpp"
+#include "../Store/WriteAheadLog.hpp"
+#include "../Persistence/ByteConverter.hpp"
+
+using namespace std;
+using namespace ::Test;
+using namespace FuncLib::Store;
+
+TESTCASE("WriteAheadLog test")
+{
+	auto logFilename = "walTest.wal";
+
+	SECTION("Commit and read")
+	{
+		Cleaner c(logFilename);
+		{
+			WriteAheadLog log(logFilename);
+			for (auto i = 0; i < 10; ++i)
+			{
+				auto s = to_string(i);
+				log.Commit(vector<char>(s.begin(), s.end()));
+			}
+			ASSERT(log.Size() > 0);
+		}
+
+		auto records = WriteAheadLog::ReadRecords(logFilename);
+		ASSERT(records.size() == 10);
+		for (auto i = 0; i < 10; ++i)
+		{
+			ASSERT(string(records[i].begin(), records[i].end()) == to_string(i));
+		}
+
+		{
+			WriteAheadLog log(logFilename);
+			log.Reset();
+			ASSERT(log.Size() == 0);
+		}
+		ASSERT(WriteAheadLog::ReadRecords(logFilename).empty());
+	}
+
+	SECTION("Torn tail is ignored")
+	{
+		Cleaner c(logFilename);
+		{
+			WriteAheadLog log(logFilename);
+			log.Commit(vector<char>(100, 'a'));
+			log.Commit(vector<char>(100, 'b'));
+		}
+
+		// 模拟写第二条时崩溃
+		using ::std::filesystem::file_size;
+		using ::std::filesystem::resize_file;
+		resize_file(logFilename, file_size(logFilename) - 10);
+		auto records = WriteAheadLog::ReadRecords(logFilename);
+		ASSERT(records.size() == 1);
+		ASSERT(records[0] == vector<char>(100, 'a'));
+	}
+
+	SECTION("Recover File")
+	{
+		using ::std::filesystem::resize_file;
+		auto filename = "walFileTest";
+		Cleaner c0(filename);
+		Cleaner c1("walFileTest.wal");
+		constexpr auto count = 10;
+		auto valueOf = [](int i) { return string(i * 10, 'a' + i); };
+		{
+			auto file = File::GetFile(filename);
+			for (auto i = 1; i <= count; ++i)
+			{
+				auto [label, obj] = file->New(i, valueOf(i));
+				file->Store(label, obj);
+			}
+			file->Delete(1, file->Read<string>(1));
+
+			// 模拟崩溃：File 不析构，元信息没写回去，数据也丢了
+			new shared_ptr<File>(file);
+		}
+		resize_file(filename, 2048);
+
+		{
+			auto file = File::GetFile(filename);
+			for (auto i = 2; i <= count; ++i)
+			{
+				ASSERT(*file->Read<string>(i) == valueOf(i));
+			}
+		}
+
+		{
+			auto file = File::GetFile(filename);
+			ASSERT(WriteAheadLog::ReadRecords("walFileTest.wal").empty());
+			for (auto i = 2; i <= count; ++i)
+			{
+				ASSERT(*file->Read<string>(i) == valueOf(i));
+			}
+		}
+	}
+
+	SECTION("Group commit")
+	{
+		using ::std::chrono::duration;
+		using ::std::chrono::steady_clock;
+		constexpr auto totalCommits = 512;
+		for (auto writerCount : { 1, 8, 64 })
+		{
+			Cleaner c(logFilename);
+			WriteAheadLog log(logFilename);
+			auto commitsPerWriter = totalCommits / writerCount;
+			auto start = steady_clock::now();
+			{
+				vector<thread> writers;
+				for (auto i = 0; i < writerCount; ++i)
+				{
+					writers.emplace_back([&log, i, commitsPerWriter]
+					{
+						for (auto j = 0; j < commitsPerWriter; ++j)
+						{
+							log.Commit(vector<char>(64, static_cast<char>(i)));
+						}
+					});
+				}
+
+				for (auto& w : writers)
+				{
+					w.join();
+				}
+			}
+			duration<double> seconds = steady_clock::now() - start;
+			printf("%d writers: %.0f commits/s, %zu syncs for %d commits\n",
+				writerCount, totalCommits / seconds.count(), log.SyncCount(), totalCommits);
+
+			ASSERT(WriteAheadLog::ReadRecords(logFilename).size() == totalCommits);
+		}
+
+		// leader 等别的线程的记录都加进来了再写，这些提交只 sync 一次
+		for (auto writerCount : { 2, 8, 64 })
+		{
+			Cleaner c(logFilename);
+			WriteAheadLog log(logFilename);
+			atomic<int> appended = 0;
+			log.SetBeforeSync([&appended, writerCount]
+			{
+				while (appended < writerCount)
+				{
+					this_thread::yield();
+				}
+			});
+			{
+				vector<thread> writers;
+				for (auto i = 0; i < writerCount; ++i)
+				{
+					writers.emplace_back([&log, &appended, i]
+					{
+						auto seq = log.Append(vector<char>(64, static_cast<char>(i)));
+						++appended;
+						log.WaitDurable(seq);
+					});
+				}
+
+				for (auto& w : writers)
+				{
+					w.join();
+				}
+			}
+
+			ASSERT(log.SyncCount() == 1);
+			ASSERT(WriteAheadLog::ReadRecords(logFilename).size() == writerCount);
+		}
+	}
+
+	SECTION("Commit is durable on return")
+	{
+		constexpr auto writerCount = 8;
+		constexpr auto commitsPerWriter = 16;
+		Cleaner c(logFilename);
+		WriteAheadLog log(logFilename);
+		atomic<int> notDurable = 0;
+		{
+			vector<thread> writers;
+			for (auto i = 0; i < writerCount; ++i)
+			{
+				writers.emplace_back([&log, &notDurable, logFilename, i]
+				{
+					for (auto j = 0; j < commitsPerWriter; ++j)
+					{
+						auto record = vector<char>(64, static_cast<char>(i));
+						record[0] = static_cast<char>(j);
+						log.Commit(record);
+						// 返回时自己的记录已经在文件里了，不管是不是别的线程替它写的
+						auto records = WriteAheadLog::ReadRecords(logFilename);
+						if (find(records.begin(), records.end(), record) == records.end())
+						{
+							++notDurable;
+						}
+					}
+				});
+			}
+
+			for (auto& w : writers)
+			{
+				w.join();
+			}
+		}
+
+		ASSERT(notDurable == 0);
+		ASSERT(WriteAheadLog::ReadRecords(logFilename).size() == writerCount * commitsPerWriter);
+	}
+
+	SECTION("Failed write is reported to every waiter")
+	{
+		using ::std::filesystem::file_size;
+
+		// 用文件大小的上限让写只写进去一部分，然后失败
+		struct FileSizeLimit
+		{
+			rlimit Old;
+
+			FileSizeLimit(rlim_t limit)
+			{
+				::signal(SIGXFSZ, SIG_IGN);
+				::getrlimit(RLIMIT_FSIZE, &Old);
+				auto l = Old;
+				l.rlim_cur = limit;
+				::setrlimit(RLIMIT_FSIZE, &l);
+			}
+
+			~FileSizeLimit()
+			{
+				::setrlimit(RLIMIT_FSIZE, &Old);
+			}
+		};
+
+		Cleaner c(logFilename);
+		WriteAheadLog log(logFilename);
+		log.Commit(vector<char>(100, 'a'));
+		auto durableSize = file_size(logFilename);
+		constexpr auto writerCount = 8;
+		atomic<int> succeeded = 0;
+		atomic<int> failed = 0;
+		{
+			FileSizeLimit limit(durableSize + 50);
+			vector<thread> writers;
+			for (auto i = 0; i < writerCount; ++i)
+			{
+				writers.emplace_back([&log, &succeeded, &failed]
+				{
+					try
+					{
+						log.Commit(vector<char>(100, 'b'));
+						++succeeded;
+					}
+					catch (system_error const&)
+					{
+						++failed;
+					}
+				});
+			}
+
+			for (auto& w : writers)
+			{
+				w.join();
+			}
+		}
+
+		// 谁替谁写的都一样，没写下去的记录不能报成功
+		ASSERT(succeeded == 0);
+		ASSERT(failed == writerCount);
+		// 写了一半的 frame 被截掉了
+		ASSERT(file_size(logFilename) == durableSize);
+		ASSERT(WriteAheadLog::ReadRecords(logFilename).size() == 1);
+		// 之后的提交也不会越过丢掉的记录
+		ASSERT_THROW(system_error, log.Commit(vector<char>(10, 'c')));
+		ASSERT(WriteAheadLog::ReadRecords(logFilename).size() == 1);
+	}
+}
+
+void TestWriteAheadLog(bool executed)
+{
+	if (executed)
+	{
+		allTest();
+	}
+	_tests_.clear();
+}
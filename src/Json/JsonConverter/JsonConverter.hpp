@@ -6,6 +6,7 @@
 #include <vector>
 #include <array>
 #include <map>
+#include <memory>
 #include "../Json.hpp"
 
 namespace Json::JsonConverter
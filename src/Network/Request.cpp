@@ -291,5 +291,43 @@ namespace Json::JsonConverter
 	{
 		return AccountUsernameDeserialize<RemoveAdminAccountRequest::Content>(jsonObj);
 	}
+
+	///---------- BackupStoreRequest ----------
+	template <>
+	JsonObject Serialize(BackupStoreRequest::Content const& content)
+	{
+		auto [dir] = content;
+		JsonObject::_Object obj;
+		obj.insert({ nameof(dir), Serialize(dir) });
+
+		return JsonObject(move(obj));
+	}
+
+	template <>
+	BackupStoreRequest::Content Deserialize(JsonObject const& jsonObj)
+	{
+		auto dir = Deserialize<string>(jsonObj[nameof(dir)]);
+
+		return { move(dir) };
+	}
+
+	///---------- GetAddFuncStatusRequest ----------
+	template <>
+	JsonObject Serialize(GetAddFuncStatusRequest::Content const& content)
+	{
+		auto [jobId] = content;
+		JsonObject::_Object obj;
+		obj.insert({ nameof(jobId), Serialize(jobId) });
+
+		return JsonObject(move(obj));
+	}
+
+	template <>
+	GetAddFuncStatusRequest::Content Deserialize(JsonObject const& jsonObj)
+	{
+		auto jobId = Deserialize<int>(jsonObj[nameof(jobId)]);
+
+		return { jobId };
+	}
 #undef nameof
 }
\ No newline at end of file
@@ -34,6 +34,10 @@ namespace Network
 		AddAdminAccount,
 		RemoveAdminAccount,
 		GetFuncsInfo,
+		CompactStore,
+		BackupStore,
+		SubmitAddFunc,
+		GetAddFuncStatus,
 		Shutdown,
 	};
 
@@ -126,6 +130,41 @@ namespace Network
 		vector<FuncType> Result;
 	};
 
+	struct CompactStoreRequest : public Request
+	{
+	};
+
+	struct BackupStoreRequest : public Request
+	{
+		struct Content
+		{
+			/// 服务器上的目录
+			string Dir;
+		};
+
+		Content Paras;
+	};
+
+	/// 和 AddFunc 一样，但不等编译完，马上返回任务号
+	struct SubmitAddFuncRequest : public Request
+	{
+		using Content = AddFuncRequest::Content;
+
+		Content Paras;
+		int Result;
+	};
+
+	struct GetAddFuncStatusRequest : public Request
+	{
+		struct Content
+		{
+			int JobId;
+		};
+
+		Content Paras;
+		string Result;
+	};
+
 	///---------- AccountManager request ----------
 
 	struct LoginRequest
@@ -189,7 +228,9 @@ namespace Json::JsonConverter
 	using Network::AddClientAccountRequest;
 	using Network::AddFuncRequest;
 	using Network::AdminServiceOption;
+	using Network::BackupStoreRequest;
 	using Network::ContainsFuncRequest;
+	using Network::GetAddFuncStatusRequest;
 	using Network::InvokeFuncRequest;
 	using Network::LoginRequest;
 	using Network::ModifyFuncPackageRequest;
@@ -288,4 +329,18 @@ namespace Json::JsonConverter
 
 	template <>
 	RemoveAdminAccountRequest::Content Deserialize(JsonObject const& jsonObj);
+
+	///---------- BackupStoreRequest ----------
+	template <>
+	JsonObject Serialize(BackupStoreRequest::Content const& content);
+
+	template <>
+	BackupStoreRequest::Content Deserialize(JsonObject const& jsonObj);
+
+	///---------- GetAddFuncStatusRequest ----------
+	template <>
+	JsonObject Serialize(GetAddFuncStatusRequest::Content const& content);
+
+	template <>
+	GetAddFuncStatusRequest::Content Deserialize(JsonObject const& jsonObj);
 }
\ No newline at end of file
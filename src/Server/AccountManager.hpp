@@ -1,6 +1,7 @@
 #pragma once
 #include <map>
 #include <mutex>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <utility>
@@ -17,6 +18,8 @@ namespace Server
 {
 	using Basic::InvalidOperationException;
 	using FuncLib::Store::File;
+	using Network::BackupStoreRequest;
+	using Network::CompactStoreRequest;
 	using FuncLib::Store::pos_label;
 	using Network::Request;
 	using ::std::make_shared;
@@ -28,6 +31,7 @@ namespace Server
 	using ::std::shared_ptr;
 	using ::std::string;
 	using ::std::unique_lock;
+	using ::std::chrono::milliseconds;
 	using ::std::filesystem::path;
 
 	class AccountData
@@ -96,6 +100,7 @@ namespace Server
 				throw InvalidOperationException("add failed: " + username + " already exist");
 			}
 			_accountsInfo->insert(pair(move(username), pair(move(password), isAdmin)));
+			_file->Store(AccountsLabel, _accountsInfo);
 		}
 
 		void Remove(bool isAdmin, string const &username)
@@ -105,12 +110,25 @@ namespace Server
 				if ((*_accountsInfo)[username].second == isAdmin)
 				{
 					_accountsInfo->erase(username);
+					_file->Store(AccountsLabel, _accountsInfo);
 					return;
 				}
 				throw InvalidOperationException("remove failed: " + username + " account type(is admin or not) not match");
 			}
 			throw InvalidOperationException("remove failed: " + username + " not found");
 		}
+
+		/// Return true when compact is completed
+		bool Compact(milliseconds timeSlice)
+		{
+			return _file->Compact(timeSlice);
+		}
+
+		void Backup(path const& dirPath)
+		{
+			// 账户数据很小，不限速
+			_file->Backup(dirPath / "accounts_info", 0).get();
+		}
 	};
 
 	class AccountManager
@@ -234,5 +252,29 @@ namespace Server
 
 			return { requestPtr };
 		}
+
+		Awaiter<CompactStoreRequest> CompactStore()
+		{
+			auto requestPtr = make_shared<CompactStoreRequest>(CompactStoreRequest{ Request() });
+			_threadPool->Execute(GenerateWriteTask(requestPtr, [this](auto request)
+			{
+				// 账户数据很小，一次做完
+				while (not _data.Compact(milliseconds(10)))
+				{ }
+			}));
+
+			return { requestPtr };
+		}
+
+		Awaiter<BackupStoreRequest> BackupStore(BackupStoreRequest::Content paras)
+		{
+			auto requestPtr = make_shared<BackupStoreRequest>(BackupStoreRequest{ Request(), move(paras) });
+			_threadPool->Execute(GenerateWriteTask(requestPtr, [this](auto request)
+			{
+				_data.Backup(request->Paras.Dir);
+			}));
+
+			return { requestPtr };
+		}
 	};
 }
\ No newline at end of file
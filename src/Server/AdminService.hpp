@@ -6,6 +6,7 @@
 namespace Server
 {
 	using Network::AdminServiceOption;
+	using Network::BackupStoreRequest;
 	using ::std::function;
 
 	class AdminService : private ServiceBase
@@ -36,6 +37,51 @@ namespace Server
 				argLogger.BornNewWith(ResultStatus::Complete);
 				co_return;
 			};
+			auto compactStore = [funcLibWorker=_funcLibWorker, accountManager=_accountManager, peer=_peer, responder=_responder](auto userLoggerPtr) -> Void
+			{
+				auto id = GenerateRequestId();
+				auto idLogger = userLoggerPtr->BornNewWith(id);
+				responder->RespondTo(peer, id);
+				auto requestLogger = idLogger.BornNewWith(nameof(CompactStore));
+				auto argLogger = requestLogger.BornNewWith(nameof(-));
+				JsonObject result;
+				try
+				{
+					co_await funcLibWorker->CompactStore();
+					co_await accountManager->CompactStore();
+				}
+				catch (std::exception const& e)
+				{
+					ReturnToPeer(responder, peer, e);
+					argLogger.BornNewWith(ResultStatus::Failed);
+					co_return;
+				}
+				ReturnToPeer(responder, peer, move(result));
+				argLogger.BornNewWith(ResultStatus::Complete);
+			};
+			auto backupStore = [funcLibWorker=_funcLibWorker, accountManager=_accountManager, peer=_peer, responder=_responder](auto userLoggerPtr) -> Void
+			{
+				auto [paras, rawStr] = ReceiveFromPeer<BackupStoreRequest::Content, true>(peer.get());
+				auto id = GenerateRequestId();
+				auto idLogger = userLoggerPtr->BornNewWith(id);
+				responder->RespondTo(peer, id);
+				auto requestLogger = idLogger.BornNewWith(nameof(BackupStore));
+				auto argLogger = requestLogger.BornNewWith(move(rawStr));
+				JsonObject result;
+				try
+				{
+					co_await funcLibWorker->BackupStore(paras);
+					co_await accountManager->BackupStore(move(paras));
+				}
+				catch (std::exception const& e)
+				{
+					ReturnToPeer(responder, peer, e);
+					argLogger.BornNewWith(ResultStatus::Failed);
+					co_return;
+				}
+				ReturnToPeer(responder, peer, move(result));
+				argLogger.BornNewWith(ResultStatus::Complete);
+			};
 			AsyncLoopAcquireThenDispatch<AdminServiceOption>(
 				move(userLogger),
 				_peer,
@@ -51,6 +97,10 @@ namespace Server
 				ASYNC_ACCOUNT_MANAGE_HANDLER(AddAdminAccount),
 				ASYNC_ACCOUNT_MANAGE_HANDLER(RemoveAdminAccount),
 				ASYNC_HANDLER_WITHOUT_ARG(GetFuncsInfo, _funcLibWorker),
+				move(compactStore),
+				move(backupStore),
+				ASYNC_FUNC_LIB_HANDLER(SubmitAddFunc),
+				ASYNC_FUNC_LIB_HANDLER(GetAddFuncStatus),
 				move(shutdown)
 				);
 		}
@@ -42,7 +42,7 @@ namespace Server
 			RequestPtr->CondVar.notify_one();
 		}
 
-		auto await_resume() const noexcept
+		auto await_resume() const
 		{
 			if (ExceptionPtr != nullptr)
 			{
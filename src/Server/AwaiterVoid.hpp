@@ -36,7 +36,7 @@ namespace Server
 				}
 
 				// Final在外层还没有 Void 的情况下，就不用等了，直接进入 destroy 环节
-				bool await_suspend(auto handle)
+				bool await_suspend(auto handle) noexcept
 				{
 					auto& p = handle.promise();
 					// 这里的异常处理还不完备，先这样
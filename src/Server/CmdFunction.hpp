@@ -23,7 +23,9 @@ namespace Server
 	using Network::AddAdminAccountRequest;
 	using Network::AddClientAccountRequest;
 	using Network::AddFuncRequest;
+	using Network::BackupStoreRequest;
 	using Network::ContainsFuncRequest;
+	using Network::GetAddFuncStatusRequest;
 	using Network::GetFuncsInfoRequest;
 	using Network::HandleOperationResponse;
 	using Network::InvokeFuncRequest;
@@ -60,6 +62,10 @@ namespace Server
 			nameof(RemoveClientAccount),
 			nameof(AddAdminAccount),
 			nameof(RemoveAdminAccount),
+			nameof(CompactStore),
+			nameof(BackupStore),
+			nameof(SubmitAddFunc),
+			nameof(GetAddFuncStatus),
 			nameof(Shutdown),
 		};
 	}
@@ -311,6 +317,58 @@ namespace Server
 		}
 	};
 
+	struct CompactStoreCmd
+	{
+		/// no args need to process
+		vector<string> ProcessResponse(string_view response)
+		{
+			HandleOperationResponse<void>(response);
+			return { SuccessTip };
+		}
+	};
+
+	// Sample: BackupStore /data/backup
+	struct BackupStoreCmd
+	{
+		JsonObject ProcessArg(string_view args)
+		{
+			auto dir = args;
+			return Serial(CombineTo<BackupStoreRequest::Content>(string(dir)));
+		}
+
+		vector<string> ProcessResponse(string_view response)
+		{
+			HandleOperationResponse<void>(response);
+			return { SuccessTip };
+		}
+	};
+
+	// Sample: SubmitAddFunc A.B ./funcs.cpp summary，参数和 AddFunc 一样
+	class SubmitAddFuncCmd : public AddFuncCmd
+	{
+	public:
+		vector<string> ProcessResponse(string_view response)
+		{
+			auto jobId = HandleOperationResponse<int>(response);
+			return { "Job id: " + std::to_string(jobId) };
+		}
+	};
+
+	// Sample: GetAddFuncStatus 0
+	struct GetAddFuncStatusCmd
+	{
+		JsonObject ProcessArg(string_view args)
+		{
+			auto jobId = std::stoi(string(args));
+			return Serial(CombineTo<GetAddFuncStatusRequest::Content>(jobId));
+		}
+
+		vector<string> ProcessResponse(string_view response)
+		{
+			return { HandleOperationResponse<string>(response) };
+		}
+	};
+
 	struct ShutdownCmd
 	{
 		/// no args need to process
@@ -430,28 +488,27 @@ namespace Server
 			CASE_OF(AddAdminAccount);
 			CASE_OF(RemoveClientAccount);
 			CASE_OF(RemoveAdminAccount);
-		case StrToInt(nameof(GetFuncsInfo)):
-			requests.push_back(Json::JsonConverter::Serialize(Network::GetFuncsInfo).ToString());
-			{
-				auto c = GetFuncsInfoCmd();
-				responseProcessor = [c = move(c)](string_view response) mutable
-				{
-					return c.ProcessResponse(response);
-				};
-			}
-			break;
-		case StrToInt(nameof(Shutdown)):
-			requests.push_back(Json::JsonConverter::Serialize(Network::Shutdown).ToString());
-			{
-				auto c = ShutdownCmd();
-				responseProcessor = [c = move(c)](string_view response) mutable
-				{
-					return c.ProcessResponse(response);
-				};
-			}
-			break;
+			CASE_OF(BackupStore);
+			CASE_OF(SubmitAddFunc);
+			CASE_OF(GetAddFuncStatus);
+#define CASE_OF_WITHOUT_ARG(NAME)                                                     \
+	case StrToInt(nameof(NAME)):                                                      \
+		requests.push_back(Json::JsonConverter::Serialize(Network::NAME).ToString()); \
+		{                                                                             \
+			auto c = NAME##Cmd();                                                     \
+			responseProcessor = [c = move(c)](string_view response) mutable           \
+			{                                                                         \
+				return c.ProcessResponse(response);                                   \
+			};                                                                        \
+		}                                                                             \
+		break;
+
+			CASE_OF_WITHOUT_ARG(GetFuncsInfo);
+			CASE_OF_WITHOUT_ARG(CompactStore);
+			CASE_OF_WITHOUT_ARG(Shutdown);
 		default: throw invalid_argument(string("No handler of ").append(cmd));
 
+#undef CASE_OF_WITHOUT_ARG
 #undef CASE_OF
 		}
 
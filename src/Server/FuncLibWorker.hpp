@@ -1,18 +1,36 @@
 #pragma once
+#include <map>
 #include <memory>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
 #include <sstream>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
 #include "../Network/Request.hpp"
 #include "ThreadPool.hpp"
 #include "Awaiter.hpp"
+#include "AwaiterVoid.hpp"
 #include "../FuncLib/FunctionLibrary.hpp"
 
 namespace Server
 {
+	using Basic::InvalidOperationException;
+	using FuncLib::BinUnit;
+	using FuncLib::CompiledFuncs;
 	using FuncLib::FunctionLibrary;
+	using FuncLib::WarmUpBudget;
+	using FuncLib::Store::File;
+	using FuncLib::Store::IoEngine;
 	using Network::AddAdminAccountRequest;
 	using Network::AddClientAccountRequest;
 	using Network::AddFuncRequest;
+	using Network::BackupStoreRequest;
+	using Network::CompactStoreRequest;
 	using Network::ContainsFuncRequest;
+	using Network::GetAddFuncStatusRequest;
 	using Network::GetFuncsInfoRequest;
 	using Network::InvokeFuncRequest;
 	using Network::ModifyFuncPackageRequest;
@@ -20,16 +38,46 @@ namespace Server
 	using Network::RemoveClientAccountRequest;
 	using Network::RemoveFuncRequest;
 	using Network::SearchFuncRequest;
+	using Network::SubmitAddFuncRequest;
+	using ::std::exception_ptr;
 	using ::std::make_shared;
 	using ::std::make_unique;
+	using ::std::map;
+	using ::std::max;
 	using ::std::move;
+	using ::std::optional;
+	using ::std::rethrow_exception;
+	using ::std::shared_future;
+	using ::std::string;
+	using ::std::vector;
+	using ::std::chrono::milliseconds;
 
 	class FuncLibWorker
 	{
 	private:
+		/// 整理存储时每次占用 _funcLibMutex 的时长
+		static constexpr milliseconds CompactTimeSlice{ 10 };
+		/// 备份复制的限速，免得抢了处理请求的 I/O
+		static constexpr size_t BackupBytesPerSecond = 64 * 1024 * 1024;
+		/// 预加载时每次占用 _funcLibMutex 的时长
+		static constexpr milliseconds WarmUpTimeSlice{ 5 };
+		/// 最多记着这么多个 SubmitAddFunc 任务的状态，多了把最早的做完了的忘掉
+		static constexpr size_t MaxKeptJobs = 1024;
+		/// 后台线程隔这么久存一次调用次数，卸载一次闲置的库
+		static constexpr milliseconds BackgroundInterval{ 10'000 };
 		mutex _funcLibMutex;
 		FunctionLibrary _funcLib;
 		ThreadPool* _threadPool;
+		/// 编译是调用外部的 g++，时间长，放在单独的线程池里做，不占着 _funcLibMutex
+		/// 池里每个线程的编译还会分块并行，同时跑的编译器进程总数由 Compile 统一限制在核数以内
+		ThreadPool _compilePool;
+		mutex _jobsMutex;
+		int _nextJobId = 0;
+		map<int, string> _jobStatuses;
+		mutex _backgroundMutex;
+		condition_variable _backgroundCondVar;
+		bool _stopBackground = false;
+		thread _background;
 
 	private:
 		/// if ManualManageLock, the lock is locked already
@@ -92,28 +140,189 @@ namespace Server
 			};
 		}
 
+		/// 在 _compilePool 里编译，编译完把结果或者异常交给 onCompiled
+		void CompileThen(string funcsDef, auto onCompiled)
+		{
+			_compilePool.Execute([this, def = move(funcsDef), onCompiled = move(onCompiled)]() mutable
+			{
+				using ::std::istringstream;
+
+				shared_ptr<CompiledFuncs> compiled;
+				exception_ptr exception = nullptr;
+				try
+				{
+					compiled = make_shared<CompiledFuncs>(_funcLib.Compile({ make_unique<istringstream>(move(def)) }));
+				}
+				catch (...)
+				{
+					exception = std::current_exception();
+				}
+				onCompiled(move(compiled), exception);
+			});
+		}
+
+		/// 备份在后台复制，用单独的线程等它做完，再把结果或者异常交给 onFinished，不占着池里的线程
+		static void BackupFinishThen(vector<shared_future<void>> finishes, auto onFinished)
+		{
+			std::thread([finishes = move(finishes), onFinished = move(onFinished)]() mutable
+			{
+				exception_ptr exception = nullptr;
+				try
+				{
+					for (auto& f : finishes)
+					{
+						f.get();
+					}
+				}
+				catch (...)
+				{
+					exception = std::current_exception();
+				}
+				onFinished(exception);
+			}).detach();
+		}
+
+		/// I/O 完成后的 callback 放到 _threadPool 里跑
+		IoEngine::Executor PoolExecutor()
+		{
+			return [pool = _threadPool](auto task)
+			{
+				pool->Execute(move(task));
+			};
+		}
+
+		auto InvokeTask(shared_ptr<InvokeFuncRequest> requestPtr)
+		{
+			return GenerateTask<true>(move(requestPtr), [this](auto request, unique_lock<mutex>* lockPtr)
+			{
+				auto invoker = _funcLib.GetInvoker(request->Paras.Func, request->Paras.Arg);
+				lockPtr->unlock();
+				request->Result = invoker();
+			});
+		}
+
+		/// 库要从硬盘读时，读的过程不占着 _funcLibMutex 和池里的线程，读完在池里接着加载和调用
+		/// Precondition: read is not ready, so this always suspends
+		Void InvokeAfterRead(shared_ptr<InvokeFuncRequest> requestPtr, File::ReadAwaiter<BinUnit> read)
+		{
+			try
+			{
+				co_await read;
+			}
+			catch (...)
+			{
+				// 读失败的话下面加载时会再读一次，出错由它报给请求
+			}
+			InvokeTask(move(requestPtr))();
+		}
+
+		void SetJobStatus(int jobId, string status)
+		{
+			lock_guard<mutex> guard(_jobsMutex);
+			_jobStatuses[jobId] = move(status);
+		}
+
+		static size_t CompileThreadCount()
+		{
+			return max(1u, std::thread::hardware_concurrency());
+		}
+
 	public:
-		FuncLibWorker(FunctionLibrary funcLib) : _funcLib(move(funcLib)) { }
+		static constexpr char const JobCompiling[] = "Compiling";
+		static constexpr char const JobDone[] = "Done";
 
-		// 移动构造的时候还没有开始并发访问，所以可以不用加互斥量
+		FuncLibWorker(FunctionLibrary funcLib) : _funcLib(move(funcLib)), _compilePool(CompileThreadCount()) { }
+
+		// 移动构造的时候还没有开始并发访问，后台线程也还没启动，所以可以不用加互斥量
 		FuncLibWorker(FuncLibWorker&& that) noexcept
-			: _funcLibMutex(), _funcLib(move(that._funcLib)), _threadPool(that._threadPool)
+			: _funcLibMutex(), _funcLib(move(that._funcLib)), _threadPool(that._threadPool),
+			  _compilePool(move(that._compilePool)), _jobsMutex(), _nextJobId(that._nextJobId),
+			  _jobStatuses(move(that._jobStatuses))
 		{ }
 
+		~FuncLibWorker()
+		{
+			{
+				lock_guard<mutex> guard(_backgroundMutex);
+				_stopBackground = true;
+			}
+			_backgroundCondVar.notify_one();
+			if (_background.joinable())
+			{
+				_background.join();
+			}
+		}
+
 		void SetThreadPool(ThreadPool* threadPool)
 		{
 			_threadPool = threadPool;
 		}
 
+		/// 启动后台线程定期存调用次数和卸载闲置的库，不占池里的线程，调用的时候也不用做这些。启动后不能再移动
+		void StartBackground()
+		{
+			_background = std::thread([this]
+			{
+				unique_lock<mutex> lock(_backgroundMutex);
+				while (not _backgroundCondVar.wait_for(lock, BackgroundInterval, [this] { return _stopBackground; }))
+				{
+					try
+					{
+						lock_guard<mutex> libGuard(_funcLibMutex);
+						_funcLib.StoreInvokeStat();
+						_funcLib.EvictIdleLibs();
+					}
+					catch (...)
+					{
+						// 存不下的下次再存
+					}
+				}
+			});
+		}
+
+		/// 在后台预先加载调用得最多的库，每片做完重新排队，不耽误处理请求
+		void WarmUp(WarmUpBudget budget)
+		{
+			_threadPool->Execute([this, budget]
+			{
+				bool done;
+				{
+					lock_guard<mutex> guard(_funcLibMutex);
+					done = _funcLib.WarmUp(budget, WarmUpTimeSlice);
+				}
+
+				if (not done)
+				{
+					WarmUp(budget);
+				}
+			});
+		}
+
 		Awaiter<InvokeFuncRequest> InvokeFunc(InvokeFuncRequest::Content paras)
 		{
 			auto requestPtr = make_shared<InvokeFuncRequest>(InvokeFuncRequest{ {}, move(paras) });
-			_threadPool->Execute(GenerateTask<true>(requestPtr, [this](auto request, unique_lock<mutex>* lockPtr)
+			_threadPool->Execute([this, requestPtr]
 			{
-				auto invoker = _funcLib.GetInvoker(request->Paras.Func, request->Paras.Arg);
-				lockPtr->unlock();
-				request->Result = invoker();
-			}));
+				optional<File::ReadAwaiter<BinUnit>> read;
+				try
+				{
+					lock_guard<mutex> guard(_funcLibMutex);
+					read = _funcLib.ReadBinAsync(requestPtr->Paras.Func, PoolExecutor());
+				}
+				catch (...)
+				{
+					// 下面调用时会再出错，由它报给请求
+				}
+
+				if (read.has_value())
+				{
+					InvokeAfterRead(requestPtr, move(*read));
+				}
+				else
+				{
+					InvokeTask(requestPtr)();
+				}
+			});
 
 			return { requestPtr };
 		}
@@ -121,12 +330,84 @@ namespace Server
 		Awaiter<AddFuncRequest> AddFunc(AddFuncRequest::Content paras)
 		{
 			auto requestPtr = make_shared<AddFuncRequest>(AddFuncRequest{ {}, move(paras) });
-			_threadPool->Execute(GenerateTask(requestPtr, [this](auto request)
+			auto funcsDef = move(requestPtr->Paras.FuncsDef);
+			// 只有编译完加进索引和二进制库时才拿锁
+			CompileThen(move(funcsDef), [this, requestPtr](auto compiled, auto exception)
 			{
-				using ::std::istringstream;
+				_threadPool->Execute(GenerateTask(requestPtr, [this, compiled, exception](auto request)
+				{
+					if (exception != nullptr)
+					{
+						rethrow_exception(exception);
+					}
+					_funcLib.Add(move(request->Paras.Package), move(*compiled), move(request->Paras.Summary));
+				}));
+			});
+
+			return { requestPtr };
+		}
+
+		/// 不等编译完，返回的任务号用 GetAddFuncStatus 查
+		Awaiter<SubmitAddFuncRequest> SubmitAddFunc(SubmitAddFuncRequest::Content paras)
+		{
+			auto requestPtr = make_shared<SubmitAddFuncRequest>(SubmitAddFuncRequest{ {}, move(paras) });
+			_threadPool->Execute(GenerateTask<true>(requestPtr, [this](auto request, unique_lock<mutex>* lockPtr)
+			{
+				lockPtr->unlock();
+				int jobId;
+				{
+					lock_guard<mutex> guard(_jobsMutex);
+					jobId = _nextJobId++;
+					if (_jobStatuses.size() >= MaxKeptJobs and _jobStatuses.begin()->second != JobCompiling)
+					{
+						_jobStatuses.erase(_jobStatuses.begin());
+					}
+					_jobStatuses.insert({ jobId, JobCompiling });
+				}
 
-				istringstream strStream(move(request->Paras.FuncsDef));
-				_funcLib.Add(move(request->Paras.Package), { make_unique<istringstream>(move(strStream)) }, move(request->Paras.Summary));
+				// 先取出代码再移动 Paras，参数的求值顺序是不确定的
+				auto funcsDef = move(request->Paras.FuncsDef);
+				auto paras = move(request->Paras);
+				CompileThen(move(funcsDef), [this, jobId, paras = move(paras)](auto compiled, auto exception) mutable
+				{
+					_threadPool->Execute([this, jobId, paras = move(paras), compiled, exception]() mutable
+					{
+						string status = JobDone;
+						try
+						{
+							if (exception != nullptr)
+							{
+								rethrow_exception(exception);
+							}
+							lock_guard<mutex> libGuard(_funcLibMutex);
+							_funcLib.Add(move(paras.Package), move(*compiled), move(paras.Summary));
+						}
+						catch (std::exception const& e)
+						{
+							status = string("Failed: ") + e.what();
+						}
+						SetJobStatus(jobId, move(status));
+					});
+				});
+				request->Result = jobId;
+			}));
+
+			return { requestPtr };
+		}
+
+		Awaiter<GetAddFuncStatusRequest> GetAddFuncStatus(GetAddFuncStatusRequest::Content paras)
+		{
+			auto requestPtr = make_shared<GetAddFuncStatusRequest>(GetAddFuncStatusRequest{ {}, move(paras) });
+			_threadPool->Execute(GenerateTask<true>(requestPtr, [this](auto request, unique_lock<mutex>* lockPtr)
+			{
+				lockPtr->unlock();
+				lock_guard<mutex> guard(_jobsMutex);
+				auto id = request->Paras.JobId;
+				if (not _jobStatuses.contains(id))
+				{
+					throw InvalidOperationException("No add func job of id " + std::to_string(id));
+				}
+				request->Result = _jobStatuses[id];
 			}));
 
 			return { requestPtr };
@@ -198,5 +479,57 @@ namespace Server
 
 			return { requestPtr };
 		}
+
+		Awaiter<CompactStoreRequest> CompactStore()
+		{
+			auto requestPtr = make_shared<CompactStoreRequest>(CompactStoreRequest{ {} });
+			_threadPool->Execute(GenerateTask<true>(requestPtr, [this](auto request, unique_lock<mutex>* lockPtr)
+			{
+				// 分片做，中间放开锁让其他请求可以执行
+				while (not _funcLib.CompactStore(CompactTimeSlice))
+				{
+					lockPtr->unlock();
+					std::this_thread::yield();
+					lockPtr->lock();
+				}
+			}));
+
+			return { requestPtr };
+		}
+
+		Awaiter<BackupStoreRequest> BackupStore(BackupStoreRequest::Content paras)
+		{
+			auto requestPtr = make_shared<BackupStoreRequest>(BackupStoreRequest{ {}, move(paras) });
+			_threadPool->Execute([this, requestPtr]
+			{
+				vector<shared_future<void>> finishes;
+				try
+				{
+					lock_guard<mutex> guard(_funcLibMutex);
+					finishes = _funcLib.BackupStore(requestPtr->Paras.Dir, BackupBytesPerSecond);
+				}
+				catch (...)
+				{
+					GenerateTask(requestPtr, [exception = std::current_exception()](auto)
+					{
+						rethrow_exception(exception);
+					})();
+					return;
+				}
+
+				BackupFinishThen(move(finishes), [this, requestPtr](auto exception)
+				{
+					_threadPool->Execute(GenerateTask(requestPtr, [exception](auto)
+					{
+						if (exception != nullptr)
+						{
+							rethrow_exception(exception);
+						}
+					}));
+				});
+			});
+
+			return { requestPtr };
+		}
 	};
 }
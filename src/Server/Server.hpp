@@ -19,6 +19,7 @@ namespace Server
 	namespace fs = ::std::filesystem;
 	using FuncLib::FuncsDefReader;
 	using FuncLib::FunctionLibrary;
+	using FuncLib::WarmUpBudget;
 	using Network::IoContext;
 	using Network::NetworkAcceptor;
 	using Network::Socket;
@@ -38,13 +39,15 @@ namespace Server
 		BusinessAcceptor _businessAcceptor;
 		FuncLibWorker _funcLibWorker;
 		AccountManager _accountManager;
+		WarmUpBudget _warmUpBudget;
 
 	public:
-		Server(ThreadPool threadPool, NetworkAcceptor netAcceptor, BusinessAcceptor businessAcceptor, FuncLibWorker funcLibWorker, AccountManager accountManager)
+		Server(ThreadPool threadPool, NetworkAcceptor netAcceptor, BusinessAcceptor businessAcceptor, FuncLibWorker funcLibWorker, AccountManager accountManager, WarmUpBudget warmUpBudget)
 			: _threadPool(move(threadPool)), _netAcceptor(move(netAcceptor)),
 			  _businessAcceptor(move(businessAcceptor)),
 			  _funcLibWorker(move(funcLibWorker)),
-			  _accountManager(move(accountManager))
+			  _accountManager(move(accountManager)),
+			  _warmUpBudget(warmUpBudget)
 		{
 			_businessAcceptor.SetThreadPool(&_threadPool);
 			_funcLibWorker.SetThreadPool(&_threadPool);
@@ -65,10 +68,14 @@ namespace Server
 
 		void StartRunBackground()
 		{
+			// 边接受连接边预加载，先来的调用碰上还没加载的库就自己加载
+			_funcLibWorker.WarmUp(_warmUpBudget);
+			_funcLibWorker.StartBackground();
 			_businessAcceptor.StartAcceptBackground();
 		}
 		
-		static auto New(IoContext& ioContext, int port)
+		/// warmUpBudget 限制启动时预加载常用函数库用的内存和时间
+		static auto New(IoContext& ioContext, int port, WarmUpBudget warmUpBudget = {})
 		{
 			fs::path serverDir = R"(./server)";
 			auto firstSetup = false;
@@ -96,7 +103,7 @@ namespace Server
 			auto accountManager = AccountManager(move(accountData));
 			NetworkAcceptor netAcceptor = ioContext.GetNetworkAcceptorOf(port);
 			// 下面这一步里构造里牵涉到了指针，然后你这个对象是要 move 出去的
-			return Server(move(threadPool), move(netAcceptor), move(acceptor), move(funcLibWorker), move(accountManager));
+			return Server(move(threadPool), move(netAcceptor), move(acceptor), move(funcLibWorker), move(accountManager), warmUpBudget);
 		}
 
 	private:
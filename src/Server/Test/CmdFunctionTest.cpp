@@ -202,6 +202,13 @@ TESTCASE("Cmd Function Test")
 		auto c = RemoveAdminAccountCmd();
 		auto r = c.ProcessArg("god");
 	}
+
+	SECTION("GetAddFuncStatus")
+	{
+		auto c = GetAddFuncStatusCmd();
+		auto r = c.ProcessArg("12");
+		ASSERT(r["jobId"].GetNumber() == 12);
+	}
 }
 
 DEF_TEST_FUNC(TestCmdFunction)
\ No newline at end of file
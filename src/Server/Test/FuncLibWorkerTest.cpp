@@ -109,9 +109,35 @@ Task ModifyFuncPackage(FuncLibWorker& libWorker)
 	co_await libWorker.ModifyFuncPackage({ GetAddFuncType(), { "Math", } });
 }
 
+Task SubmitAddFunc(FuncLibWorker& libWorker, optional<int>& jobId)
+{
+	auto content = GetAddFuncRequestContent();
+	content.Package = { "Async", };
+	auto r = co_await libWorker.SubmitAddFunc(move(content));
+	jobId = r;
+}
+
+Task GetAddFuncStatus(FuncLibWorker& libWorker, int jobId, optional<string>& status)
+{
+	auto r = co_await libWorker.GetAddFuncStatus({ jobId, });
+	status = move(r);
+}
+
+Task BackupStore(FuncLibWorker& libWorker, string dir, optional<string>& error)
+{
+	try
+	{
+		co_await libWorker.BackupStore({ move(dir), });
+	}
+	catch (std::exception const& e)
+	{
+		error = e.what();
+	}
+}
+
 TESTCASE("FuncLibWorker Test")
 {
-	Cleaner c1("./func.idx"), c2("./func_bin.lib");
+	Cleaner c1("./func.idx"), c2("./func_bin.lib"), c3("./func_compile.cache"), c4("./func_invoke.stat");
 	auto threadPool = ThreadPool(2);
 	auto funcLib = FunctionLibrary::GetFrom(".");
 	InitBaicFunc(funcLib);
@@ -156,6 +182,76 @@ TESTCASE("FuncLibWorker Test")
 	t8.Wait();
 	ASSERT(verfiyModifyResult.has_value());
 	ASSERT(not verfiyModifyResult.value());
+
+	optional<int> jobId;
+	SubmitAddFunc(libWorker, jobId).Wait();
+	ASSERT(jobId.has_value());
+	optional<string> status;
+	for (;;)
+	{
+		GetAddFuncStatus(libWorker, jobId.value(), status).Wait();
+		if (status.value() != FuncLibWorker::JobCompiling)
+		{
+			break;
+		}
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+	ASSERT(status.value() == FuncLibWorker::JobDone);
+	optional<bool> submitResult;
+	auto t9 = ContainsFunc(libWorker, FuncType("int", "One", {}, { "Async", }), submitResult);
+	t9.Wait();
+	ASSERT(submitResult.has_value());
+	ASSERT(submitResult.value());
+
+	// 等备份复制完时不占着池里的线程，开始不了的错误报给请求
+	{
+		using ::std::filesystem::create_directory;
+		using ::std::filesystem::exists;
+		using ::std::filesystem::remove_all;
+
+		struct DirCleaner
+		{
+			~DirCleaner()
+			{
+				remove_all("backupStore");
+			}
+		} d;
+		create_directory("backupStore");
+		optional<string> backupError;
+		BackupStore(libWorker, "backupStore", backupError).Wait();
+		ASSERT(not backupError.has_value());
+		ASSERT(exists("backupStore/func.idx"));
+		ASSERT(exists("backupStore/func_bin.lib"));
+
+		BackupStore(libWorker, "backupStore/notExist", backupError).Wait();
+		ASSERT(backupError.has_value());
+	}
+
+	// 重新打开后库还没加载，调用时先不占着锁把二进制读进来，读完在线程池里接着调用
+	{
+		using ::std::filesystem::create_directory;
+		using ::std::filesystem::remove_all;
+
+		struct DirCleaner
+		{
+			~DirCleaner()
+			{
+				remove_all("coldInvoke");
+			}
+		} d;
+		create_directory("coldInvoke");
+		{
+			auto lib = FunctionLibrary::GetFrom("coldInvoke");
+			InitBaicFunc(lib);
+		}
+
+		auto coldWorker = FuncLibWorker(FunctionLibrary::GetFrom("coldInvoke"));
+		coldWorker.SetThreadPool(&threadPool);
+		optional<JsonObject> coldResult;
+		InvokeFunc(coldWorker, coldResult).Wait();
+		ASSERT(coldResult.has_value());
+		ASSERT(coldResult->GetNumber() == 0);
+	}
 }
 
 DEF_TEST_FUNC(TestFuncLibWorker)
\ No newline at end of file